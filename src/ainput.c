@@ -30,14 +30,19 @@
 #include <pthread.h>
 #include "ainput.h"
 
+/* Most slots one audio input can drive. */
+#define MAX_TARGETS 8
+
 struct ainput_s
 {
     snd_pcm_t *audio_in;
-    int *target;
+    controlbus_t *controlbus;
+    int targets[ MAX_TARGETS ];
+    int num_targets;
     pthread_t thread_handle;
 };
 
-ainput_t *ainput_new( const char *portname )
+ainput_t *ainput_new( const char *portname, controlbus_t *controlbus )
 {
     ainput_t *ainput = malloc( sizeof( ainput_t ) );
     int mode = SND_PCM_STREAM_CAPTURE;
@@ -119,7 +124,8 @@ ainput_t *ainput_new( const char *portname )
         return 0;
     }
 
-    ainput->target = NULL;
+    ainput->controlbus = controlbus;
+    ainput->num_targets = 0;
     return ainput;
 }
 
@@ -135,9 +141,19 @@ void ainput_delete( ainput_t *ainput )
     free( ainput );
 }
 
-void ainput_set_control( ainput_t *ainput, int *target )
+void ainput_set_control( ainput_t *ainput, int slot )
 {
-    ainput->target = target;
+    ainput->targets[ 0 ] = slot;
+    ainput->num_targets = 1;
+}
+
+void ainput_add_control( ainput_t *ainput, int slot )
+{
+    if( ainput->num_targets == MAX_TARGETS ) {
+        fprintf( stderr, "ainput: too many controls, slot %d ignored\n", slot );
+        return;
+    }
+    ainput->targets[ ainput->num_targets++ ] = slot;
 }
 
 // static int throttle = 0;
@@ -156,7 +172,11 @@ static void ainput_check( ainput_t *ainput )
             // smooth a little?
             float cur = (float) abs( buffer [ 0 ] );
             state = (state * 0.6f) + (cur * 0.4f);
-            if( ainput->target ) *ainput->target = ((int) state); //abs( buffer[ 0 ] );
+            // levels are 15 bit, the bus takes 14
+            for( int i = 0; i < ainput->num_targets; i++ ) {
+                controlbus_set( ainput->controlbus, ainput->targets[ i ],
+                                ((int) state) >> 1 );
+            }
         }
     }
 }
@@ -26,6 +26,7 @@
 #define AINPUT_H_INCLUDED
 
 #include <stdint.h>
+#include "controlbus.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -33,9 +34,15 @@ extern "C" {
 
 typedef struct ainput_s ainput_t;
 
-ainput_t *ainput_new( const char *portname );
+ainput_t *ainput_new( const char *portname, controlbus_t *controlbus );
 void ainput_delete( ainput_t *ainput );
-void ainput_set_control( ainput_t *ainput, int *target );
+void ainput_set_control( ainput_t *ainput, int slot );
+
+/**
+ * Adds another slot for the audio level to drive, on top of any set
+ * already.
+ */
+void ainput_add_control( ainput_t *ainput, int slot );
 void ainput_start( ainput_t *ainput );
 
 #ifdef __cplusplus
@@ -0,0 +1,119 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "imageinput.h"
+#include "testimage.h"
+
+/**
+ * Times loading the same RGBA image from PNG, QOI and TGA through
+ * imageinput, copying every scanline out as the texture upload would,
+ * and reports the size of each file beside it.  Images are 1080p and 4K
+ * unless a size is given.
+ */
+
+#define RUNS 10
+
+static const int sizes[][ 2 ] = { { 1920, 1080 }, { 3840, 2160 } };
+
+static double now_ms( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (ts.tv_sec * 1000.0) + (ts.tv_nsec / 1000000.0);
+}
+
+/**
+ * Times every format at one size.  Returns 0 on error.
+ */
+static int bench_size( int width, int height )
+{
+    static const char *suffixes[] = { "bench.png", "bench.qoi", "bench.tga" };
+
+    uint8_t *pixels = testimage_pixels( width, height, 4 );
+    uint8_t *copy = malloc( (size_t) width * height * 4 );
+    if( !pixels || !copy ) return 0;
+
+    for( int format = 0; format < 3; format++ ) {
+        char name[ 256 ];
+        size_t size;
+        uint8_t *data;
+        int ok;
+
+        testimage_name( name, sizeof( name ), suffixes[ format ] );
+        if( format == 0 ) {
+            ok = testimage_write_png( name, pixels, width, height, 4 );
+        } else if( format == 1 ) {
+            ok = testimage_write_qoi( name, pixels, width, height, 4 );
+        } else {
+            ok = testimage_write_tga( name, pixels, width, height, 4 );
+        }
+        if( !ok || !(data = testimage_read( name, &size )) ) return 0;
+        free( data );
+
+        double ms = 0;
+        for( int run = 0; run < RUNS; run++ ) {
+            double start = now_ms();
+            imageinput_t *image = imageinput_new( name );
+            if( !image ) return 0;
+            for( int y = 0; y < height; y++ ) {
+                memcpy( copy + ((size_t) y * width * 4),
+                        imageinput_get_scanline( image, y ), width * 4 );
+            }
+            imageinput_delete( image );
+            ms += now_ms() - start;
+        }
+        if( memcmp( copy, pixels, (size_t) width * height * 4 ) ) {
+            fprintf( stderr, "bench_decode: %s decoded wrongly\n", name );
+            return 0;
+        }
+
+        fprintf( stderr, "bench_decode: %dx%d RGBA %s, %.2fms, %zu KiB\n",
+                 width, height, suffixes[ format ] + 6, ms / RUNS,
+                 size / 1024 );
+        unlink( name );
+    }
+
+    free( copy );
+    free( pixels );
+    return 1;
+}
+
+int main( int argc, char **argv )
+{
+    if( argc == 3 ) {
+        return !bench_size( atoi( argv[ 1 ] ), atoi( argv[ 2 ] ) );
+    }
+    for( int i = 0; i < (int) (sizeof( sizes ) / sizeof( sizes[ 0 ] )); i++ ) {
+        if( !bench_size( sizes[ i ][ 0 ], sizes[ i ][ 1 ] ) ) return 1;
+    }
+    return 0;
+}
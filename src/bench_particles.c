@@ -0,0 +1,106 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include "particles.h"
+
+/**
+ * Times a frame of the particle channel's work: spawn, update, and
+ * build the quads, with the pool kept about full as a loud passage
+ * would.  Reports the mean and worst frame for each of a range of pool
+ * sizes, so the cost per particle can be seen to stay flat, or for one
+ * size if it is given.
+ */
+
+#define FRAMES 600
+#define DT (1.0f / 60.0f)
+
+static const int capacities[] = { 1000, 10000, 50000, 100000, 200000 };
+
+static double now_ms( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (ts.tv_sec * 1000.0) + (ts.tv_nsec / 1000000.0);
+}
+
+/**
+ * Times one pool size.  Returns 0 on error.
+ */
+static int bench_capacity( int capacity )
+{
+    particles_emitter_t emitter = { 960.0f, 540.0f, 0.0f, 6.28f,
+                                    300.0f, 200.0f, 1.5f, 8.0f };
+    const uint8_t tint[ 4 ] = { 255, 200, 100, 255 };
+    particles_t *particles = particles_new( capacity );
+    float *xy = malloc( (size_t) capacity * 8 * sizeof( float ) );
+    uint8_t *rgba = malloc( (size_t) capacity * 16 );
+    double total = 0;
+    double worst = 0;
+    int quads = 0;
+
+    if( !particles || !xy || !rgba ) return 0;
+
+    /* Each particle lives 1.5s, so this many a frame keeps the pool full. */
+    int per_frame = (int) (capacity * DT / emitter.life) + 1;
+
+    for( int frame = 0; frame < FRAMES; frame++ ) {
+        double start = now_ms();
+        particles_spawn( particles, per_frame, &emitter );
+        particles_update( particles, DT, 300.0f, 0.6f );
+        quads = particles_build( particles, xy, rgba, tint );
+        double ms = now_ms() - start;
+
+        /* The first second fills the pool, so leave it out. */
+        if( frame >= 60 ) {
+            total += ms;
+            if( ms > worst ) worst = ms;
+        }
+    }
+
+    fprintf( stderr, "bench_particles: %d particles, %d drawn, %.3fms mean, "
+             "%.3fms worst per frame, %.2fns per particle\n", capacity, quads,
+             total / (FRAMES - 60), worst,
+             (total * 1000000.0) / ((double) (FRAMES - 60) * capacity) );
+
+    free( rgba );
+    free( xy );
+    particles_delete( particles );
+    return 1;
+}
+
+int main( int argc, char **argv )
+{
+    if( argc > 1 ) return !bench_capacity( atoi( argv[ 1 ] ) );
+    int count = sizeof( capacities ) / sizeof( capacities[ 0 ] );
+    for( int i = 0; i < count; i++ ) {
+        if( !bench_capacity( capacities[ i ] ) ) return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,119 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "imageinput.h"
+#include "texcache.h"
+#include "testimage.h"
+
+/**
+ * Compares loading an image by decoding the PNG against loading it from
+ * the decode cache, the two ways a channel can get its pixels.  Both
+ * copy every scanline out, as the texture upload would.
+ */
+
+#define RUNS 10
+
+static double now_ms( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (ts.tv_sec * 1000.0) + (ts.tv_nsec / 1000000.0);
+}
+
+int main( int argc, char **argv )
+{
+    int width = 1920;
+    int height = 1080;
+    char name[ 256 ];
+    char cachename[ 300 ];
+    struct stat st;
+
+    if( argc == 3 ) {
+        width = atoi( argv[ 1 ] );
+        height = atoi( argv[ 2 ] );
+    }
+
+    uint8_t *pixels = testimage_pixels( width, height, 4 );
+    uint8_t *copy = malloc( (size_t) width * height * 4 );
+    testimage_name( name, sizeof( name ), "bench.png" );
+    snprintf( cachename, sizeof( cachename ), "%s.cache", name );
+    if( !pixels || !copy || !testimage_write_png( name, pixels, width, height, 4 ) ||
+        stat( name, &st ) < 0 ) {
+        return 1;
+    }
+
+    double png_ms = 0;
+    for( int run = 0; run < RUNS; run++ ) {
+        double start = now_ms();
+        imageinput_t *image = imageinput_new( name );
+        if( !image ) return 1;
+        for( int y = 0; y < height; y++ ) {
+            memcpy( copy + ((size_t) y * width * 4),
+                    imageinput_get_scanline( image, y ), width * 4 );
+        }
+        imageinput_delete( image );
+        png_ms += now_ms() - start;
+    }
+
+    if( !texcache_write( name, &st, width, height, pixels, width, height,
+                         width * 4, 1, width, height ) ) {
+        return 1;
+    }
+
+    double cache_ms = 0;
+    for( int run = 0; run < RUNS; run++ ) {
+        double start = now_ms();
+        texcache_t *cache = texcache_open( name, &st, width, height );
+        if( !cache ) {
+            fprintf( stderr, "bench_texcache: cache did not match\n" );
+            return 1;
+        }
+        for( int y = 0; y < height; y++ ) {
+            memcpy( copy + ((size_t) y * width * 4),
+                    texcache_get_pixels( cache ) + (y * texcache_get_stride( cache )),
+                    width * 4 );
+        }
+        texcache_delete( cache );
+        cache_ms += now_ms() - start;
+    }
+
+    fprintf( stderr, "bench_texcache: %dx%d RGBA, png %.2fms, cache %.2fms, "
+             "%.1fx faster\n", width, height, png_ms / RUNS, cache_ms / RUNS,
+             png_ms / cache_ms );
+
+    unlink( cachename );
+    unlink( name );
+    free( copy );
+    free( pixels );
+    return 0;
+}
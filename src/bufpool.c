@@ -0,0 +1,152 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include "bufpool.h"
+
+/**
+ * The smallest class is MIN_BITS bits, and each power of two above it
+ * is split into four classes, up to MAX_BITS.
+ */
+#define MIN_BITS 6
+#define MAX_BITS 40
+#define NUM_CLASSES (1 + ((MAX_BITS - MIN_BITS) * 4))
+
+/**
+ * Every buffer is preceded by a header saying which class it is, which
+ * also links it into its free list while it waits in the pool.
+ */
+typedef union bufpool_block_u
+{
+    struct
+    {
+        union bufpool_block_u *next;
+        int size_class;
+    } h;
+    double align[ 2 ];
+} bufpool_block_t;
+
+static pthread_mutex_t bufpool_lock = PTHREAD_MUTEX_INITIALIZER;
+static bufpool_block_t *bufpool_lists[ NUM_CLASSES ];
+static size_t bufpool_cached;
+static unsigned int bufpool_misses;
+
+static int bufpool_class( size_t size )
+{
+    size_t n = size - 1;
+    int bits = 0;
+
+    if( size <= ((size_t) 1 << MIN_BITS) ) return 0;
+    while( n >> (bits + 1) ) bits++;
+    if( bits >= MAX_BITS ) return -1;
+    return 1 + ((bits - MIN_BITS) * 4) + (int) ((n >> (bits - 2)) & 3);
+}
+
+static size_t bufpool_class_size( int size_class )
+{
+    int bits, quarter;
+
+    if( !size_class ) return (size_t) 1 << MIN_BITS;
+    bits = MIN_BITS + ((size_class - 1) / 4);
+    quarter = (size_class - 1) % 4;
+    return ((size_t) 1 << bits) + ((size_t) (quarter + 1) << (bits - 2));
+}
+
+void *bufpool_alloc( size_t size )
+{
+    int size_class = bufpool_class( size ? size : 1 );
+    bufpool_block_t *block;
+
+    if( size_class < 0 ) return 0;
+
+    pthread_mutex_lock( &bufpool_lock );
+    block = bufpool_lists[ size_class ];
+    if( block ) {
+        bufpool_lists[ size_class ] = block->h.next;
+        bufpool_cached -= bufpool_class_size( size_class );
+    } else {
+        bufpool_misses++;
+    }
+    pthread_mutex_unlock( &bufpool_lock );
+
+    if( !block ) {
+        block = malloc( sizeof( bufpool_block_t ) +
+                        bufpool_class_size( size_class ) );
+        if( !block ) return 0;
+        block->h.size_class = size_class;
+    }
+    return block + 1;
+}
+
+void bufpool_free( void *buf )
+{
+    bufpool_block_t *block;
+    size_t size;
+
+    if( !buf ) return;
+    block = ((bufpool_block_t *) buf) - 1;
+    size = bufpool_class_size( block->h.size_class );
+
+    pthread_mutex_lock( &bufpool_lock );
+    if( bufpool_cached + size <= BUFPOOL_MAX_CACHED ) {
+        block->h.next = bufpool_lists[ block->h.size_class ];
+        bufpool_lists[ block->h.size_class ] = block;
+        bufpool_cached += size;
+        block = 0;
+    }
+    pthread_mutex_unlock( &bufpool_lock );
+
+    free( block );
+}
+
+void bufpool_flush( void )
+{
+    pthread_mutex_lock( &bufpool_lock );
+    for( int i = 0; i < NUM_CLASSES; i++ ) {
+        while( bufpool_lists[ i ] ) {
+            bufpool_block_t *block = bufpool_lists[ i ];
+            bufpool_lists[ i ] = block->h.next;
+            free( block );
+        }
+    }
+    bufpool_cached = 0;
+    pthread_mutex_unlock( &bufpool_lock );
+}
+
+size_t bufpool_get_cached( void )
+{
+    pthread_mutex_lock( &bufpool_lock );
+    size_t cached = bufpool_cached;
+    pthread_mutex_unlock( &bufpool_lock );
+    return cached;
+}
+
+unsigned int bufpool_get_misses( void )
+{
+    pthread_mutex_lock( &bufpool_lock );
+    unsigned int misses = bufpool_misses;
+    pthread_mutex_unlock( &bufpool_lock );
+    return misses;
+}
@@ -0,0 +1,80 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef BUFPOOL_H_INCLUDED
+#define BUFPOOL_H_INCLUDED
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A pool of buffers for the image load pipeline.  Sizes are rounded up
+ * to classes a quarter of a power of two apart, and a freed buffer goes
+ * on a list for its class rather than back to the heap, so reloading
+ * art of the same size takes every buffer it needs straight back out
+ * of the pool.  Up to BUFPOOL_MAX_CACHED bytes are kept, and buffers
+ * freed beyond that are given back to the heap.
+ *
+ * The pool is shared by every thread, so workers decoding in parallel
+ * draw from the same buffers.
+ *
+ * Example usage:
+ *
+ * uint8_t *pixels = bufpool_alloc( width * height * 4 );
+ * decode and upload
+ * bufpool_free( pixels );
+ */
+
+#define BUFPOOL_MAX_CACHED ((size_t) 256 * 1024 * 1024)
+
+/**
+ * Returns a buffer of at least size bytes, aligned for any type, or 0
+ * if out of memory.
+ */
+void *bufpool_alloc( size_t size );
+
+/**
+ * Returns a buffer to the pool.  Freeing 0 does nothing.
+ */
+void bufpool_free( void *buf );
+
+/**
+ * Gives every buffer waiting in the pool back to the heap.
+ */
+void bufpool_flush( void );
+
+/**
+ * Returns the bytes waiting in the pool, and how many allocations have
+ * had to go to the heap.
+ */
+size_t bufpool_get_cached( void );
+unsigned int bufpool_get_misses( void );
+
+#ifdef __cplusplus
+};
+#endif
+#endif /* BUFPOOL_H_INCLUDED */
@@ -0,0 +1,616 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <png.h>
+#include "shmout.h"
+#include "capture.h"
+
+/* Longest still filename kept with a queued frame. */
+#define STILL_NAME_MAX 256
+
+/* zlib's fastest level, stills are written while the show runs. */
+#define STILL_COMPRESSION 1
+
+typedef struct capture_slot_s
+{
+    uint8_t *pixels;
+    Uint32 ticks;
+    int still;
+    char filename[ STILL_NAME_MAX ];
+} capture_slot_t;
+
+struct capture_s
+{
+    SDL_Renderer *renderer;
+    int width;
+    int height;
+    int stride;
+
+    /**
+     * The targets are drawn alternately while capturing.  The frame in
+     * the other one has been drawn and presented but not yet read back
+     * if pending is set, and was drawn at pending_ticks.
+     */
+    SDL_Texture *targets[ 2 ];
+    int current;
+    int redirected;
+    int pending;
+    Uint32 pending_ticks;
+
+    char still_name[ STILL_NAME_MAX ];
+    int still_wanted;
+
+    /* Every frame is also published here, if set. */
+    shmout_t *output;
+
+    /**
+     * Queued frames run from head for count slots.  The render thread
+     * fills the slot after them and the encoder empties the one at
+     * head, each outside the lock, so they never touch the same slot.
+     */
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t idle;
+    pthread_t thread_handle;
+    capture_slot_t *slots;
+    int num_slots;
+    int head;
+    int count;
+    int busy;
+    int quit;
+
+    /* The recording, touched by the encoder only while it is busy. */
+    FILE *out;
+    int recording;
+    int fps;
+    int started;
+    Uint32 start_ticks;
+    uint8_t *planes;
+    unsigned int captured;
+    unsigned int dropped;
+    unsigned int written;
+};
+
+static void capture_write_png( capture_t *capture, capture_slot_t *slot )
+{
+    png_structp png_ptr;
+    png_infop info_ptr;
+    FILE *f;
+
+    f = fopen( slot->filename, "wb" );
+    if( !f ) {
+        fprintf( stderr, "capture: Cannot write %s: %s\n",
+                 slot->filename, strerror( errno ) );
+        return;
+    }
+
+    png_ptr = png_create_write_struct( PNG_LIBPNG_VER_STRING, 0, 0, 0 );
+    if( !png_ptr ) {
+        fclose( f );
+        return;
+    }
+    info_ptr = png_create_info_struct( png_ptr );
+    if( !info_ptr ) {
+        png_destroy_write_struct( &png_ptr, 0 );
+        fclose( f );
+        return;
+    }
+
+    if( setjmp( png_jmpbuf( png_ptr ) ) ) {
+        fprintf( stderr, "capture: Failed to write %s\n", slot->filename );
+        png_destroy_write_struct( &png_ptr, &info_ptr );
+        fclose( f );
+        return;
+    }
+
+    png_init_io( png_ptr, f );
+    png_set_compression_level( png_ptr, STILL_COMPRESSION );
+    png_set_IHDR( png_ptr, info_ptr, capture->width, capture->height, 8,
+                  PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
+                  PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT );
+    png_write_info( png_ptr, info_ptr );
+
+    /* The output is opaque, so the alpha byte is dropped as filler. */
+    png_set_filler( png_ptr, 0, PNG_FILLER_AFTER );
+    for( int i = 0; i < capture->height; i++ ) {
+        png_write_row( png_ptr, slot->pixels + (i * capture->stride) );
+    }
+    png_write_end( png_ptr, info_ptr );
+    png_destroy_write_struct( &png_ptr, &info_ptr );
+
+    if( fclose( f ) != 0 ) {
+        fprintf( stderr, "capture: Failed to write %s: %s\n",
+                 slot->filename, strerror( errno ) );
+    } else {
+        fprintf( stderr, "capture: Saved %s\n", slot->filename );
+    }
+}
+
+/**
+ * Converts RGBA to 4:2:0 with BT.601 studio-range coefficients, each
+ * chroma sample from the average of the pixels it covers.
+ */
+static void capture_convert( capture_t *capture, const uint8_t *pixels )
+{
+    int width = capture->width;
+    int height = capture->height;
+    int cwidth = (width + 1) / 2;
+    int cheight = (height + 1) / 2;
+    uint8_t *luma = capture->planes;
+    uint8_t *cb = luma + (width * height);
+    uint8_t *cr = cb + (cwidth * cheight);
+
+    for( int y = 0; y < height; y++ ) {
+        const uint8_t *in = pixels + (y * capture->stride);
+        uint8_t *out = luma + (y * width);
+        for( int x = 0; x < width; x++ ) {
+            out[ x ] = 16 + ((66 * in[ 0 ] + 129 * in[ 1 ] + 25 * in[ 2 ] + 128) >> 8);
+            in += 4;
+        }
+    }
+
+    for( int y = 0; y < cheight; y++ ) {
+        const uint8_t *top = pixels + ((y * 2) * capture->stride);
+        const uint8_t *bot = pixels + ((y * 2 + (y * 2 + 1 < height)) * capture->stride);
+        for( int x = 0; x < cwidth; x++ ) {
+            int l = (x * 2) * 4;
+            int r = (x * 2 + (x * 2 + 1 < width)) * 4;
+            int red = top[ l ] + top[ r ] + bot[ l ] + bot[ r ];
+            int green = top[ l + 1 ] + top[ r + 1 ] + bot[ l + 1 ] + bot[ r + 1 ];
+            int blue = top[ l + 2 ] + top[ r + 2 ] + bot[ l + 2 ] + bot[ r + 2 ];
+            cb[ y * cwidth + x ] = 128 + ((-38 * red - 74 * green + 112 * blue + 512) >> 10);
+            cr[ y * cwidth + x ] = 128 + ((112 * red - 94 * green - 18 * blue + 512) >> 10);
+        }
+    }
+}
+
+static void capture_write_frame( capture_t *capture, capture_slot_t *slot )
+{
+    size_t size = (size_t) capture->width * capture->height;
+    size += 2 * (size_t) ((capture->width + 1) / 2) * ((capture->height + 1) / 2);
+    unsigned int due;
+
+    if( !capture->started ) {
+        capture->start_ticks = slot->ticks;
+        capture->started = 1;
+    }
+
+    /**
+     * Write the frame into every tick of the recording it covers, which
+     * is none if the last frame already filled it, or several if frames
+     * went missing since.
+     */
+    due = (((uint64_t) (slot->ticks - capture->start_ticks)) * capture->fps) / 1000;
+    if( due < capture->written ) return;
+
+    capture_convert( capture, slot->pixels );
+    while( capture->written <= due ) {
+        if( fputs( "FRAME\n", capture->out ) < 0 ||
+            fwrite( capture->planes, size, 1, capture->out ) != 1 ) {
+            fprintf( stderr, "capture: Failed to write frame: %s\n",
+                     strerror( errno ) );
+            return;
+        }
+        capture->written++;
+    }
+}
+
+static void *capture_thread( void *arg )
+{
+    capture_t *capture = arg;
+
+    pthread_mutex_lock( &capture->lock );
+    for(;;) {
+        while( !capture->quit && !capture->count ) {
+            pthread_cond_wait( &capture->wake, &capture->lock );
+        }
+        if( !capture->count ) break;
+
+        capture_slot_t *slot = &capture->slots[ capture->head ];
+        capture->busy = 1;
+        pthread_mutex_unlock( &capture->lock );
+
+        if( slot->still ) {
+            capture_write_png( capture, slot );
+        } else if( capture->out ) {
+            capture_write_frame( capture, slot );
+        }
+
+        pthread_mutex_lock( &capture->lock );
+        capture->head = (capture->head + 1) % capture->num_slots;
+        capture->count--;
+        capture->busy = 0;
+        pthread_cond_broadcast( &capture->idle );
+    }
+    pthread_mutex_unlock( &capture->lock );
+    return NULL;
+}
+
+capture_t *capture_new( SDL_Renderer *renderer, int width, int height,
+                        int slots )
+{
+    capture_t *capture = malloc( sizeof( capture_t ) );
+    if( !capture ) return 0;
+
+    capture->renderer = renderer;
+    capture->width = width;
+    capture->height = height;
+    capture->stride = width * 4;
+    capture->targets[ 0 ] = 0;
+    capture->targets[ 1 ] = 0;
+    capture->current = 0;
+    capture->redirected = 0;
+    capture->pending = 0;
+    capture->pending_ticks = 0;
+    capture->still_wanted = 0;
+    capture->output = 0;
+    capture->num_slots = slots;
+    capture->head = 0;
+    capture->count = 0;
+    capture->busy = 0;
+    capture->quit = 0;
+    capture->out = 0;
+    capture->recording = 0;
+    capture->fps = 0;
+    capture->started = 0;
+    capture->start_ticks = 0;
+    capture->captured = 0;
+    capture->dropped = 0;
+    capture->written = 0;
+    capture->thread_handle = 0;
+
+    capture->planes = malloc( (size_t) width * height +
+                              2 * (size_t) ((width + 1) / 2) * ((height + 1) / 2) );
+    capture->slots = calloc( slots, sizeof( capture_slot_t ) );
+    if( !capture->planes || !capture->slots ) {
+        fprintf( stderr, "capture: Out of memory\n" );
+        free( capture->planes );
+        free( capture->slots );
+        free( capture );
+        return 0;
+    }
+    for( int i = 0; i < slots; i++ ) {
+        capture->slots[ i ].pixels = malloc( (size_t) capture->stride * height );
+        if( !capture->slots[ i ].pixels ) {
+            fprintf( stderr, "capture: Out of memory\n" );
+            while( i-- ) free( capture->slots[ i ].pixels );
+            free( capture->planes );
+            free( capture->slots );
+            free( capture );
+            return 0;
+        }
+    }
+
+    if( SDL_RenderTargetSupported( renderer ) ) {
+        for( int i = 0; i < 2; i++ ) {
+            capture->targets[ i ] = SDL_CreateTexture( renderer,
+                SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, width, height );
+            if( !capture->targets[ i ] ) break;
+            SDL_SetTextureBlendMode( capture->targets[ i ], SDL_BLENDMODE_NONE );
+        }
+        if( !capture->targets[ 0 ] || !capture->targets[ 1 ] ) {
+            fprintf( stderr, "capture: Cannot create targets: %s\n", SDL_GetError() );
+            if( capture->targets[ 0 ] ) SDL_DestroyTexture( capture->targets[ 0 ] );
+            capture->targets[ 0 ] = 0;
+            capture->targets[ 1 ] = 0;
+        }
+    }
+    if( !capture->targets[ 0 ] ) {
+        fprintf( stderr, "capture: Reading back from the screen\n" );
+    }
+
+    pthread_mutex_init( &capture->lock, NULL );
+    pthread_cond_init( &capture->wake, NULL );
+    pthread_cond_init( &capture->idle, NULL );
+    if( pthread_create( &capture->thread_handle, NULL, capture_thread, capture ) != 0 ) {
+        fprintf( stderr, "capture: failed to create encoder thread\n" );
+        capture->thread_handle = 0;
+        capture_delete( capture );
+        return 0;
+    }
+    return capture;
+}
+
+void capture_delete( capture_t *capture )
+{
+    capture_stop( capture );
+
+    if( capture->thread_handle ) {
+        pthread_mutex_lock( &capture->lock );
+        capture->quit = 1;
+        pthread_cond_broadcast( &capture->wake );
+        pthread_mutex_unlock( &capture->lock );
+        pthread_join( capture->thread_handle, NULL );
+    }
+    pthread_cond_destroy( &capture->idle );
+    pthread_cond_destroy( &capture->wake );
+    pthread_mutex_destroy( &capture->lock );
+
+    for( int i = 0; i < 2; i++ ) {
+        if( capture->targets[ i ] ) SDL_DestroyTexture( capture->targets[ i ] );
+    }
+    for( int i = 0; i < capture->num_slots; i++ ) {
+        free( capture->slots[ i ].pixels );
+    }
+    free( capture->slots );
+    free( capture->planes );
+    free( capture );
+}
+
+/**
+ * Waits for the encoder to write everything queued.  Called with the
+ * lock held.
+ */
+static void capture_drain( capture_t *capture )
+{
+    while( capture->count || capture->busy ) {
+        pthread_cond_wait( &capture->idle, &capture->lock );
+    }
+}
+
+/**
+ * Returns the slot after the queued frames, or 0 if the queue is full.
+ */
+static capture_slot_t *capture_free_slot( capture_t *capture )
+{
+    capture_slot_t *slot = 0;
+
+    pthread_mutex_lock( &capture->lock );
+    if( capture->count < capture->num_slots ) {
+        slot = &capture->slots[ (capture->head + capture->count) % capture->num_slots ];
+    }
+    pthread_mutex_unlock( &capture->lock );
+    return slot;
+}
+
+/**
+ * Hands the slot from capture_free_slot() to the encoder.
+ */
+static void capture_queue( capture_t *capture )
+{
+    pthread_mutex_lock( &capture->lock );
+    capture->count++;
+    pthread_cond_signal( &capture->wake );
+    pthread_mutex_unlock( &capture->lock );
+}
+
+static int capture_read_pixels( capture_t *capture, uint8_t *pixels, int stride )
+{
+    SDL_Rect rect = { 0, 0, capture->width, capture->height };
+
+    if( SDL_RenderReadPixels( capture->renderer, &rect, SDL_PIXELFORMAT_RGBA32,
+                              pixels, stride ) < 0 ) {
+        fprintf( stderr, "capture: Cannot read frame: %s\n", SDL_GetError() );
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Reads the current frame into the next free slot and queues it to be
+ * saved as a still.
+ */
+static void capture_read_still( capture_t *capture, Uint32 ticks )
+{
+    capture_slot_t *slot = capture_free_slot( capture );
+
+    capture->still_wanted = 0;
+    if( !slot ) {
+        fprintf( stderr, "capture: Encoder busy, %s not saved\n", capture->still_name );
+        return;
+    }
+    if( !capture_read_pixels( capture, slot->pixels, capture->stride ) ) return;
+
+    slot->ticks = ticks;
+    slot->still = 1;
+    snprintf( slot->filename, sizeof( slot->filename ), "%s", capture->still_name );
+    capture_queue( capture );
+}
+
+/**
+ * Reads the frame drawn at ticks straight into the shared memory
+ * output, and queues it for the recording.  The recording takes a copy
+ * of what was published rather than reading the frame twice, and
+ * counts the frame as dropped if the encoder has no room.
+ */
+static void capture_read_frame( capture_t *capture, Uint32 ticks )
+{
+    capture_slot_t *slot = 0;
+    uint8_t *shared = 0;
+    int ok = 1;
+
+    if( capture->recording ) {
+        slot = capture_free_slot( capture );
+        if( !slot ) capture->dropped++;
+    }
+
+    if( capture->output ) {
+        int stride = shmout_get_stride( capture->output );
+        shared = shmout_begin( capture->output );
+        ok = capture_read_pixels( capture, shared, stride );
+        if( ok && slot ) {
+            for( int i = 0; i < capture->height; i++ ) {
+                memcpy( slot->pixels + (i * capture->stride), shared + (i * stride),
+                        capture->stride );
+            }
+        }
+        /* A failed read leaves the slot marked as being written. */
+        if( ok ) shmout_end( capture->output, ticks );
+    } else if( slot ) {
+        ok = capture_read_pixels( capture, slot->pixels, capture->stride );
+    }
+
+    if( ok && slot ) {
+        slot->ticks = ticks;
+        slot->still = 0;
+        capture->captured++;
+        capture_queue( capture );
+    }
+}
+
+/**
+ * Reads back and queues the frame left in the other target.
+ */
+static void capture_flush( capture_t *capture )
+{
+    if( !capture->pending ) return;
+    capture->pending = 0;
+
+    SDL_SetRenderTarget( capture->renderer, capture->targets[ !capture->current ] );
+    capture_read_frame( capture, capture->pending_ticks );
+    SDL_SetRenderTarget( capture->renderer, 0 );
+}
+
+int capture_record( capture_t *capture, const char *filename, int fps )
+{
+    FILE *out;
+
+    capture_stop( capture );
+
+    out = fopen( filename, "wb" );
+    if( !out ) {
+        fprintf( stderr, "capture: Cannot write %s: %s\n",
+                 filename, strerror( errno ) );
+        return 0;
+    }
+    if( fprintf( out, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n",
+                 capture->width, capture->height, fps ) < 0 ) {
+        fprintf( stderr, "capture: Failed to write %s: %s\n",
+                 filename, strerror( errno ) );
+        fclose( out );
+        return 0;
+    }
+
+    /* The encoder is idle after capture_stop(), so this is safe. */
+    pthread_mutex_lock( &capture->lock );
+    capture->out = out;
+    capture->fps = fps;
+    capture->started = 0;
+    capture->captured = 0;
+    capture->dropped = 0;
+    capture->written = 0;
+    pthread_mutex_unlock( &capture->lock );
+
+    capture->recording = 1;
+    fprintf( stderr, "capture: Recording %s at %d fps\n", filename, fps );
+    return 1;
+}
+
+void capture_stop( capture_t *capture )
+{
+    if( !capture->recording ) return;
+    capture->recording = 0;
+    capture_flush( capture );
+
+    pthread_mutex_lock( &capture->lock );
+    capture_drain( capture );
+    if( fclose( capture->out ) != 0 ) {
+        fprintf( stderr, "capture: Failed to finish recording: %s\n",
+                 strerror( errno ) );
+    }
+    capture->out = 0;
+    pthread_mutex_unlock( &capture->lock );
+
+    fprintf( stderr, "capture: Recording stopped, %u frames captured, "
+             "%u dropped, %u written\n", capture->captured, capture->dropped,
+             capture->written );
+}
+
+int capture_is_recording( capture_t *capture )
+{
+    return capture->recording;
+}
+
+void capture_still( capture_t *capture, const char *filename )
+{
+    snprintf( capture->still_name, sizeof( capture->still_name ), "%s", filename );
+    capture->still_wanted = 1;
+}
+
+void capture_set_output( capture_t *capture, shmout_t *output )
+{
+    capture_flush( capture );
+    capture->output = output;
+}
+
+void capture_begin( capture_t *capture )
+{
+    capture->redirected = 0;
+    if( !capture->targets[ 0 ] ) return;
+    if( !capture->recording && !capture->output && !capture->still_wanted ) return;
+
+    SDL_SetRenderTarget( capture->renderer, capture->targets[ capture->current ] );
+    capture->redirected = 1;
+}
+
+void capture_end( capture_t *capture )
+{
+    Uint32 now = SDL_GetTicks();
+
+    if( !capture->targets[ 0 ] ) {
+        /* Without targets the back buffer is read right away. */
+        if( capture->still_wanted ) capture_read_still( capture, now );
+        if( capture->recording || capture->output ) capture_read_frame( capture, now );
+        return;
+    }
+    if( !capture->redirected ) return;
+
+    /* A still is taken now, so it shows the frame asked for. */
+    if( capture->still_wanted ) capture_read_still( capture, now );
+
+    capture_flush( capture );
+    SDL_SetRenderTarget( capture->renderer, 0 );
+    SDL_RenderCopy( capture->renderer, capture->targets[ capture->current ], 0, 0 );
+
+    if( capture->recording || capture->output ) {
+        capture->pending = 1;
+        capture->pending_ticks = now;
+        capture->current = !capture->current;
+    }
+    capture->redirected = 0;
+}
+
+unsigned int capture_get_captured( capture_t *capture )
+{
+    return capture->captured;
+}
+
+unsigned int capture_get_dropped( capture_t *capture )
+{
+    return capture->dropped;
+}
+
+unsigned int capture_get_written( capture_t *capture )
+{
+    pthread_mutex_lock( &capture->lock );
+    unsigned int written = capture->written;
+    pthread_mutex_unlock( &capture->lock );
+    return written;
+}
@@ -0,0 +1,128 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef CAPTURE_H_INCLUDED
+#define CAPTURE_H_INCLUDED
+
+#include <SDL2/SDL.h>
+#include "shmout.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Grabs the composed output as PNG stills or a Y4M recording without
+ * holding up the render loop.  Frames are read back into a fixed ring
+ * of buffers and encoded on a thread of their own.  When the encoder
+ * falls behind and the ring is full, new frames are dropped and
+ * counted rather than waited for.
+ *
+ * While capturing, the scene is drawn into one of two target textures
+ * which is then copied to the screen.  Each frame is read back one
+ * frame late, from the target drawn last time, so the read does not
+ * wait on the frame still being drawn.  Renderers without target
+ * support read the back buffer directly instead.
+ *
+ * Example usage:
+ *
+ * capture_t *capture = capture_new( renderer, 720, 480, 8 );
+ * capture_record( capture, "set.y4m", 30 );
+ * for(;;) {
+ *     capture_begin( capture );
+ *     draw the scene
+ *     capture_end( capture );
+ *     SDL_RenderPresent( renderer );
+ * }
+ * capture_stop( capture );
+ * capture_delete( capture );
+ */
+
+typedef struct capture_s capture_t;
+
+/**
+ * Creates a capture for an output of width by height, with room for
+ * slots frames waiting to be encoded, and starts its encoder thread.
+ * Returns 0 on error.
+ */
+capture_t *capture_new( SDL_Renderer *renderer, int width, int height,
+                        int slots );
+
+/**
+ * Stops any recording, waits for queued frames to be written, and
+ * joins the encoder thread.
+ */
+void capture_delete( capture_t *capture );
+
+/**
+ * Starts recording every presented frame to a Y4M file at fps frames
+ * per second.  Frames are repeated or skipped as needed to keep the
+ * recording in step with the wall clock.  Returns 0 on error.
+ */
+int capture_record( capture_t *capture, const char *filename, int fps );
+
+/**
+ * Finishes the recording, waiting for the frames already captured to
+ * be written.
+ */
+void capture_stop( capture_t *capture );
+
+/**
+ * Returns true while recording.
+ */
+int capture_is_recording( capture_t *capture );
+
+/**
+ * Saves the next frame to a PNG file.
+ */
+void capture_still( capture_t *capture, const char *filename );
+
+/**
+ * Publishes every frame to the given shared memory output, or stops if
+ * output is 0.  Frames are read back straight into the output's slots.
+ */
+void capture_set_output( capture_t *capture, shmout_t *output );
+
+/**
+ * Call before drawing a frame.
+ */
+void capture_begin( capture_t *capture );
+
+/**
+ * Call after drawing a frame, before presenting it.
+ */
+void capture_end( capture_t *capture );
+
+/**
+ * Returns the number of frames read back, dropped because the encoder
+ * was behind, and written to the recording, since the recording began.
+ */
+unsigned int capture_get_captured( capture_t *capture );
+unsigned int capture_get_dropped( capture_t *capture );
+unsigned int capture_get_written( capture_t *capture );
+
+#ifdef __cplusplus
+};
+#endif
+#endif /* CAPTURE_H_INCLUDED */
@@ -29,66 +29,372 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <sys/time.h>
+#include <math.h>
 #include <SDL2/SDL.h>
-#include "pnginput.h"
+#include "imageinput.h"
+#include "y4minput.h"
+#include "generator.h"
+#include "particles.h"
+#include "texcache.h"
+#include "mipmap.h"
+#include "bufpool.h"
+#include "mapping.h"
+#include "controlbus.h"
 #include "channel.h"
 
+/* Longest wait between retries of a broken file, in checks. */
+#define MAX_RETRY_WAIT 16
+
+#define PI 3.14159265358979323846
+
+/* Video frames asked for ahead of the one being shown. */
+#define READAHEAD_FRAMES 8
+
+/* Generated frames are split into this many bands across the workpool. */
+#define GENERATOR_BANDS 32
+
+/**
+ * Particles spawn steadily at up to PARTICLE_RATE a second with the level
+ * of the emit control, and in a burst of up to PARTICLE_BURST whenever
+ * it jumps more than ONSET_RISE above its recent average.  Bursts are
+ * at least ONSET_HOLD seconds apart.
+ */
+#define PARTICLE_RATE 2000.0
+#define PARTICLE_BURST 4000.0
+#define ONSET_RISE 0.1
+#define ONSET_HOLD 0.1
+#define ENVELOPE_SECONDS 0.25
+
+/* Longest step the particles take, so a stall does not fling them. */
+#define PARTICLE_MAX_STEP 0.1
+
+/* Size of the soft dot texture particles are drawn with. */
+#define PARTICLE_DOT 32
+
+/**
+ * Blend modes, in the order the blend control steps through them.
+ * Normal blends images with alpha and fades fullscreen channels, as
+ * channels always have.
+ */
+enum
+{
+    CHANNEL_BLEND_NORMAL,
+    CHANNEL_BLEND_ADD,
+    CHANNEL_BLEND_MULTIPLY,
+    CHANNEL_BLEND_SCREEN,
+    CHANNEL_BLEND_MODULATE,
+    CHANNEL_NUM_BLENDS
+};
+
+/**
+ * Channels within 1/NEARBY_MARGIN of a screen of the edge are treated
+ * as about to become visible, so their textures are kept or restored.
+ */
+#define NEARBY_MARGIN 4
+
+/* Images a channel can switch between, counting its own. */
+#define MAX_IMAGES 8
+
+static const char *param_names[ CHANNEL_NUM_PARAMS ] =
+{
+    "x_offset", "y_offset", "a_offset",
+    "x_control", "y_control", "a_control",
+    "scale", "rotation", "pivot_x", "pivot_y", "flip",
+    "blend", "red", "green", "blue",
+    "rate", "position", "detail", "emit", "image"
+};
+
+static const int param_defaults[ CHANNEL_NUM_PARAMS ] =
+{
+    0, 0, MAPPING_MAX,
+    0, 0, 0,
+    MAPPING_CENTRE, MAPPING_CENTRE, MAPPING_CENTRE, MAPPING_CENTRE, 0,
+    0, MAPPING_MAX, MAPPING_MAX, MAPPING_MAX,
+    MAPPING_CENTRE, 0, MAPPING_CENTRE, 0, 0
+};
+
+/**
+ * Default mappings, used until the mapping file says otherwise.  The y
+ * offset is inverted so that the bottom of a fader is the bottom of the
+ * screen.
+ */
+static const char *param_mappings[ CHANNEL_NUM_PARAMS ] =
+{
+    "", "invert", "",
+    "", "", "",
+    "", "", "", "", "",
+    "", "", "", "",
+    "", "", "", "", ""
+};
+
+static mapping_t *default_mappings[ CHANNEL_NUM_PARAMS ];
+
+static const mapping_t *channel_default_mapping( int param )
+{
+    if( !default_mappings[ param ] ) {
+        default_mappings[ param ] = mapping_new( param_mappings[ param ] );
+    }
+    return default_mappings[ param ];
+}
+
+/**
+ * A still image the channel can switch to, with its texture already
+ * uploaded and the file it came from.
+ */
+typedef struct channel_image_s
+{
+    const char *filename;
+    SDL_Texture *texture;
+    int t_width;
+    int t_height;
+    int tex_width;
+    int tex_height;
+    int tex_alpha;
+    time_t last_mtime;
+    struct stat loaded_stat;
+    int fail_count;
+    int retry_wait;
+} channel_image_t;
+
 struct channel_s
 {
     SDL_Renderer *renderer;
+    controlbus_t *controlbus;
     const char *filename;
     int screen_width;
     int screen_height;
     int fullscreen;
 
     SDL_Texture *texture;
+    int tex_width;
+    int tex_height;
+    int tex_alpha;
+
+    /**
+     * Moving channels keep time off the performance counter, so their
+     * speed does not depend on how often they are drawn.
+     */
+    Uint64 last_tick;
+
+    /**
+     * On a video wall every tile keeps time off the frame time the leader
+     * sends instead, so they all move together.
+     */
+    int clocked;
+    double clock;
+    double last_clock;
+
+    /* The part of the canvas this instance draws, in canvas pixels. */
+    SDL_Rect view;
+
+    /**
+     * Video channels play a mapped y4m file into a streaming texture.
+     * The playhead is in frames.
+     */
+    y4minput_t *video;
+    double v_playhead;
+    int v_frame;
+    int v_shown;
+
+    /**
+     * Generator channels draw a pattern into one of two buffers on the
+     * workpool while the other is uploaded, so generating the next frame
+     * overlaps presenting this one.  g_params is what the batch in
+     * flight is drawing into g_buffers[ g_back ], and g_front is the
+     * last buffer finished.
+     */
+    generator_t *generator;
+    workpool_t *workpool;
+    uint8_t *g_buffers[ 2 ];
+    int g_stride;
+    double g_time;
+    generator_params_t g_params;
+    int g_started;
+    int g_pending;
+    unsigned int g_ticket;
+    int g_back;
+    int g_front;
+    int g_ready;
+
+    /**
+     * Particle channels draw every live particle as one batch of quads,
+     * built into p_xy and p_rgba during channel_prepare().  p_envelope
+     * follows the emit control slowly, so onsets stand out against it.
+     */
+    particles_t *particles;
+    float *p_xy;
+    uint8_t *p_rgba;
+    int p_quads;
+    double p_envelope;
+    double p_carry;
+    double p_since_burst;
+
+    /* The size the image is shown at, which may be more than the texture. */
     int t_width;
     int t_height;
 
-    int x_offset;
-    int y_offset;
-    int a_offset;
-
-    int x_control;
-    int y_control;
-    int a_control;
+    char name[ 32 ];
+    int slots[ CHANNEL_NUM_PARAMS ];
 
     time_t last_mtime;
+    struct stat loaded_stat;
+    int fail_count;
+    int retry_wait;
+
+    /**
+     * Images the image control picks between.  The one on show lives
+     * in the fields above, and images[ image ] only holds its place.
+     * The others keep their textures, and are never evicted, so that
+     * switching to one never touches the disk.
+     */
+    channel_image_t images[ MAX_IMAGES ];
+    int num_images;
+    int image;
+    int pinned;
+
+    /**
+     * Set while a worker decodes the image to restore it, during which
+     * the render thread leaves the file and staging fields alone.
+     */
+    int restoring;
+
+    /* A decoded image waiting to be uploaded by channel_commit(). */
+    int st_ready;
+    texcache_t *st_cache;
+    y4minput_t *st_video;
+    uint8_t *st_data;
+    uint8_t *st_pixels;
+    unsigned int st_width;
+    unsigned int st_height;
+    int st_stride;
+    int st_has_alpha;
+    unsigned int st_display_width;
+    unsigned int st_display_height;
 
     SDL_Rect src_rect;
 
+    /**
+     * Where the image goes before it is transformed, the transformed
+     * rectangle and rotation centre handed to SDL, and the screen area
+     * the result covers, which is what culling looks at.
+     */
     int dst_skiprender;
+    int dst_nearby;
     int dst_alpha;
+    int dst_blend;
+    Uint8 dst_color[ 3 ];
     SDL_Rect dst_rect;
+    SDL_FRect dst_frect;
+    SDL_FPoint dst_center;
+    double dst_angle;
+    int dst_flip;
+    SDL_Rect dst_bounds;
 
     int lst_skiprender;
     int lst_alpha;
-    SDL_Rect lst_rect;
+    int lst_blend;
+    Uint8 lst_color[ 3 ];
+    SDL_FRect lst_frect;
+    SDL_FPoint lst_center;
+    double lst_angle;
+    int lst_flip;
 };
 
-channel_t *channel_new( SDL_Renderer *renderer, const char *filename,
-                        int screen_width, int screen_height, int fullscreen )
+/**
+ * Names a channel after its file, without the directory or extension,
+ * so "art/ch0.png" publishes slots like "ch0.x_offset".
+ */
+static void channel_set_name( channel_t *channel, const char *filename )
+{
+    const char *base = strrchr( filename, '/' );
+    base = base ? base + 1 : filename;
+    snprintf( channel->name, sizeof( channel->name ), "%s", base );
+
+    char *ext = strrchr( channel->name, '.' );
+    if( ext && ext != channel->name ) *ext = '\0';
+}
+
+channel_t *channel_new( SDL_Renderer *renderer, controlbus_t *controlbus,
+                        const char *filename, int screen_width,
+                        int screen_height, int fullscreen )
 {
     channel_t *channel = malloc( sizeof( channel_t ) );
     channel->renderer = renderer;
+    channel->controlbus = controlbus;
     channel->filename = filename;
     channel->screen_width = screen_width;
     channel->screen_height = screen_height;
     channel->fullscreen = fullscreen;
 
     channel->texture = NULL;
+    channel->tex_width = 0;
+    channel->tex_height = 0;
+    channel->tex_alpha = 0;
+    channel->last_tick = 0;
+    channel->clocked = 0;
+    channel->clock = 0;
+    channel->last_clock = 0;
+    channel->view.x = 0;
+    channel->view.y = 0;
+    channel->view.w = screen_width;
+    channel->view.h = screen_height;
+    channel->video = NULL;
+    channel->v_playhead = 0;
+    channel->v_frame = 0;
+    channel->v_shown = -1;
+    channel->generator = NULL;
+    channel->workpool = NULL;
+    channel->g_buffers[ 0 ] = NULL;
+    channel->g_buffers[ 1 ] = NULL;
+    channel->g_stride = 0;
+    channel->g_time = 0;
+    channel->g_started = 0;
+    channel->g_pending = 0;
+    channel->g_ticket = 0;
+    channel->g_back = 1;
+    channel->g_front = 0;
+    channel->g_ready = -1;
+    channel->particles = NULL;
+    channel->p_xy = NULL;
+    channel->p_rgba = NULL;
+    channel->p_quads = 0;
+    channel->p_envelope = 0;
+    channel->p_carry = 0;
+    channel->p_since_burst = ONSET_HOLD;
     channel->t_width = 0;
     channel->t_height = 0;
 
-    channel->x_offset = 0;
-    channel->y_offset = 0;
-    channel->a_offset = 0xff;
-
-    channel->x_control = 0;
-    channel->y_control = 0;
-    channel->a_control = 0;
+    channel_set_name( channel, filename );
+    for( int i = 0; i < CHANNEL_NUM_PARAMS; i++ ) {
+        char slotname[ 64 ];
+        snprintf( slotname, sizeof( slotname ), "%s.%s",
+                  channel->name, param_names[ i ] );
+        channel->slots[ i ] = controlbus_add( controlbus, slotname,
+                                              param_defaults[ i ],
+                                              channel_default_mapping( i ) );
+    }
 
     channel->last_mtime = 0;
+    channel->fail_count = 0;
+    channel->retry_wait = 0;
+
+    memset( channel->images, 0, sizeof( channel->images ) );
+    channel->num_images = 1;
+    channel->image = 0;
+    channel->pinned = 0;
+    channel->restoring = 0;
+
+    channel->st_ready = 0;
+    channel->st_cache = NULL;
+    channel->st_video = NULL;
+    channel->st_data = NULL;
+    channel->st_pixels = NULL;
+    channel->st_width = 0;
+    channel->st_height = 0;
+    channel->st_stride = 0;
+    channel->st_has_alpha = 0;
+    channel->st_display_width = 0;
+    channel->st_display_height = 0;
 
     channel->src_rect.x = 0;
     channel->src_rect.y = 0;
@@ -96,151 +402,946 @@ channel_t *channel_new( SDL_Renderer *renderer, const char *filename,
     channel->src_rect.h = 0;
 
     channel->dst_skiprender = 0;
+    channel->dst_nearby = 0;
     channel->dst_alpha = 0;
+    channel->dst_blend = CHANNEL_BLEND_NORMAL;
+    memset( channel->dst_color, 0xff, sizeof( channel->dst_color ) );
     channel->dst_rect.x = 0;
     channel->dst_rect.y = 0;
     channel->dst_rect.w = 0;
     channel->dst_rect.h = 0;
+    channel->dst_frect.x = 0;
+    channel->dst_frect.y = 0;
+    channel->dst_frect.w = 0;
+    channel->dst_frect.h = 0;
+    channel->dst_center.x = 0;
+    channel->dst_center.y = 0;
+    channel->dst_angle = 0;
+    channel->dst_flip = SDL_FLIP_NONE;
+    channel->dst_bounds = channel->dst_rect;
 
     channel->lst_skiprender = 0;
     channel->lst_alpha = 0;
-    channel->lst_rect.x = 0;
-    channel->lst_rect.y = 0;
-    channel->lst_rect.w = 0;
-    channel->lst_rect.h = 0;
+    channel->lst_blend = CHANNEL_BLEND_NORMAL;
+    memset( channel->lst_color, 0xff, sizeof( channel->lst_color ) );
+    channel->lst_frect = channel->dst_frect;
+    channel->lst_center = channel->dst_center;
+    channel->lst_angle = 0;
+    channel->lst_flip = SDL_FLIP_NONE;
 
     return channel;
 }
 
+static void channel_release( channel_t *channel );
+
 void channel_delete( channel_t *channel )
 {
+    channel_release( channel );
     if( channel->texture ) {
         SDL_DestroyTexture( channel->texture );
     }
+    for( int i = 0; i < channel->num_images; i++ ) {
+        if( channel->images[ i ].texture ) {
+            SDL_DestroyTexture( channel->images[ i ].texture );
+        }
+    }
+    if( channel->video ) {
+        y4minput_delete( channel->video );
+    }
+    if( channel->g_pending ) {
+        workpool_wait( channel->workpool, channel->g_ticket );
+    }
+    if( channel->generator ) {
+        generator_delete( channel->generator );
+    }
+    free( channel->g_buffers[ 0 ] );
+    free( channel->g_buffers[ 1 ] );
+    if( channel->particles ) {
+        particles_delete( channel->particles );
+    }
+    free( channel->p_xy );
+    free( channel->p_rgba );
     free( channel );
 }
 
-int *channel_get_x_offset( channel_t *channel )
+static SDL_Texture *channel_generator_texture( channel_t *channel );
+
+channel_t *channel_new_generator( SDL_Renderer *renderer,
+                                  controlbus_t *controlbus, const char *name,
+                                  const char *pattern, workpool_t *workpool,
+                                  int screen_width, int screen_height,
+                                  int fullscreen )
 {
-    return &channel->x_offset;
+    channel_t *channel = channel_new( renderer, controlbus, name, screen_width,
+                                      screen_height, fullscreen );
+    size_t size = (size_t) screen_width * screen_height * 4;
+
+    channel->generator = generator_new( pattern, screen_width, screen_height );
+    channel->workpool = workpool;
+    channel->g_stride = screen_width * 4;
+    channel->g_buffers[ 0 ] = malloc( size );
+    channel->g_buffers[ 1 ] = malloc( size );
+    if( !channel->generator || !channel->g_buffers[ 0 ] ||
+        !channel->g_buffers[ 1 ] ) {
+        fprintf( stderr, "channel: cannot generate %s\n", name );
+        if( channel->generator ) generator_delete( channel->generator );
+        channel->generator = NULL;
+        return channel;
+    }
+
+    /* Draw the first frame now, so there is never an empty texture. */
+    channel->g_params.time = 0;
+    channel->g_params.detail = 0.5f;
+    channel->g_params.phase = 0;
+    generator_render( channel->generator, &channel->g_params,
+                      channel->g_buffers[ 0 ], channel->g_stride, 0,
+                      screen_height );
+
+    channel->texture = channel_generator_texture( channel );
+    if( channel->texture ) {
+        channel->t_width = screen_width;
+        channel->t_height = screen_height;
+        channel->tex_width = screen_width;
+        channel->tex_height = screen_height;
+        channel->tex_alpha = 1;
+        channel->src_rect.w = screen_width;
+        channel->src_rect.h = screen_height;
+    }
+    return channel;
 }
 
-int *channel_get_y_offset( channel_t *channel )
+static SDL_Texture *channel_particle_texture( channel_t *channel );
+
+channel_t *channel_new_particles( SDL_Renderer *renderer,
+                                  controlbus_t *controlbus, const char *name,
+                                  int capacity, int screen_width,
+                                  int screen_height )
 {
-    return &channel->y_offset;
+    channel_t *channel = channel_new( renderer, controlbus, name, screen_width,
+                                      screen_height, 0 );
+
+    channel->particles = particles_new( capacity );
+    channel->p_xy = malloc( (size_t) capacity * 8 * sizeof( float ) );
+    channel->p_rgba = malloc( (size_t) capacity * 16 );
+    if( !channel->particles || !channel->p_xy || !channel->p_rgba ) {
+        fprintf( stderr, "channel: no memory for %d particles\n", capacity );
+        if( channel->particles ) particles_delete( channel->particles );
+        channel->particles = NULL;
+        return channel;
+    }
+
+    channel->texture = channel_particle_texture( channel );
+    if( channel->texture ) {
+        channel->t_width = PARTICLE_DOT;
+        channel->t_height = PARTICLE_DOT;
+        channel->tex_width = PARTICLE_DOT;
+        channel->tex_height = PARTICLE_DOT;
+        channel->tex_alpha = 1;
+    }
+    return channel;
 }
 
-int *channel_get_a_offset( channel_t *channel )
+int channel_get_slot( channel_t *channel, int param )
 {
-    return &channel->a_offset;
+    return channel->slots[ param ];
 }
 
-int *channel_get_a_control( channel_t *channel )
+const char *channel_get_name( channel_t *channel )
 {
-    return &channel->a_control;
+    return channel->name;
 }
 
-int *channel_get_x_control( channel_t *channel )
+/**
+ * Returns the current value of a parameter, or its default if the bus
+ * had no room for it.
+ */
+static int channel_param( channel_t *channel, int param )
 {
-    return &channel->x_control;
+    if( channel->slots[ param ] < 0 ) {
+        return mapping_apply( channel_default_mapping( param ),
+                              param_defaults[ param ] );
+    }
+    return controlbus_get( channel->controlbus, channel->slots[ param ] );
 }
 
-int *channel_get_y_control( channel_t *channel )
+static double elapsed_ms( struct timeval *start )
 {
-    return &channel->y_control;
+    struct timeval now;
+    gettimeofday( &now, 0 );
+    return ((now.tv_sec - start->tv_sec) * 1000.0) +
+           ((now.tv_usec - start->tv_usec) / 1000.0);
 }
 
-static void channel_loadpng( channel_t *channel )
+static SDL_Texture *channel_upload( channel_t *channel, uint8_t *data,
+                                    unsigned int width, unsigned int height,
+                                    int stride, int has_alpha )
 {
-    if( channel->texture ) {
-        SDL_DestroyTexture( channel->texture );
-        channel->texture = NULL;
+    SDL_Texture *texture = NULL;
+    int depth = has_alpha ? 32 : 24;
+    Uint32 red   = 0x000000ff;
+    Uint32 green = 0x0000ff00;
+    Uint32 blue  = 0x00ff0000;
+    Uint32 alpha = has_alpha? 0xff000000 : 0;
+    SDL_Surface *surface = SDL_CreateRGBSurfaceFrom( (void *) data,
+        width, height, depth, stride, red, green, blue, alpha );
+    if( !surface ) {
+        fprintf( stderr, "channel: failed to create surface: %s\n", SDL_GetError() );
+        return NULL;
     }
 
-    pnginput_t *png = pnginput_new( channel->filename );
-    unsigned int width = pnginput_get_width( png );
-    unsigned int height = pnginput_get_height( png );
-    unsigned char *data = malloc( width * height * 4 );
-    int has_alpha = pnginput_has_alpha( png );
-    int depth, stride;
+    texture = SDL_CreateTextureFromSurface( channel->renderer, surface );
+    if( !texture ) {
+        fprintf( stderr, "channel: failed to create texture: %s\n", SDL_GetError() );
+    }
+    SDL_FreeSurface( surface );
+    return texture;
+}
 
-    fprintf( stderr, "channel: loaded %s: alpha: %d, w %d, h %d\n",
-             channel->filename, has_alpha, width, height );
+/**
+ * Creates the streaming texture video frames are copied into.  The GPU
+ * does the conversion from YUV when it draws.
+ */
+static SDL_Texture *channel_video_texture( channel_t *channel,
+                                           unsigned int width,
+                                           unsigned int height )
+{
+    SDL_Texture *texture = SDL_CreateTexture( channel->renderer,
+                                              SDL_PIXELFORMAT_IYUV,
+                                              SDL_TEXTUREACCESS_STREAMING,
+                                              width, height );
+    if( !texture ) {
+        fprintf( stderr, "channel: failed to create texture: %s\n", SDL_GetError() );
+    } else {
+        SDL_SetTextureScaleMode( texture, SDL_ScaleModeLinear );
+    }
+    return texture;
+}
+
+/**
+ * Creates the streaming texture generated frames are copied into, and
+ * fills it with the last frame finished.
+ */
+static SDL_Texture *channel_generator_texture( channel_t *channel )
+{
+    SDL_Texture *texture = SDL_CreateTexture( channel->renderer,
+                                              SDL_PIXELFORMAT_ABGR8888,
+                                              SDL_TEXTUREACCESS_STREAMING,
+                                              channel->screen_width,
+                                              channel->screen_height );
+    if( !texture ) {
+        fprintf( stderr, "channel: failed to create texture: %s\n", SDL_GetError() );
+    } else {
+        SDL_SetTextureScaleMode( texture, SDL_ScaleModeLinear );
+        SDL_UpdateTexture( texture, NULL, channel->g_buffers[ channel->g_front ],
+                           channel->g_stride );
+    }
+    return texture;
+}
+
+/**
+ * Creates the soft round dot every particle is drawn with.
+ */
+static SDL_Texture *channel_particle_texture( channel_t *channel )
+{
+    uint32_t pixels[ PARTICLE_DOT * PARTICLE_DOT ];
+    SDL_Texture *texture = SDL_CreateTexture( channel->renderer,
+                                              SDL_PIXELFORMAT_ABGR8888,
+                                              SDL_TEXTUREACCESS_STATIC,
+                                              PARTICLE_DOT, PARTICLE_DOT );
+    if( !texture ) {
+        fprintf( stderr, "channel: failed to create texture: %s\n", SDL_GetError() );
+        return NULL;
+    }
+
+    for( int y = 0; y < PARTICLE_DOT; y++ ) {
+        for( int x = 0; x < PARTICLE_DOT; x++ ) {
+            float dx = ((x + 0.5f) / (PARTICLE_DOT / 2)) - 1.0f;
+            float dy = ((y + 0.5f) / (PARTICLE_DOT / 2)) - 1.0f;
+            float a = 1.0f - ((dx * dx) + (dy * dy));
+            a = (a > 0.0f) ? a * a : 0.0f;
+            pixels[ (y * PARTICLE_DOT) + x ] =
+                ((uint32_t) ((a * 255.0f) + 0.5f) << 24) | 0x00ffffffu;
+        }
+    }
+    SDL_UpdateTexture( texture, NULL, pixels, PARTICLE_DOT * 4 );
+    SDL_SetTextureScaleMode( texture, SDL_ScaleModeLinear );
+    return texture;
+}
+
+/**
+ * Maps a video file into the staging fields.  Frames are not read
+ * until they are shown.
+ */
+static int channel_decode_video( channel_t *channel )
+{
+    y4minput_t *video = y4minput_new( channel->filename );
+    int display_width, display_height;
+
+    if( !video ) return 0;
+
+    mipmap_fit( y4minput_get_width( video ), y4minput_get_height( video ),
+                channel->screen_width, channel->screen_height,
+                &display_width, &display_height );
+
+    fprintf( stderr, "channel: opened %s: %d frames at %.2ffps, w %d, h %d\n",
+             channel->filename, y4minput_get_frames( video ),
+             y4minput_get_fps( video ), y4minput_get_width( video ),
+             y4minput_get_height( video ) );
+
+    channel->st_video = video;
+    channel->st_width = y4minput_get_width( video );
+    channel->st_height = y4minput_get_height( video );
+    channel->st_has_alpha = 0;
+    channel->st_display_width = display_width;
+    channel->st_display_height = display_height;
+    channel->st_ready = 1;
+    return 1;
+}
+
+/**
+ * Decodes the image into the staging fields, from the cache if it is
+ * still valid.  This does not touch the renderer, so it is safe to call
+ * from a worker thread.  Returns 0 if the file could not be decoded.
+ */
+static int channel_decode( channel_t *channel, const struct stat *s )
+{
+    struct timeval start;
+
+    if( channel_is_video( channel ) ) {
+        return channel_decode_video( channel );
+    }
+
+    gettimeofday( &start, 0 );
+
+    texcache_t *cache = texcache_open( channel->filename, s,
+                                       channel->screen_width,
+                                       channel->screen_height );
+    if( cache ) {
+        channel->st_cache = cache;
+        channel->st_pixels = texcache_get_pixels( cache );
+        channel->st_width = texcache_get_width( cache );
+        channel->st_height = texcache_get_height( cache );
+        channel->st_stride = texcache_get_stride( cache );
+        channel->st_has_alpha = texcache_has_alpha( cache );
+        channel->st_display_width = texcache_get_display_width( cache );
+        channel->st_display_height = texcache_get_display_height( cache );
+        channel->st_ready = 1;
+        fprintf( stderr, "channel: loaded %s from cache in %.1fms: "
+                 "alpha: %d, w %d, h %d\n", channel->filename,
+                 elapsed_ms( &start ), channel->st_has_alpha,
+                 channel->st_width, channel->st_height );
+        return 1;
+    }
+
+    imageinput_t *image = imageinput_new( channel->filename );
+    if( !image ) return 0;
+
+    const char *format = imageinput_get_format( image );
+    int width = imageinput_get_width( image );
+    int height = imageinput_get_height( image );
+    uint8_t *data = bufpool_alloc( (size_t) width * height * 4 );
+    int has_alpha = imageinput_has_alpha( image );
+    int display_width, display_height;
+    int stride;
+
+    if( !data ) {
+        fprintf( stderr, "channel: no memory for %s (w %d, h %d)\n",
+                 channel->filename, width, height );
+        imageinput_delete( image );
+        return 0;
+    }
 
     if( !has_alpha ) {
-        depth = 24;
         stride = 3 * width;
     } else {
-        depth = 32;
         stride = 4 * width;
     }
 
     for( int i = 0; i < height; i++ ) {
-        memcpy( data + (i * stride), pnginput_get_scanline( png, i ), stride );
+        memcpy( data + ((size_t) i * stride), imageinput_get_scanline( image, i ), stride );
     }
+    imageinput_delete( image );
 
-    Uint32 red   = 0x000000ff;
-    Uint32 green = 0x0000ff00;
-    Uint32 blue  = 0x00ff0000;
-    Uint32 alpha = has_alpha? 0xff000000 : 0;
-    SDL_Surface *surface = SDL_CreateRGBSurfaceFrom( (void *) data,
-        width, height, depth, stride, red, green, blue, alpha );
-    if( !surface ) {
-        fprintf( stderr, "channel: failed to create surface: %s\n", SDL_GetError() );
+    /**
+     * Art larger than the output is shown fit to it.  Keep the smallest
+     * mip level that still covers that size, and let the GPU filter it
+     * the rest of the way.
+     */
+    mipmap_fit( width, height, channel->screen_width, channel->screen_height,
+                &display_width, &display_height );
+    if( !mipmap_reduce( &data, &width, &height, &stride, has_alpha ? 4 : 3,
+                        display_width, display_height ) ) {
+        fprintf( stderr, "channel: no memory to reduce %s\n", channel->filename );
+    }
+
+    fprintf( stderr, "channel: loaded %s (%s) in %.1fms: alpha: %d, w %d, h %d\n",
+             channel->filename, format, elapsed_ms( &start ), has_alpha,
+             width, height );
+
+    texcache_write( channel->filename, s, channel->screen_width,
+                    channel->screen_height, data, width, height, stride,
+                    has_alpha, display_width, display_height );
+
+    channel->st_data = data;
+    channel->st_pixels = data;
+    channel->st_width = width;
+    channel->st_height = height;
+    channel->st_stride = stride;
+    channel->st_has_alpha = has_alpha;
+    channel->st_display_width = display_width;
+    channel->st_display_height = display_height;
+    channel->st_ready = 1;
+    return 1;
+}
+
+/**
+ * Frees the staged image.
+ */
+static void channel_release( channel_t *channel )
+{
+    if( channel->st_cache ) {
+        texcache_delete( channel->st_cache );
+        channel->st_cache = NULL;
+    }
+    if( channel->st_video ) {
+        y4minput_delete( channel->st_video );
+        channel->st_video = NULL;
+    }
+    bufpool_free( channel->st_data );
+    channel->st_data = NULL;
+    channel->st_pixels = NULL;
+    channel->st_ready = 0;
+}
+
+/**
+ * Replaces the texture with the staged image.  The current texture is
+ * only destroyed once its replacement has been created, so a failed
+ * upload leaves the last good image on screen.  Returns 0 on failure.
+ */
+static int channel_commit( channel_t *channel )
+{
+    SDL_Texture *texture;
+
+    if( !channel->st_ready ) return 0;
+
+    if( channel->st_video ) {
+        texture = channel_video_texture( channel, channel->st_width,
+                                         channel->st_height );
     } else {
-        channel->texture = SDL_CreateTextureFromSurface( channel->renderer, surface );
-        if( channel->fullscreen ) {
-            SDL_SetTextureBlendMode( channel->texture, SDL_BLENDMODE_BLEND );
+        texture = channel_upload( channel, channel->st_pixels,
+                                  channel->st_width, channel->st_height,
+                                  channel->st_stride, channel->st_has_alpha );
+    }
+    if( texture ) {
+        if( channel->texture ) {
+            SDL_DestroyTexture( channel->texture );
         }
-        channel->t_width = width;
-        channel->t_height = height;
+        /* Filter when reduced, zoomed or rotated. */
+        SDL_SetTextureScaleMode( texture, SDL_ScaleModeLinear );
+        channel->texture = texture;
+        channel->t_width = channel->st_display_width;
+        channel->t_height = channel->st_display_height;
+        channel->tex_width = channel->st_width;
+        channel->tex_height = channel->st_height;
+        channel->tex_alpha = channel->st_has_alpha;
         channel->src_rect.x = 0;
         channel->src_rect.y = 0;
-        channel->src_rect.w = width;
-        channel->src_rect.h = height;
-        SDL_FreeSurface( surface );
+        channel->src_rect.w = channel->st_width;
+        channel->src_rect.h = channel->st_height;
+
+        if( channel->st_video ) {
+            if( channel->video ) y4minput_delete( channel->video );
+            channel->video = channel->st_video;
+            channel->st_video = NULL;
+            channel->v_shown = -1;
+        }
     }
-    pnginput_delete( png );
+
+    channel_release( channel );
+    return texture != NULL;
 }
 
+/**
+ * Records the outcome of a load.  After a failure, the file is retried
+ * on later checks even if it has not changed again, backing off
+ * exponentially so a broken file does not get decoded on every pass.
+ */
+static void channel_loaded( channel_t *channel, const struct stat *s, int ok )
+{
+    if( ok ) {
+        channel->last_mtime = s->st_mtime;
+        channel->loaded_stat = *s;
+        channel->fail_count = 0;
+        channel->retry_wait = 0;
+    } else {
+        int backoff = 1 << channel->fail_count;
+        if( backoff < MAX_RETRY_WAIT ) channel->fail_count++;
+        channel->retry_wait = backoff < MAX_RETRY_WAIT ? backoff : MAX_RETRY_WAIT;
+        fprintf( stderr, "channel: failed to load %s, retrying in %d checks\n",
+                 channel->filename, channel->retry_wait );
+    }
+}
+
+/**
+ * Generator and particle channels have no file behind them.
+ */
+static int channel_has_file( channel_t *channel )
+{
+    return !channel->generator && !channel->particles;
+}
 
-void channel_checkfile( channel_t *channel )
+int channel_checkfile( channel_t *channel )
 {
     struct stat s;
 
+    if( !channel_has_file( channel ) || channel->restoring ) return 0;
+
+    if( channel->retry_wait > 0 ) {
+        channel->retry_wait--;
+        return 0;
+    }
+
     if( stat( channel->filename, &s ) == 0 ) {
         if( s.st_mtime != channel->last_mtime ) {
-            channel->last_mtime = s.st_mtime;
-            channel_loadpng( channel );
+            int ok = channel_decode( channel, &s ) && channel_commit( channel );
+            channel_loaded( channel, &s, ok );
+            return ok;
         }
     }
+    return 0;
 }
 
-static int calc_offset( int size, int max, int controller )
+/**
+ * Puts the image in use back in its place, and shows the given one
+ * instead.
+ */
+static void channel_swap_image( channel_t *channel, int index )
 {
-    if( !controller ) return (0 - size);
-    float fc = (float) controller;
-    float fm = (float) max;
-    float fs = (float) size;
-    float val = ((fc / 127.0) * (fm + fs)) - fs;
-    return ((int) val);
+    channel_image_t next = channel->images[ index ];
+    channel_image_t *shown = &channel->images[ channel->image ];
+
+    if( index == channel->image ) return;
+
+    shown->filename = channel->filename;
+    shown->texture = channel->texture;
+    shown->t_width = channel->t_width;
+    shown->t_height = channel->t_height;
+    shown->tex_width = channel->tex_width;
+    shown->tex_height = channel->tex_height;
+    shown->tex_alpha = channel->tex_alpha;
+    shown->last_mtime = channel->last_mtime;
+    shown->loaded_stat = channel->loaded_stat;
+    shown->fail_count = channel->fail_count;
+    shown->retry_wait = channel->retry_wait;
+
+    channel->filename = next.filename;
+    channel->texture = next.texture;
+    channel->t_width = next.t_width;
+    channel->t_height = next.t_height;
+    channel->tex_width = next.tex_width;
+    channel->tex_height = next.tex_height;
+    channel->tex_alpha = next.tex_alpha;
+    channel->last_mtime = next.last_mtime;
+    channel->loaded_stat = next.loaded_stat;
+    channel->fail_count = next.fail_count;
+    channel->retry_wait = next.retry_wait;
+    channel->src_rect.x = 0;
+    channel->src_rect.y = 0;
+    channel->src_rect.w = next.tex_width;
+    channel->src_rect.h = next.tex_height;
+
+    memset( &channel->images[ index ], 0, sizeof( channel_image_t ) );
+    channel->image = index;
 }
 
-static int calc_control( int max, int controller )
+int channel_add_image( channel_t *channel, const char *filename )
 {
-    if( !controller ) return 0;
-    float fm = (float) max;
-    float fc = (float) controller;
-    float val = (fc / 32768.0) * (fm * 2.0); // scale audio gain?
-    return ((int) val);
+    const char *ext = strrchr( filename, '.' );
+
+    if( !channel_has_file( channel ) || channel_is_video( channel ) ||
+        (ext && !strcmp( ext, ".y4m" )) ) {
+        fprintf( stderr, "channel: %s can only switch between still images\n",
+                 channel->name );
+        return -1;
+    }
+    if( channel->num_images == MAX_IMAGES ) {
+        fprintf( stderr, "channel: too many images for %s\n", channel->name );
+        return -1;
+    }
+    channel->images[ channel->num_images ].filename = filename;
+    return channel->num_images++;
+}
+
+typedef struct preload_s
+{
+    channel_t **channels;
+    struct stat *stats;
+    int *found;
+    int *ok;
+} preload_t;
+
+static void channel_preload_one( void *arg, int index )
+{
+    preload_t *preload = arg;
+
+    if( preload->found[ index ] ) {
+        preload->ok[ index ] = channel_decode( preload->channels[ index ],
+                                               &preload->stats[ index ] );
+    }
+}
+
+/**
+ * Loads every channel's own image, then each of their other images in
+ * turn, decoding one image of each channel at a time in parallel.
+ */
+void channel_preload( channel_t **channels, int count, workpool_t *workpool )
+{
+    struct stat *stats = malloc( count * sizeof( struct stat ) );
+    int *found = calloc( count, sizeof( int ) );
+    int *ok = calloc( count, sizeof( int ) );
+    int *shown = calloc( count, sizeof( int ) );
+    preload_t preload = { channels, stats, found, ok };
+    struct timeval start;
+    double decoded = 0;
+    int rounds = 0;
+    int images = 0;
+
+    if( !stats || !found || !ok || !shown ) {
+        free( stats );
+        free( found );
+        free( ok );
+        free( shown );
+        return;
+    }
+    gettimeofday( &start, 0 );
+
+    for( int i = 0; i < count; i++ ) {
+        shown[ i ] = channels[ i ]->image;
+        if( channels[ i ]->num_images > rounds ) {
+            rounds = channels[ i ]->num_images;
+        }
+    }
+
+    for( int image = 0; image < rounds; image++ ) {
+        struct timeval round;
+        gettimeofday( &round, 0 );
+
+        for( int i = 0; i < count; i++ ) {
+            channel_t *channel = channels[ i ];
+            found[ i ] = 0;
+            if( !channel_has_file( channel ) || image >= channel->num_images ) {
+                continue;
+            }
+            channel_swap_image( channel, image );
+            found[ i ] = stat( channel->filename, &stats[ i ] ) == 0;
+            images += found[ i ];
+        }
+
+        workpool_run( workpool, channel_preload_one, &preload, count );
+        decoded += elapsed_ms( &round );
+
+        for( int i = 0; i < count; i++ ) {
+            if( found[ i ] ) {
+                channel_loaded( channels[ i ], &stats[ i ],
+                                ok[ i ] && channel_commit( channels[ i ] ) );
+            }
+        }
+    }
+
+    for( int i = 0; i < count; i++ ) {
+        channel_swap_image( channels[ i ], shown[ i ] );
+    }
+
+    fprintf( stderr, "channel: preloaded %d images for %d channels on %d threads "
+             "in %.1fms (decode %.1fms, upload %.1fms)\n", images, count,
+             workpool_get_threads( workpool ), elapsed_ms( &start ), decoded,
+             elapsed_ms( &start ) - decoded );
+    free( stats );
+    free( found );
+    free( ok );
+    free( shown );
+}
+
+int channel_is_video( channel_t *channel )
+{
+    const char *ext = strrchr( channel->filename, '.' );
+    return ext && !strcmp( ext, ".y4m" );
+}
+
+int channel_is_animating( channel_t *channel )
+{
+    if( channel->particles ) {
+        return channel->dst_alpha &&
+               (particles_get_alive( channel->particles ) ||
+                channel_param( channel, CHANNEL_EMIT ));
+    }
+    return (channel->video || channel->generator) && !channel->dst_skiprender;
+}
+
+int channel_get_texture_bytes( channel_t *channel )
+{
+    int bytes = 0;
+
+    /* The images waiting to be switched to keep their textures too. */
+    for( int i = 0; i < channel->num_images; i++ ) {
+        if( channel->images[ i ].texture ) {
+            bytes += channel->images[ i ].tex_width *
+                     channel->images[ i ].tex_height * 4;
+        }
+    }
+    if( !channel->texture ) return bytes;
+    if( channel->video ) {
+        return bytes + (channel->tex_width * channel->tex_height * 3) / 2;
+    }
+    return bytes + (channel->tex_width * channel->tex_height * 4);
+}
+
+int channel_is_resident( channel_t *channel )
+{
+    return channel->texture != NULL;
+}
+
+int channel_wants_texture( channel_t *channel )
+{
+    return channel->t_width && channel->dst_nearby;
+}
+
+void channel_set_pinned( channel_t *channel, int pinned )
+{
+    channel->pinned = pinned;
+}
+
+int channel_is_pinned( channel_t *channel )
+{
+    return channel->pinned;
+}
+
+void channel_set_view( channel_t *channel, int x, int y, int width, int height )
+{
+    channel->view.x = x;
+    channel->view.y = y;
+    channel->view.w = width;
+    channel->view.h = height;
+}
+
+void channel_set_clock( channel_t *channel, double seconds )
+{
+    channel->clocked = 1;
+    channel->clock = seconds;
+}
+
+const char *channel_get_filename( channel_t *channel )
+{
+    return channel->filename;
+}
+
+void channel_evict( channel_t *channel )
+{
+    if( channel->texture ) {
+        SDL_DestroyTexture( channel->texture );
+        channel->texture = NULL;
+        channel->v_shown = -1;
+    }
+}
+
+int channel_restore( channel_t *channel )
+{
+    if( channel->texture ) return 1;
+    if( !channel->t_width ) return 0;
+    if( channel->video ) {
+        channel->texture = channel_video_texture( channel, channel->tex_width,
+                                                  channel->tex_height );
+        return channel->texture != NULL;
+    }
+    if( channel->generator ) {
+        channel->texture = channel_generator_texture( channel );
+        channel->g_ready = -1;
+        return channel->texture != NULL;
+    }
+    if( channel->particles ) {
+        channel->texture = channel_particle_texture( channel );
+        return channel->texture != NULL;
+    }
+
+    /* Still images were decoded by channel_restore_decode(). */
+    channel->restoring = 0;
+    return channel_commit( channel );
+}
+
+int channel_restore_begin( channel_t *channel )
+{
+    if( channel->texture || !channel->t_width || channel->video ||
+        !channel_has_file( channel ) ) {
+        return 0;
+    }
+    channel->restoring = 1;
+    return 1;
+}
+
+void channel_restore_decode( channel_t *channel )
+{
+    channel_decode( channel, &channel->loaded_stat );
+}
+
+/**
+ * Parameters arrive from the control bus already mapped, as a fraction
+ * of their range from 0 to MAPPING_ONE.
+ */
+static int calc_offset( int size, int max, int value )
+{
+    return (int) (((int64_t) value * (max + size)) / MAPPING_ONE) - size;
+}
+
+static int calc_control( int max, int value )
+{
+    return (int) (((int64_t) value * (max * 2)) / MAPPING_ONE);
+}
+
+static int calc_clamp( int value, int min, int max )
+{
+    if( value < min ) return min;
+    if( value > max ) return max;
+    return value;
+}
+
+/**
+ * Playback rate runs from one speed backwards to three forwards, resting
+ * at normal speed in the centre.
+ */
+static double calc_rate( int value )
+{
+    return 1.0 + ((((double) value / MAPPING_ONE) - 0.5) * 4.0);
+}
+
+static int calc_blend( int value )
+{
+    return (int) (((int64_t) value * CHANNEL_NUM_BLENDS) / (MAPPING_ONE + 1));
+}
+
+static int calc_image( int value, int count )
+{
+    return calc_clamp( (int) (((int64_t) value * count) / (MAPPING_ONE + 1)),
+                       0, count - 1 );
+}
+
+static Uint8 calc_color( int value )
+{
+    return calc_clamp( (int) (((int64_t) value * 0xff) / MAPPING_ONE), 0, 0xff );
+}
+
+/**
+ * Returns the SDL blend mode for the given channel blend.  Screen is
+ * not built into SDL, so it is composed as src * alpha + dst * (1 - src).
+ */
+static SDL_BlendMode channel_blendmode( channel_t *channel, int blend )
+{
+    switch( blend ) {
+    case CHANNEL_BLEND_ADD:
+        return SDL_BLENDMODE_ADD;
+    case CHANNEL_BLEND_MULTIPLY:
+        return SDL_BLENDMODE_MUL;
+    case CHANNEL_BLEND_SCREEN:
+        return SDL_ComposeCustomBlendMode(
+            SDL_BLENDFACTOR_SRC_ALPHA, SDL_BLENDFACTOR_ONE_MINUS_SRC_COLOR,
+            SDL_BLENDOPERATION_ADD,
+            SDL_BLENDFACTOR_ZERO, SDL_BLENDFACTOR_ONE,
+            SDL_BLENDOPERATION_ADD );
+    case CHANNEL_BLEND_MODULATE:
+        return SDL_BLENDMODE_MOD;
+    default:
+        if( channel->fullscreen || channel->tex_alpha ) {
+            return SDL_BLENDMODE_BLEND;
+        }
+        return SDL_BLENDMODE_NONE;
+    }
+}
+
+/**
+ * Scale is exponential around the centre of its range, from 1/16x to
+ * 16x, so equal fader moves feel like equal zoom steps.
+ */
+static float calc_scale( int value )
+{
+    return exp2f( (((float) value / MAPPING_ONE) - 0.5f) * 8.0f );
+}
+
+static double calc_rotation( int value )
+{
+    return (((double) value / MAPPING_ONE) - 0.5) * 360.0;
+}
+
+static int calc_flip( int value )
+{
+    int flip = (int) (((int64_t) value * 4) / (MAPPING_ONE + 1));
+    return ((flip & 1) ? SDL_FLIP_HORIZONTAL : 0) |
+           ((flip & 2) ? SDL_FLIP_VERTICAL : 0);
+}
+
+/**
+ * Applies scale, rotation and flip about the pivot to dst_rect, and
+ * finds the screen area the result covers.
+ */
+static void channel_transform( channel_t *channel )
+{
+    float scale = calc_scale( channel_param( channel, CHANNEL_SCALE ) );
+    float px = (float) channel_param( channel, CHANNEL_PIVOT_X ) / MAPPING_ONE;
+    float py = (float) channel_param( channel, CHANNEL_PIVOT_Y ) / MAPPING_ONE;
+    double angle = calc_rotation( channel_param( channel, CHANNEL_ROTATION ) );
+
+    /* The pivot stays put on screen while the image scales around it. */
+    float pivot_x = channel->dst_rect.x + (px * channel->dst_rect.w);
+    float pivot_y = channel->dst_rect.y + (py * channel->dst_rect.h);
+    float w = channel->dst_rect.w * scale;
+    float h = channel->dst_rect.h * scale;
+
+    channel->dst_frect.x = pivot_x - (px * w);
+    channel->dst_frect.y = pivot_y - (py * h);
+    channel->dst_frect.w = w;
+    channel->dst_frect.h = h;
+    channel->dst_center.x = px * w;
+    channel->dst_center.y = py * h;
+    channel->dst_angle = angle;
+    channel->dst_flip = calc_flip( channel_param( channel, CHANNEL_FLIP ) );
+
+    /* Bounding box of the corners rotated about the pivot. */
+    float r = (float) (angle * (PI / 180.0));
+    float c = cosf( r );
+    float n = sinf( r );
+    float cx[ 4 ] = { -px * w, (1.0f - px) * w, -px * w, (1.0f - px) * w };
+    float cy[ 4 ] = { -py * h, -py * h, (1.0f - py) * h, (1.0f - py) * h };
+    float x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+    for( int i = 0; i < 4; i++ ) {
+        float x = (cx[ i ] * c) - (cy[ i ] * n);
+        float y = (cx[ i ] * n) + (cy[ i ] * c);
+        if( !i || x < x0 ) x0 = x;
+        if( !i || x > x1 ) x1 = x;
+        if( !i || y < y0 ) y0 = y;
+        if( !i || y > y1 ) y1 = y;
+    }
+
+    channel->dst_bounds.x = (int) floorf( pivot_x + x0 );
+    channel->dst_bounds.y = (int) floorf( pivot_y + y0 );
+    channel->dst_bounds.w = (int) ceilf( pivot_x + x1 ) - channel->dst_bounds.x;
+    channel->dst_bounds.h = (int) ceilf( pivot_y + y1 ) - channel->dst_bounds.y;
+}
+
+static int channel_offscreen( channel_t *channel, int margin_x, int margin_y )
+{
+    const SDL_Rect *b = &channel->dst_bounds;
+
+    const SDL_Rect *v = &channel->view;
+
+    if( (b->x + b->w) < v->x - margin_x ) return 1;
+    if( (b->y + b->h) < v->y - margin_y ) return 1;
+    if( b->x >= v->x + v->w + margin_x ) return 1;
+    if( b->y >= v->y + v->h + margin_y ) return 1;
+    if( b->w <= 0 || b->h <= 0 ) return 1;
+    return 0;
 }
 
 static int channel_skiprender( channel_t *channel )
 {
-    if( (channel->dst_rect.x + channel->dst_rect.w) < 0 ) return 1;
-    if( (channel->dst_rect.y + channel->dst_rect.h) < 0 ) return 1;
-    if( channel->dst_rect.x >= channel->screen_width ) return 1;
-    if( channel->dst_rect.y >= channel->screen_height ) return 1;
+    if( channel_offscreen( channel, 0, 0 ) ) return 1;
 
     if( channel->fullscreen ) {
         if( channel->dst_alpha == 0 ) return 1;
@@ -248,67 +1349,355 @@ static int channel_skiprender( channel_t *channel )
     return 0;
 }
 
+/**
+ * Returns the seconds since the last call, or 0 the first time.  With a
+ * clock set, this is the time since the clock of the last call, from 0,
+ * so a tile that joins a wall late catches up with the rest.
+ */
+static double channel_tick( channel_t *channel )
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    double elapsed = 0;
+
+    if( channel->clocked ) {
+        elapsed = channel->clock - channel->last_clock;
+        channel->last_clock = channel->clock;
+        return (elapsed > 0) ? elapsed : 0;
+    }
+
+    if( channel->last_tick ) {
+        elapsed = (double) (now - channel->last_tick) /
+                  SDL_GetPerformanceFrequency();
+    }
+    channel->last_tick = now;
+    return elapsed;
+}
+
+/**
+ * Moves the playhead on by the time since the last call, and picks the
+ * frame to show, offset by the position control.  Each new frame asks
+ * for the next few to be read in, in the direction of play.
+ */
+static void channel_advance( channel_t *channel )
+{
+    y4minput_t *video = channel->video;
+    int frames = y4minput_get_frames( video );
+    double rate = calc_rate( channel_param( channel, CHANNEL_RATE ) );
+    double position = (double) channel_param( channel, CHANNEL_POSITION ) /
+                      MAPPING_ONE;
+
+    channel->v_playhead += channel_tick( channel ) * y4minput_get_fps( video ) * rate;
+    channel->v_playhead = fmod( channel->v_playhead, frames );
+    if( channel->v_playhead < 0 ) channel->v_playhead += frames;
+
+    int frame = ((int) (channel->v_playhead + (position * frames))) % frames;
+    if( frame != channel->v_frame ) {
+        int ahead = (rate < 0) ? -READAHEAD_FRAMES : READAHEAD_FRAMES;
+        y4minput_prefetch( video, frame + ((rate < 0) ? -1 : 1), ahead );
+        channel->v_frame = frame;
+    }
+}
+
+static void channel_generate_band( void *arg, int index )
+{
+    channel_t *channel = arg;
+    int rows = (channel->screen_height + GENERATOR_BANDS - 1) / GENERATOR_BANDS;
+
+    generator_render( channel->generator, &channel->g_params,
+                      channel->g_buffers[ channel->g_back ], channel->g_stride,
+                      index * rows, rows );
+}
+
+/**
+ * Waits for the frame in flight, which then becomes the one to upload.
+ */
+static void channel_generate_finish( channel_t *channel )
+{
+    if( !channel->g_pending ) return;
+
+    workpool_wait( channel->workpool, channel->g_ticket );
+    channel->g_pending = 0;
+    channel->g_front = channel->g_back;
+    channel->g_ready = channel->g_back;
+    channel->g_back ^= 1;
+}
+
+/**
+ * Starts the next frame on the workpool, unless nothing it depends on
+ * has changed since the last one.
+ */
+static void channel_generate_start( channel_t *channel )
+{
+    generator_params_t params;
+
+    params.time = channel->g_time;
+    params.detail = (float) channel_param( channel, CHANNEL_DETAIL ) / MAPPING_ONE;
+    params.phase = (float) channel_param( channel, CHANNEL_POSITION ) / MAPPING_ONE;
+
+    if( channel->g_started && params.time == channel->g_params.time &&
+        params.detail == channel->g_params.detail &&
+        params.phase == channel->g_params.phase ) {
+        return;
+    }
+
+    channel->g_params = params;
+    channel->g_started = 1;
+    channel->g_ticket = workpool_start( channel->workpool, channel_generate_band,
+                                        channel, GENERATOR_BANDS );
+    channel->g_pending = 1;
+}
+
+/**
+ * Spawns from the emit control, moves the particles on, and builds the
+ * batch to draw.  The emitter sits where the offset and control
+ * parameters would put a sprite's corner, pointing along the rotation
+ * with a fan as wide as the detail control.  Scale sets the particle
+ * size.
+ */
+static int channel_prepare_particles( channel_t *channel )
+{
+    double dt = channel_tick( channel );
+    double level = (double) channel_param( channel, CHANNEL_EMIT ) / MAPPING_ONE;
+    int a_offset = calc_offset( 0, 0xff, channel_param( channel, CHANNEL_A_OFFSET ) );
+    int a_control = calc_control( 0xff, channel_param( channel, CHANNEL_A_CONTROL ) );
+    particles_emitter_t emitter;
+    uint8_t tint[ 4 ];
+    int count;
+
+    if( dt > PARTICLE_MAX_STEP ) dt = PARTICLE_MAX_STEP;
+
+    emitter.x = calc_offset( 0, channel->screen_width,
+                             channel_param( channel, CHANNEL_X_OFFSET ) ) +
+                calc_control( channel->screen_width,
+                              channel_param( channel, CHANNEL_X_CONTROL ) );
+    emitter.y = calc_offset( 0, channel->screen_height,
+                             channel_param( channel, CHANNEL_Y_OFFSET ) ) +
+                calc_control( channel->screen_height,
+                              channel_param( channel, CHANNEL_Y_CONTROL ) );
+    emitter.angle = calc_rotation( channel_param( channel, CHANNEL_ROTATION ) ) *
+                    (PI / 180.0);
+    emitter.spread = 2.0 * PI * channel_param( channel, CHANNEL_DETAIL ) / MAPPING_ONE;
+    emitter.speed = 300.0f;
+    emitter.jitter = 200.0f;
+    emitter.life = 1.5f;
+    emitter.size = 8.0f * calc_scale( channel_param( channel, CHANNEL_SCALE ) );
+
+    /* A steady stream with the level, and a burst on each onset. */
+    channel->p_carry += level * PARTICLE_RATE * dt;
+    count = (int) channel->p_carry;
+    channel->p_carry -= count;
+
+    channel->p_since_burst += dt;
+    if( level - channel->p_envelope > ONSET_RISE &&
+        channel->p_since_burst >= ONSET_HOLD ) {
+        count += (int) ((level - channel->p_envelope) * PARTICLE_BURST);
+        channel->p_since_burst = 0;
+    }
+    channel->p_envelope += (level - channel->p_envelope) *
+                           (1.0 - exp( -dt / ENVELOPE_SECONDS ));
+
+    particles_spawn( channel->particles, count, &emitter );
+    particles_update( channel->particles, dt, 300.0f, 0.6f );
+
+    channel->dst_alpha = calc_clamp( a_offset + a_control, 0, 0xff );
+    channel->dst_blend = calc_blend( channel_param( channel, CHANNEL_BLEND ) );
+    tint[ 0 ] = calc_color( channel_param( channel, CHANNEL_RED ) );
+    tint[ 1 ] = calc_color( channel_param( channel, CHANNEL_GREEN ) );
+    tint[ 2 ] = calc_color( channel_param( channel, CHANNEL_BLUE ) );
+    tint[ 3 ] = channel->dst_alpha;
+    channel->p_quads = particles_build( channel->particles, channel->p_xy,
+                                        channel->p_rgba, tint );
+    if( channel->view.x || channel->view.y ) {
+        for( int i = 0; i < channel->p_quads * 4; i++ ) {
+            channel->p_xy[ (i * 2) + 0 ] -= channel->view.x;
+            channel->p_xy[ (i * 2) + 1 ] -= channel->view.y;
+        }
+    }
+
+    /* The dot is tiny, so never give it up. */
+    channel->dst_nearby = 1;
+    channel->dst_skiprender = !channel->p_quads || !channel->dst_alpha;
+    return !(channel->dst_skiprender && channel->lst_skiprender);
+}
+
+/**
+ * Switches to the image the image control picks, if it loaded.  Returns
+ * true if the image changed.
+ */
+static int channel_select_image( channel_t *channel )
+{
+    if( channel->num_images < 2 || channel->restoring ) return 0;
+
+    int image = calc_image( channel_param( channel, CHANNEL_IMAGE ),
+                            channel->num_images );
+    if( image == channel->image || !channel->images[ image ].t_width ) {
+        return 0;
+    }
+    channel_swap_image( channel, image );
+    return 1;
+}
+
 int channel_prepare( channel_t *channel )
 {
-    if( !channel->texture ) return 0;
+    int switched = channel_select_image( channel );
+
+    /* Evicted channels keep their size, so they can still be placed. */
+    if( !channel->t_width ) return 0;
+
+    if( channel->particles ) {
+        return channel_prepare_particles( channel );
+    }
+
+    if( channel->video ) {
+        channel_advance( channel );
+    }
+    if( channel->generator ) {
+        double rate = calc_rate( channel_param( channel, CHANNEL_RATE ) );
+        channel->g_time += channel_tick( channel ) * rate;
+        channel_generate_finish( channel );
+    }
 
     int x_offset = calc_offset( channel->t_width, channel->screen_width,
-                                channel->x_offset );
+                                channel_param( channel, CHANNEL_X_OFFSET ) );
     int y_offset = calc_offset( channel->t_height, channel->screen_height,
-                                127 - channel->y_offset );
-    int a_offset = calc_offset( 0, 0xff, channel->a_offset );
+                                channel_param( channel, CHANNEL_Y_OFFSET ) );
+    int a_offset = calc_offset( 0, 0xff,
+                                channel_param( channel, CHANNEL_A_OFFSET ) );
 
-    int x_control = calc_control( channel->screen_width, channel->x_control );
-    int y_control = calc_control( channel->screen_height, channel->y_control );
-    int a_control = calc_control( 0xff, channel->a_control );
+    int x_control = calc_control( channel->screen_width,
+                                  channel_param( channel, CHANNEL_X_CONTROL ) );
+    int y_control = calc_control( channel->screen_height,
+                                  channel_param( channel, CHANNEL_Y_CONTROL ) );
+    int a_control = calc_control( 0xff,
+                                  channel_param( channel, CHANNEL_A_CONTROL ) );
 
     if( channel->fullscreen ) {
         channel->dst_rect.x = 0;
         channel->dst_rect.y = 0;
         channel->dst_rect.w = channel->t_width;
         channel->dst_rect.h = channel->t_height;
-        channel->dst_alpha = a_offset + a_control;
+        channel->dst_alpha = calc_clamp( a_offset + a_control, 0, 0xff );
     } else {
         channel->dst_rect.x = x_offset + x_control;
         channel->dst_rect.y = y_offset + y_control;
         channel->dst_rect.w = channel->t_width;
         channel->dst_rect.h = channel->t_height;
     }
+    channel_transform( channel );
+
+    channel->dst_blend = calc_blend( channel_param( channel, CHANNEL_BLEND ) );
+    channel->dst_color[ 0 ] = calc_color( channel_param( channel, CHANNEL_RED ) );
+    channel->dst_color[ 1 ] = calc_color( channel_param( channel, CHANNEL_GREEN ) );
+    channel->dst_color[ 2 ] = calc_color( channel_param( channel, CHANNEL_BLUE ) );
 
     channel->dst_skiprender = channel_skiprender( channel );
+    channel->dst_nearby = !channel->dst_skiprender ||
+        (!(channel->fullscreen && channel->dst_alpha == 0) &&
+         !channel_offscreen( channel, channel->view.w / NEARBY_MARGIN,
+                             channel->view.h / NEARBY_MARGIN ));
+
+    if( channel->generator && !channel->dst_skiprender ) {
+        channel_generate_start( channel );
+    }
 
     if( channel->dst_skiprender && channel->lst_skiprender ) {
         return 0;
     }
 
-    if( (channel->dst_rect.x == channel->lst_rect.x) &&
-        (channel->dst_rect.y == channel->lst_rect.y) &&
-        (channel->dst_rect.w == channel->lst_rect.w) &&
-        (channel->dst_rect.h == channel->lst_rect.h) &&
-        (channel->dst_alpha == channel->lst_alpha) ) {
+    if( (channel->dst_frect.x == channel->lst_frect.x) &&
+        (channel->dst_frect.y == channel->lst_frect.y) &&
+        (channel->dst_frect.w == channel->lst_frect.w) &&
+        (channel->dst_frect.h == channel->lst_frect.h) &&
+        (channel->dst_center.x == channel->lst_center.x) &&
+        (channel->dst_center.y == channel->lst_center.y) &&
+        (channel->dst_angle == channel->lst_angle) &&
+        (channel->dst_flip == channel->lst_flip) &&
+        (channel->dst_blend == channel->lst_blend) &&
+        !memcmp( channel->dst_color, channel->lst_color,
+                 sizeof( channel->dst_color ) ) &&
+        (channel->dst_alpha == channel->lst_alpha) &&
+        (!channel->video || channel->v_frame == channel->v_shown) &&
+        channel->g_ready < 0 && !switched ) {
         return 0;
     }
 
     return 1;
 }
 
+/**
+ * Draws every particle in a single batch.  Tint and alpha are already in
+ * the vertex colours.
+ */
+static void channel_render_particles( channel_t *channel )
+{
+    if( !channel->dst_skiprender ) {
+        SDL_SetTextureBlendMode( channel->texture,
+                                 channel_blendmode( channel, channel->dst_blend ) );
+        SDL_RenderGeometryRaw( channel->renderer, channel->texture,
+                               channel->p_xy, 2 * sizeof( float ),
+                               (const SDL_Color *) channel->p_rgba, 4,
+                               particles_get_uvs( channel->particles ),
+                               2 * sizeof( float ),
+                               channel->p_quads * 4,
+                               particles_get_indices( channel->particles ),
+                               channel->p_quads * 6, 4 );
+    }
+    channel->lst_skiprender = channel->dst_skiprender;
+}
+
 void channel_render( channel_t *channel )
 {
     if( !channel->texture ) return;
 
+    if( channel->particles ) {
+        channel_render_particles( channel );
+        return;
+    }
+
+    if( !channel->dst_skiprender && channel->video &&
+        channel->v_frame != channel->v_shown ) {
+        uint8_t *y, *u, *v;
+        if( y4minput_get_frame( channel->video, channel->v_frame, &y, &u, &v ) ) {
+            int chroma = y4minput_get_chroma_width( channel->video );
+            SDL_UpdateYUVTexture( channel->texture, NULL, y, channel->tex_width,
+                                  u, chroma, v, chroma );
+        }
+        channel->v_shown = channel->v_frame;
+    }
+
+    if( !channel->dst_skiprender && channel->g_ready >= 0 ) {
+        SDL_UpdateTexture( channel->texture, NULL,
+                           channel->g_buffers[ channel->g_ready ],
+                           channel->g_stride );
+        channel->g_ready = -1;
+    }
+
     if( !channel->dst_skiprender ) {
+        SDL_FRect dst = channel->dst_frect;
+        dst.x -= channel->view.x;
+        dst.y -= channel->view.y;
+
+        /* Tints and blending happen on the GPU, so changing them is free. */
         if( channel->fullscreen ) {
             SDL_SetTextureAlphaMod( channel->texture, channel->dst_alpha );
         }
-        SDL_RenderCopy( channel->renderer, channel->texture,
-                        &channel->src_rect, &channel->dst_rect );
+        SDL_SetTextureColorMod( channel->texture, channel->dst_color[ 0 ],
+                                channel->dst_color[ 1 ],
+                                channel->dst_color[ 2 ] );
+        SDL_SetTextureBlendMode( channel->texture,
+                                 channel_blendmode( channel, channel->dst_blend ) );
+        SDL_RenderCopyExF( channel->renderer, channel->texture,
+                           &channel->src_rect, &dst, channel->dst_angle,
+                           &channel->dst_center, channel->dst_flip );
     }
 
     channel->lst_skiprender = channel->dst_skiprender;
     channel->lst_alpha = channel->dst_alpha;
-    channel->lst_rect.x = channel->dst_rect.x;
-    channel->lst_rect.y = channel->dst_rect.y;
-    channel->lst_rect.w = channel->dst_rect.w;
-    channel->lst_rect.h = channel->dst_rect.h;
+    channel->lst_blend = channel->dst_blend;
+    memcpy( channel->lst_color, channel->dst_color, sizeof( channel->lst_color ) );
+    channel->lst_frect = channel->dst_frect;
+    channel->lst_center = channel->dst_center;
+    channel->lst_angle = channel->dst_angle;
+    channel->lst_flip = channel->dst_flip;
 }
 
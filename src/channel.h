@@ -27,6 +27,8 @@
 
 #include <stdint.h>
 #include <SDL2/SDL.h>
+#include "workpool.h"
+#include "controlbus.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -34,19 +36,138 @@ extern "C" {
 
 typedef struct channel_s channel_t;
 
-channel_t *channel_new( SDL_Renderer *renderer, const char *filename,
-                        int screen_width, int screen_height, int fullscreen );
+/**
+ * Parameters a channel publishes on the control bus.  Blend steps
+ * through normal, add, multiply, screen and modulate across its range,
+ * and red, green and blue tint the image, full scale being untinted.
+ * Image steps through the images added with channel_add_image().
+ */
+enum
+{
+    CHANNEL_X_OFFSET,
+    CHANNEL_Y_OFFSET,
+    CHANNEL_A_OFFSET,
+    CHANNEL_X_CONTROL,
+    CHANNEL_Y_CONTROL,
+    CHANNEL_A_CONTROL,
+    CHANNEL_SCALE,
+    CHANNEL_ROTATION,
+    CHANNEL_PIVOT_X,
+    CHANNEL_PIVOT_Y,
+    CHANNEL_FLIP,
+    CHANNEL_BLEND,
+    CHANNEL_RED,
+    CHANNEL_GREEN,
+    CHANNEL_BLUE,
+    CHANNEL_RATE,
+    CHANNEL_POSITION,
+    CHANNEL_DETAIL,
+    CHANNEL_EMIT,
+    CHANNEL_IMAGE,
+    CHANNEL_NUM_PARAMS
+};
+
+channel_t *channel_new( SDL_Renderer *renderer, controlbus_t *controlbus,
+                        const char *filename, int screen_width,
+                        int screen_height, int fullscreen );
+
+/**
+ * Creates a channel that draws a procedural pattern instead of showing a
+ * file, named as generator_new() knows them.  Each frame is computed on
+ * the workpool while the last is being presented.  Rate sets how fast
+ * the pattern moves, position its phase, and detail how fine it is.
+ */
+channel_t *channel_new_generator( SDL_Renderer *renderer,
+                                  controlbus_t *controlbus, const char *name,
+                                  const char *pattern, workpool_t *workpool,
+                                  int screen_width, int screen_height,
+                                  int fullscreen );
+
+/**
+ * Creates a channel of up to capacity particles, spawned by the emit
+ * control, which is meant to be driven by audio.  A rising level gives a
+ * steady stream and each sudden jump a burst.  Offsets and controls
+ * place the emitter, rotation aims it, detail widens its fan and scale
+ * sizes the particles.
+ */
+channel_t *channel_new_particles( SDL_Renderer *renderer,
+                                  controlbus_t *controlbus, const char *name,
+                                  int capacity, int screen_width,
+                                  int screen_height );
 void channel_delete( channel_t *channel );
-int *channel_get_x_offset( channel_t *channel );
-int *channel_get_y_offset( channel_t *channel );
-int *channel_get_a_offset( channel_t *channel );
-int *channel_get_a_control( channel_t *channel );
-int *channel_get_x_control( channel_t *channel );
-int *channel_get_y_control( channel_t *channel );
-void channel_checkfile( channel_t *channel );
+int channel_get_slot( channel_t *channel, int param );
+
+/**
+ * Returns the name the channel's slots start with, as in "ch0".
+ */
+const char *channel_get_name( channel_t *channel );
+
+/**
+ * Adds another still image for the image control to switch to, and
+ * returns its index, the channel's own file being 0, or -1 on error.
+ * Every image is loaded by channel_preload() and kept as a texture,
+ * so switching is as quick as moving any other control.  Only the one
+ * on show is checked for changes on disk.
+ */
+int channel_add_image( channel_t *channel, const char *filename );
+int channel_checkfile( channel_t *channel );
+void channel_preload( channel_t **channels, int count, workpool_t *workpool );
 int channel_prepare( channel_t *channel );
 void channel_render( channel_t *channel );
 
+/**
+ * Channels whose file ends in ".y4m" play it as video instead of showing
+ * a still image.  Rate sets the playback speed and position offsets the
+ * playhead through the clip.  While a video or generator channel is on
+ * screen it is animating, and channel_prepare() needs calling every
+ * frame to keep it moving.
+ */
+int channel_is_video( channel_t *channel );
+int channel_is_animating( channel_t *channel );
+
+/**
+ * Texture residency.  A channel that has loaded an image can give up its
+ * texture with channel_evict() and later rebuild it with
+ * channel_restore().  channel_is_resident() is true while it has one.
+ * channel_wants_texture() is true once the last channel_prepare() placed
+ * it on or near the screen.  Pinned channels are needed at a moment's
+ * notice, and are never evicted.
+ *
+ * channel_get_texture_bytes() counts every texture the channel holds,
+ * the alternate images added with channel_add_image() included.  Those
+ * stay resident for instant switching, so evicting a channel only frees
+ * the image on show.
+ *
+ * Still images are decoded again before they can be restored, which is
+ * too slow for the render thread.  If channel_restore_begin() returns
+ * true, call channel_restore_decode() on a worker, and channel_restore()
+ * once it has finished.  Until then the channel keeps its image and
+ * ignores changes to its file.  Other channels are restored at once.
+ */
+int channel_get_texture_bytes( channel_t *channel );
+int channel_is_resident( channel_t *channel );
+int channel_wants_texture( channel_t *channel );
+void channel_set_pinned( channel_t *channel, int pinned );
+int channel_is_pinned( channel_t *channel );
+const char *channel_get_filename( channel_t *channel );
+void channel_evict( channel_t *channel );
+int channel_restore_begin( channel_t *channel );
+void channel_restore_decode( channel_t *channel );
+int channel_restore( channel_t *channel );
+
+/**
+ * Video wall tiles.  The screen size given to channel_new() is the whole
+ * canvas, and channel_set_view() picks the part of it this instance
+ * draws, which is shifted to the top left of the window.  Channels
+ * outside the view are skipped and can give up their textures like any
+ * other offscreen channel.  channel_set_clock() makes moving channels
+ * keep time by the given frame time rather than the local clock, so
+ * every tile animates the same frame the same way.
+ */
+void channel_set_view( channel_t *channel, int x, int y, int width,
+                       int height );
+void channel_set_clock( channel_t *channel, double seconds );
+
 #ifdef __cplusplus
 };
 #endif
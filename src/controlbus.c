@@ -0,0 +1,324 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include "mapping.h"
+#include "controlbus.h"
+
+#define MAX_SLOTS 512
+#define MAX_NAME 32
+#define DIRTY_WORDS (MAX_SLOTS / 64)
+
+/**
+ * A slot's raw input and its mapped value are packed into one word, raw
+ * in the top half, so they only ever change together and controlbus_get()
+ * never disagrees with controlbus_get_raw().
+ */
+typedef struct slot_s
+{
+    char name[ MAX_NAME ];
+    uint64_t state;
+    unsigned int version;
+    const mapping_t *mapping;
+    const mapping_t *default_mapping;
+} slot_t;
+
+struct controlbus_s
+{
+    int num_slots;
+    slot_t slots[ MAX_SLOTS ];
+
+    /* Set by producers, taken by controlbus_collect(). */
+    uint64_t dirty[ DIRTY_WORDS ];
+    uint64_t collected[ DIRTY_WORDS ];
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int pending;
+
+    controlbus_tap_t tap;
+    void *tap_arg;
+
+    /* Values held by controlbus_latch() for the render thread. */
+    int latched;
+    int latch[ MAX_SLOTS ];
+};
+
+controlbus_t *controlbus_new( void )
+{
+    controlbus_t *controlbus = malloc( sizeof( controlbus_t ) );
+    pthread_condattr_t attr;
+
+    if( !controlbus ) return 0;
+
+    controlbus->num_slots = 0;
+    memset( controlbus->dirty, 0, sizeof( controlbus->dirty ) );
+    memset( controlbus->collected, 0, sizeof( controlbus->collected ) );
+    controlbus->pending = 0;
+    controlbus->tap = 0;
+    controlbus->tap_arg = 0;
+    controlbus->latched = 0;
+
+    pthread_mutex_init( &controlbus->lock, NULL );
+    pthread_condattr_init( &attr );
+    pthread_condattr_setclock( &attr, CLOCK_MONOTONIC );
+    pthread_cond_init( &controlbus->cond, &attr );
+    pthread_condattr_destroy( &attr );
+    return controlbus;
+}
+
+void controlbus_delete( controlbus_t *controlbus )
+{
+    pthread_cond_destroy( &controlbus->cond );
+    pthread_mutex_destroy( &controlbus->lock );
+    free( controlbus );
+}
+
+static int controlbus_map( const mapping_t *mapping, int raw )
+{
+    return mapping ? mapping_apply( mapping, raw ) : raw;
+}
+
+static uint64_t controlbus_pack( int raw, int value )
+{
+    return ((uint64_t) (uint32_t) raw << 32) | (uint32_t) value;
+}
+
+static int controlbus_raw( uint64_t state )
+{
+    return (int32_t) (state >> 32);
+}
+
+static int controlbus_value( uint64_t state )
+{
+    return (int32_t) (uint32_t) state;
+}
+
+int controlbus_add( controlbus_t *controlbus, const char *name, int raw,
+                    const mapping_t *mapping )
+{
+    if( controlbus->num_slots == MAX_SLOTS ) {
+        fprintf( stderr, "controlbus: no room for %s\n", name );
+        return -1;
+    }
+
+    slot_t *slot = &controlbus->slots[ controlbus->num_slots ];
+    snprintf( slot->name, MAX_NAME, "%s", name );
+    slot->state = controlbus_pack( raw, controlbus_map( mapping, raw ) );
+    slot->version = 0;
+    slot->mapping = mapping;
+    slot->default_mapping = mapping;
+    return controlbus->num_slots++;
+}
+
+int controlbus_find( controlbus_t *controlbus, const char *name )
+{
+    for( int i = 0; i < controlbus->num_slots; i++ ) {
+        if( !strcmp( controlbus->slots[ i ].name, name ) ) return i;
+    }
+    return -1;
+}
+
+int controlbus_get_count( controlbus_t *controlbus )
+{
+    return controlbus->num_slots;
+}
+
+const char *controlbus_get_name( controlbus_t *controlbus, int slot )
+{
+    return controlbus->slots[ slot ].name;
+}
+
+void controlbus_wake( controlbus_t *controlbus )
+{
+    pthread_mutex_lock( &controlbus->lock );
+    __atomic_store_n( &controlbus->pending, 1, __ATOMIC_SEQ_CST );
+    pthread_cond_signal( &controlbus->cond );
+    pthread_mutex_unlock( &controlbus->lock );
+}
+
+void controlbus_set_tap( controlbus_t *controlbus, controlbus_tap_t tap,
+                         void *arg )
+{
+    controlbus->tap = tap;
+    controlbus->tap_arg = arg;
+}
+
+/**
+ * Stores raw and its mapped value, or with remap set, maps the raw value
+ * already there again.  Setters and mapping changes can race, so if the
+ * mapping is swapped while a value is being stored, the stored raw value
+ * is mapped again, and whatever is left always matches the latest raw
+ * value and mapping.  Returns false if raw was there already.
+ */
+static int controlbus_store( slot_t *s, int raw, int remap )
+{
+    uint64_t old = __atomic_load_n( &s->state, __ATOMIC_ACQUIRE );
+
+    for(;;) {
+        const mapping_t *mapping = __atomic_load_n( &s->mapping, __ATOMIC_ACQUIRE );
+        uint64_t state;
+
+        if( remap ) {
+            raw = controlbus_raw( old );
+        } else if( controlbus_raw( old ) == raw ) {
+            return 0;
+        }
+        state = controlbus_pack( raw, controlbus_map( mapping, raw ) );
+        if( !__atomic_compare_exchange_n( &s->state, &old, state, 0,
+                                          __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) ) {
+            continue;
+        }
+        if( __atomic_load_n( &s->mapping, __ATOMIC_ACQUIRE ) == mapping ) {
+            return 1;
+        }
+        old = state;
+        remap = 1;
+    }
+}
+
+static void controlbus_update( controlbus_t *controlbus, int slot )
+{
+    slot_t *s = &controlbus->slots[ slot ];
+
+    __atomic_add_fetch( &s->version, 1, __ATOMIC_RELEASE );
+    __atomic_or_fetch( &controlbus->dirty[ slot / 64 ],
+                       ((uint64_t) 1) << (slot % 64), __ATOMIC_SEQ_CST );
+
+    /**
+     * Only the first change since the last collect needs to wake.  If
+     * pending is still set here, the collect that clears it has not yet
+     * taken the dirty bits, so it will see this change.
+     */
+    if( !__atomic_load_n( &controlbus->pending, __ATOMIC_SEQ_CST ) ) {
+        controlbus_wake( controlbus );
+    }
+}
+
+void controlbus_set( controlbus_t *controlbus, int slot, int raw )
+{
+    if( slot < 0 || slot >= controlbus->num_slots ) return;
+
+    if( !controlbus_store( &controlbus->slots[ slot ], raw, 0 ) ) return;
+    if( controlbus->tap ) controlbus->tap( controlbus->tap_arg, slot, raw );
+    controlbus_update( controlbus, slot );
+}
+
+void controlbus_set_mapping( controlbus_t *controlbus, int slot,
+                             const mapping_t *mapping )
+{
+    if( slot < 0 || slot >= controlbus->num_slots ) return;
+
+    slot_t *s = &controlbus->slots[ slot ];
+    if( !mapping ) mapping = s->default_mapping;
+    __atomic_store_n( &s->mapping, mapping, __ATOMIC_RELEASE );
+    controlbus_store( s, 0, 1 );
+    controlbus_update( controlbus, slot );
+}
+
+int controlbus_get_raw( controlbus_t *controlbus, int slot )
+{
+    return controlbus_raw( __atomic_load_n( &controlbus->slots[ slot ].state,
+                                            __ATOMIC_ACQUIRE ) );
+}
+
+int controlbus_get( controlbus_t *controlbus, int slot )
+{
+    if( controlbus->latched ) return controlbus->latch[ slot ];
+    return controlbus_value( __atomic_load_n( &controlbus->slots[ slot ].state,
+                                              __ATOMIC_ACQUIRE ) );
+}
+
+void controlbus_latch( controlbus_t *controlbus )
+{
+    for( int i = 0; i < controlbus->num_slots; i++ ) {
+        controlbus->latch[ i ] = controlbus_value(
+            __atomic_load_n( &controlbus->slots[ i ].state, __ATOMIC_ACQUIRE ) );
+    }
+    controlbus->latched = 1;
+}
+
+void controlbus_latch_values( controlbus_t *controlbus, const int *values,
+                              int count )
+{
+    if( !controlbus->latched ) controlbus_latch( controlbus );
+    if( count > controlbus->num_slots ) count = controlbus->num_slots;
+    memcpy( controlbus->latch, values, count * sizeof( int ) );
+}
+
+unsigned int controlbus_get_version( controlbus_t *controlbus, int slot )
+{
+    return __atomic_load_n( &controlbus->slots[ slot ].version, __ATOMIC_ACQUIRE );
+}
+
+int controlbus_collect( controlbus_t *controlbus )
+{
+    int count = 0;
+
+    pthread_mutex_lock( &controlbus->lock );
+    __atomic_store_n( &controlbus->pending, 0, __ATOMIC_SEQ_CST );
+    pthread_mutex_unlock( &controlbus->lock );
+
+    for( int i = 0; i < DIRTY_WORDS; i++ ) {
+        uint64_t bits = __atomic_exchange_n( &controlbus->dirty[ i ], 0,
+                                             __ATOMIC_SEQ_CST );
+        controlbus->collected[ i ] = bits;
+        count += __builtin_popcountll( bits );
+    }
+    return count;
+}
+
+int controlbus_changed( controlbus_t *controlbus, int slot )
+{
+    return (controlbus->collected[ slot / 64 ] >> (slot % 64)) & 1;
+}
+
+void controlbus_wait( controlbus_t *controlbus, int timeout_ms )
+{
+    struct timespec deadline;
+
+    clock_gettime( CLOCK_MONOTONIC, &deadline );
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+    if( deadline.tv_nsec >= 1000000000L ) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock( &controlbus->lock );
+    while( !controlbus->pending ) {
+        if( pthread_cond_timedwait( &controlbus->cond, &controlbus->lock,
+                                    &deadline ) != 0 ) {
+            break;
+        }
+    }
+    pthread_mutex_unlock( &controlbus->lock );
+}
@@ -0,0 +1,169 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef CONTROLBUS_H_INCLUDED
+#define CONTROLBUS_H_INCLUDED
+
+#include "mapping.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * The control bus holds every parameter an input can drive, as named
+ * integer slots.  Inputs publish raw values from their own threads with
+ * controlbus_set(), and the render loop sleeps in controlbus_wait()
+ * until something has changed.  Each slot passes its raw value through
+ * a mapping to give the value that controlbus_get() returns.
+ *
+ * Example usage:
+ *
+ * int slot = controlbus_add( bus, "ch0.x_offset", 0, linear );
+ *
+ * // midi thread
+ * controlbus_set( bus, slot, mapping_from_7bit( 64 ) );
+ *
+ * // render thread
+ * controlbus_wait( bus, 100 );
+ * if( controlbus_collect( bus ) ) {
+ *     x = controlbus_get( bus, slot );
+ * }
+ */
+
+typedef struct controlbus_s controlbus_t;
+
+/**
+ * Called from controlbus_set() on the setting thread with every change
+ * to a raw value.  Must be quick and must not block.
+ */
+typedef void (*controlbus_tap_t)( void *arg, int slot, int raw );
+
+controlbus_t *controlbus_new( void );
+void controlbus_delete( controlbus_t *controlbus );
+
+/**
+ * Adds a slot with the given name, starting raw value and default
+ * mapping, which may be 0 to pass raw values straight through.  The
+ * mapping must outlive the bus.  Returns the slot number, or -1 if the
+ * bus is full.  Slots must all be added before any input threads are
+ * started.
+ */
+int controlbus_add( controlbus_t *controlbus, const char *name, int raw,
+                    const mapping_t *mapping );
+
+/**
+ * Returns the slot with the given name, or -1.
+ */
+int controlbus_find( controlbus_t *controlbus, const char *name );
+
+/**
+ * Returns the number of slots and the name of a slot.
+ */
+int controlbus_get_count( controlbus_t *controlbus );
+const char *controlbus_get_name( controlbus_t *controlbus, int slot );
+
+/**
+ * Publishes a new raw value for a slot.  Safe to call from any thread.
+ * Setting a slot to the value it already has does nothing.
+ */
+void controlbus_set( controlbus_t *controlbus, int slot, int raw );
+
+/**
+ * Replaces the mapping of a slot, or restores its default if mapping is
+ * 0, and remaps its current value.  Safe to call while inputs are
+ * running.  Input threads may still be using the old mapping for a
+ * moment after this returns, so it must not be freed straight away.
+ */
+void controlbus_set_mapping( controlbus_t *controlbus, int slot,
+                             const mapping_t *mapping );
+
+/**
+ * Returns the current mapped value of a slot, or the one latched if the
+ * bus has been latched.
+ */
+int controlbus_get( controlbus_t *controlbus, int slot );
+
+/**
+ * Holds the value of every slot as it is now, so that controlbus_get()
+ * returns the same values until the next latch however the inputs move
+ * meanwhile, and a frame sees one consistent set of controls.  Once
+ * latched, the bus stays latched.  Only the render thread should call
+ * this.
+ */
+void controlbus_latch( controlbus_t *controlbus );
+
+/**
+ * Latches the given mapped values, one for each slot from the first,
+ * instead of the bus's own.  This is how a wall tile shows exactly the
+ * values its leader did.
+ */
+void controlbus_latch_values( controlbus_t *controlbus, const int *values,
+                              int count );
+
+/**
+ * Returns the last raw value published to a slot.
+ */
+int controlbus_get_raw( controlbus_t *controlbus, int slot );
+
+/**
+ * Returns how many times a slot has been changed.
+ */
+unsigned int controlbus_get_version( controlbus_t *controlbus, int slot );
+
+/**
+ * Takes the set of slots changed since the last call, and returns how
+ * many there were.  Only the render thread should call this.
+ */
+int controlbus_collect( controlbus_t *controlbus );
+
+/**
+ * Returns true if the slot was in the set taken by the last collect.
+ */
+int controlbus_changed( controlbus_t *controlbus, int slot );
+
+/**
+ * Blocks until a slot changes, controlbus_wake() is called, or
+ * timeout_ms passes.  Returns immediately if a change is already
+ * waiting to be collected.
+ */
+void controlbus_wait( controlbus_t *controlbus, int timeout_ms );
+
+/**
+ * Wakes controlbus_wait() without changing anything.
+ */
+void controlbus_wake( controlbus_t *controlbus );
+
+/**
+ * Sets the function told of every change, or removes it if tap is 0.
+ * Like controlbus_add(), this must happen while no input threads are
+ * running.
+ */
+void controlbus_set_tap( controlbus_t *controlbus, controlbus_tap_t tap,
+                         void *arg );
+
+#ifdef __cplusplus
+};
+#endif
+#endif /* CONTROLBUS_H_INCLUDED */
@@ -0,0 +1,61 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef CTLFILE_H_INCLUDED
+#define CTLFILE_H_INCLUDED
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * The control log written by ctlrecord and read by ctlreplay.  All
+ * numbers are little endian.
+ *
+ * The file starts with the eight byte magic, then a uint32_t version
+ * and a uint32_t count of slot names, then that many names of
+ * CTLFILE_NAME_SIZE bytes each, padded with zeros.  Events follow until
+ * the end of the file, each:
+ *
+ *   uint32_t delta    microseconds since the previous event
+ *   uint16_t slot     index into the names, or CTLFILE_GAP
+ *   uint16_t raw      the new raw value
+ *
+ * A gap event only moves the clock on, for pauses longer than a delta
+ * can hold.  Replay finds each slot again by name, so a log still plays
+ * back after channels have been added or reordered.
+ */
+
+#define CTLFILE_MAGIC "vcctlog"
+#define CTLFILE_VERSION 1
+#define CTLFILE_NAME_SIZE 32
+#define CTLFILE_EVENT_SIZE 8
+#define CTLFILE_GAP 0xffff
+
+#ifdef __cplusplus
+};
+#endif
+#endif /* CTLFILE_H_INCLUDED */
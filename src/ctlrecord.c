@@ -0,0 +1,277 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include "ctlfile.h"
+#include "ctlrecord.h"
+
+/* Changes the ring holds, a power of two. */
+#define RING_SIZE 65536
+
+/* How often the writer empties the ring. */
+#define WRITE_MS 10
+
+/**
+ * A bounded ring where each cell's sequence says whose turn it is.  A
+ * cell at position pos is free for a producer when its sequence is
+ * pos, and full for the writer when it is pos + 1.
+ */
+typedef struct ctlrecord_cell_s
+{
+    uint64_t sequence;
+    uint64_t time_ns;
+    int slot;
+    int raw;
+} ctlrecord_cell_t;
+
+struct ctlrecord_s
+{
+    controlbus_t *controlbus;
+    FILE *f;
+    pthread_t thread_handle;
+    int quit;
+
+    ctlrecord_cell_t *cells;
+    uint64_t tail;
+    uint64_t head;
+
+    uint64_t start_ns;
+    uint64_t last_us;
+    unsigned int events;
+    unsigned int dropped;
+    int failed;
+};
+
+static uint64_t ctlrecord_now( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ((uint64_t) ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+static void ctlrecord_write( ctlrecord_t *ctlrecord, uint32_t delta, int slot,
+                             int raw )
+{
+    uint8_t event[ CTLFILE_EVENT_SIZE ];
+
+    if( raw < 0 ) raw = 0;
+    if( raw > 0xffff ) raw = 0xffff;
+    event[ 0 ] = delta;
+    event[ 1 ] = delta >> 8;
+    event[ 2 ] = delta >> 16;
+    event[ 3 ] = delta >> 24;
+    event[ 4 ] = slot;
+    event[ 5 ] = slot >> 8;
+    event[ 6 ] = raw;
+    event[ 7 ] = raw >> 8;
+    if( fwrite( event, sizeof( event ), 1, ctlrecord->f ) != 1 && !ctlrecord->failed ) {
+        fprintf( stderr, "ctlrecord: Failed to write log: %s\n", strerror( errno ) );
+        ctlrecord->failed = 1;
+    }
+}
+
+/**
+ * Writes an event at the given time.  Producers take their timestamps
+ * before they claim a cell, so one may land just behind the event
+ * before it, and is then written as simultaneous.
+ */
+static void ctlrecord_event( ctlrecord_t *ctlrecord, uint64_t time_ns, int slot,
+                             int raw )
+{
+    uint64_t us = (time_ns - ctlrecord->start_ns) / 1000;
+    uint64_t delta;
+
+    if( time_ns < ctlrecord->start_ns || us < ctlrecord->last_us ) {
+        us = ctlrecord->last_us;
+    }
+    delta = us - ctlrecord->last_us;
+    while( delta > UINT32_MAX ) {
+        ctlrecord_write( ctlrecord, UINT32_MAX, CTLFILE_GAP, 0 );
+        delta -= UINT32_MAX;
+    }
+    ctlrecord_write( ctlrecord, delta, slot, raw );
+    ctlrecord->last_us = us;
+    __atomic_add_fetch( &ctlrecord->events, 1, __ATOMIC_RELAXED );
+}
+
+static void ctlrecord_push( void *arg, int slot, int raw )
+{
+    ctlrecord_t *ctlrecord = arg;
+    uint64_t time_ns = ctlrecord_now();
+    uint64_t pos = __atomic_load_n( &ctlrecord->tail, __ATOMIC_RELAXED );
+    ctlrecord_cell_t *cell;
+
+    for(;;) {
+        cell = &ctlrecord->cells[ pos & (RING_SIZE - 1) ];
+        uint64_t sequence = __atomic_load_n( &cell->sequence, __ATOMIC_ACQUIRE );
+        int64_t diff = (int64_t) (sequence - pos);
+
+        if( !diff ) {
+            if( __atomic_compare_exchange_n( &ctlrecord->tail, &pos, pos + 1, 1,
+                                             __ATOMIC_RELAXED, __ATOMIC_RELAXED ) ) {
+                break;
+            }
+        } else if( diff < 0 ) {
+            __atomic_add_fetch( &ctlrecord->dropped, 1, __ATOMIC_RELAXED );
+            return;
+        } else {
+            pos = __atomic_load_n( &ctlrecord->tail, __ATOMIC_RELAXED );
+        }
+    }
+
+    cell->time_ns = time_ns;
+    cell->slot = slot;
+    cell->raw = raw;
+    __atomic_store_n( &cell->sequence, pos + 1, __ATOMIC_RELEASE );
+}
+
+/**
+ * Writes out every change waiting in the ring.  Only the writer thread
+ * calls this, until it has been joined.
+ */
+static void ctlrecord_drain( ctlrecord_t *ctlrecord )
+{
+    for(;;) {
+        uint64_t pos = ctlrecord->head;
+        ctlrecord_cell_t *cell = &ctlrecord->cells[ pos & (RING_SIZE - 1) ];
+        if( __atomic_load_n( &cell->sequence, __ATOMIC_ACQUIRE ) != pos + 1 ) break;
+
+        ctlrecord_event( ctlrecord, cell->time_ns, cell->slot, cell->raw );
+        __atomic_store_n( &cell->sequence, pos + RING_SIZE, __ATOMIC_RELEASE );
+        ctlrecord->head = pos + 1;
+    }
+}
+
+static void *ctlrecord_thread( void *arg )
+{
+    ctlrecord_t *ctlrecord = arg;
+    struct timespec wait = { 0, WRITE_MS * 1000000 };
+
+    while( !__atomic_load_n( &ctlrecord->quit, __ATOMIC_ACQUIRE ) ) {
+        ctlrecord_drain( ctlrecord );
+        nanosleep( &wait, 0 );
+    }
+    ctlrecord_drain( ctlrecord );
+    return NULL;
+}
+
+ctlrecord_t *ctlrecord_new( const char *filename, controlbus_t *controlbus )
+{
+    uint8_t header[ 16 ];
+    int count = controlbus_get_count( controlbus );
+
+    ctlrecord_t *ctlrecord = malloc( sizeof( ctlrecord_t ) );
+    if( !ctlrecord ) return 0;
+
+    ctlrecord->cells = malloc( RING_SIZE * sizeof( ctlrecord_cell_t ) );
+    if( !ctlrecord->cells ) {
+        free( ctlrecord );
+        return 0;
+    }
+    for( int i = 0; i < RING_SIZE; i++ ) {
+        ctlrecord->cells[ i ].sequence = i;
+    }
+
+    ctlrecord->f = fopen( filename, "wb" );
+    if( !ctlrecord->f ) {
+        fprintf( stderr, "ctlrecord: Cannot write %s: %s\n", filename, strerror( errno ) );
+        free( ctlrecord->cells );
+        free( ctlrecord );
+        return 0;
+    }
+
+    ctlrecord->controlbus = controlbus;
+    ctlrecord->quit = 0;
+    ctlrecord->tail = 0;
+    ctlrecord->head = 0;
+    ctlrecord->start_ns = ctlrecord_now();
+    ctlrecord->last_us = 0;
+    ctlrecord->events = 0;
+    ctlrecord->dropped = 0;
+    ctlrecord->failed = 0;
+
+    memset( header, 0, sizeof( header ) );
+    memcpy( header, CTLFILE_MAGIC, sizeof( CTLFILE_MAGIC ) );
+    header[ 8 ] = CTLFILE_VERSION;
+    header[ 12 ] = count;
+    header[ 13 ] = count >> 8;
+    fwrite( header, sizeof( header ), 1, ctlrecord->f );
+    for( int i = 0; i < count; i++ ) {
+        char name[ CTLFILE_NAME_SIZE ];
+        memset( name, 0, sizeof( name ) );
+        snprintf( name, sizeof( name ), "%s", controlbus_get_name( controlbus, i ) );
+        fwrite( name, sizeof( name ), 1, ctlrecord->f );
+    }
+
+    /* Start from the state the bus is in now. */
+    for( int i = 0; i < count; i++ ) {
+        ctlrecord_write( ctlrecord, 0, i, controlbus_get_raw( controlbus, i ) );
+    }
+
+    if( pthread_create( &ctlrecord->thread_handle, NULL,
+                        ctlrecord_thread, ctlrecord ) != 0 ) {
+        fprintf( stderr, "ctlrecord: failed to create writer thread\n" );
+        fclose( ctlrecord->f );
+        free( ctlrecord->cells );
+        free( ctlrecord );
+        return 0;
+    }
+    controlbus_set_tap( controlbus, ctlrecord_push, ctlrecord );
+    fprintf( stderr, "ctlrecord: Recording controls to %s\n", filename );
+    return ctlrecord;
+}
+
+void ctlrecord_delete( ctlrecord_t *ctlrecord )
+{
+    controlbus_set_tap( ctlrecord->controlbus, 0, 0 );
+
+    __atomic_store_n( &ctlrecord->quit, 1, __ATOMIC_RELEASE );
+    pthread_join( ctlrecord->thread_handle, NULL );
+
+    if( fclose( ctlrecord->f ) != 0 && !ctlrecord->failed ) {
+        fprintf( stderr, "ctlrecord: Failed to write log: %s\n", strerror( errno ) );
+    }
+    fprintf( stderr, "ctlrecord: %u changes recorded, %u dropped\n",
+             ctlrecord->events, ctlrecord->dropped );
+    free( ctlrecord->cells );
+    free( ctlrecord );
+}
+
+unsigned int ctlrecord_get_events( ctlrecord_t *ctlrecord )
+{
+    return __atomic_load_n( &ctlrecord->events, __ATOMIC_RELAXED );
+}
+
+unsigned int ctlrecord_get_dropped( ctlrecord_t *ctlrecord )
+{
+    return __atomic_load_n( &ctlrecord->dropped, __ATOMIC_RELAXED );
+}
@@ -0,0 +1,77 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef CTLRECORD_H_INCLUDED
+#define CTLRECORD_H_INCLUDED
+
+#include "controlbus.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Logs every change made to the control bus, from any input, to a
+ * file in the format described in ctlfile.h.  Input threads only push
+ * the change into a lock-free ring, and a writer thread of its own
+ * empties the ring to disk, so a slow disk never holds up an input.
+ * If the writer falls so far behind that the ring fills, changes are
+ * dropped and counted.
+ *
+ * The log starts with the value of every slot, so replaying it gives
+ * the same state from the first event on.
+ *
+ * Example usage:
+ *
+ * ctlrecord_t *rec = ctlrecord_new( "show.vcc", bus );
+ * start the inputs, run the show, stop the inputs
+ * ctlrecord_delete( rec );
+ */
+
+typedef struct ctlrecord_s ctlrecord_t;
+
+/**
+ * Creates the log, writes the current value of every slot, and starts
+ * recording.  Every slot must already have been added to the bus, and
+ * no input threads may be running yet.  Returns 0 on error.
+ */
+ctlrecord_t *ctlrecord_new( const char *filename, controlbus_t *controlbus );
+
+/**
+ * Stops recording and writes out the rest of the log.  No input
+ * threads may be running.
+ */
+void ctlrecord_delete( ctlrecord_t *ctlrecord );
+
+/**
+ * Returns the number of changes recorded, and the number dropped
+ * because the ring was full.
+ */
+unsigned int ctlrecord_get_events( ctlrecord_t *ctlrecord );
+unsigned int ctlrecord_get_dropped( ctlrecord_t *ctlrecord );
+
+#ifdef __cplusplus
+};
+#endif
+#endif /* CTLRECORD_H_INCLUDED */
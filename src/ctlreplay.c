@@ -0,0 +1,252 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "ctlfile.h"
+#include "ctlreplay.h"
+
+#define HEADER_SIZE 16
+
+struct ctlreplay_s
+{
+    controlbus_t *controlbus;
+    pthread_t thread_handle;
+    double speed;
+
+    void *map;
+    size_t size;
+    const uint8_t *events;
+    size_t num_events;
+
+    /* The bus slot for each slot in the log, or -1. */
+    int *slots;
+    uint32_t num_slots;
+
+    /**
+     * The next event, the log time of the last one applied, and how
+     * far ctlreplay_step() has moved the log on.
+     */
+    size_t next;
+    uint64_t time_us;
+    uint64_t clock_us;
+    uint64_t duration_us;
+    int done;
+};
+
+static uint32_t ctlreplay_read32( const uint8_t *p )
+{
+    return p[ 0 ] | (p[ 1 ] << 8) | (p[ 2 ] << 16) | ((uint32_t) p[ 3 ] << 24);
+}
+
+static uint16_t ctlreplay_read16( const uint8_t *p )
+{
+    return p[ 0 ] | (p[ 1 ] << 8);
+}
+
+ctlreplay_t *ctlreplay_new( const char *filename, controlbus_t *controlbus )
+{
+    struct stat st;
+    const uint8_t *p;
+    int fd;
+
+    fd = open( filename, O_RDONLY );
+    if( fd < 0 ) {
+        fprintf( stderr, "ctlreplay: Cannot open %s: %s\n", filename, strerror( errno ) );
+        return 0;
+    }
+    if( fstat( fd, &st ) < 0 || st.st_size < HEADER_SIZE ) {
+        fprintf( stderr, "ctlreplay: %s is not a control log\n", filename );
+        close( fd );
+        return 0;
+    }
+
+    ctlreplay_t *ctlreplay = malloc( sizeof( ctlreplay_t ) );
+    if( !ctlreplay ) {
+        close( fd );
+        return 0;
+    }
+    ctlreplay->size = st.st_size;
+    ctlreplay->map = mmap( 0, ctlreplay->size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if( ctlreplay->map == MAP_FAILED ) {
+        fprintf( stderr, "ctlreplay: Cannot map %s: %s\n", filename, strerror( errno ) );
+        free( ctlreplay );
+        return 0;
+    }
+    p = ctlreplay->map;
+
+    ctlreplay->num_slots = ctlreplay_read32( p + 12 );
+    if( memcmp( p, CTLFILE_MAGIC, sizeof( CTLFILE_MAGIC ) ) ||
+        ctlreplay_read32( p + 8 ) != CTLFILE_VERSION ||
+        (ctlreplay->size - HEADER_SIZE) / CTLFILE_NAME_SIZE < ctlreplay->num_slots ) {
+        fprintf( stderr, "ctlreplay: %s is not a control log\n", filename );
+        munmap( ctlreplay->map, ctlreplay->size );
+        free( ctlreplay );
+        return 0;
+    }
+
+    ctlreplay->slots = malloc( (ctlreplay->num_slots + 1) * sizeof( int ) );
+    if( !ctlreplay->slots ) {
+        munmap( ctlreplay->map, ctlreplay->size );
+        free( ctlreplay );
+        return 0;
+    }
+    for( uint32_t i = 0; i < ctlreplay->num_slots; i++ ) {
+        char name[ CTLFILE_NAME_SIZE + 1 ];
+        memcpy( name, p + HEADER_SIZE + (i * CTLFILE_NAME_SIZE), CTLFILE_NAME_SIZE );
+        name[ CTLFILE_NAME_SIZE ] = '\0';
+        ctlreplay->slots[ i ] = controlbus_find( controlbus, name );
+        if( ctlreplay->slots[ i ] < 0 ) {
+            fprintf( stderr, "ctlreplay: No slot %s, its changes are skipped\n", name );
+        }
+    }
+
+    ctlreplay->events = p + HEADER_SIZE + (ctlreplay->num_slots * CTLFILE_NAME_SIZE);
+    ctlreplay->num_events = (ctlreplay->size - HEADER_SIZE -
+                             (ctlreplay->num_slots * CTLFILE_NAME_SIZE)) / CTLFILE_EVENT_SIZE;
+    ctlreplay->controlbus = controlbus;
+    ctlreplay->thread_handle = 0;
+    ctlreplay->speed = 1.0;
+    ctlreplay->next = 0;
+    ctlreplay->time_us = 0;
+    ctlreplay->clock_us = 0;
+    ctlreplay->done = !ctlreplay->num_events;
+
+    ctlreplay->duration_us = 0;
+    for( size_t i = 0; i < ctlreplay->num_events; i++ ) {
+        ctlreplay->duration_us += ctlreplay_read32( ctlreplay->events + (i * CTLFILE_EVENT_SIZE) );
+    }
+
+    posix_madvise( ctlreplay->map, ctlreplay->size, POSIX_MADV_SEQUENTIAL );
+    fprintf( stderr, "ctlreplay: %s has %zu changes over %.1f seconds\n", filename,
+             ctlreplay->num_events, ctlreplay->duration_us / 1000000.0 );
+    return ctlreplay;
+}
+
+void ctlreplay_delete( ctlreplay_t *ctlreplay )
+{
+    if( ctlreplay->thread_handle ) {
+        pthread_cancel( ctlreplay->thread_handle );
+        pthread_join( ctlreplay->thread_handle, NULL );
+    }
+    munmap( ctlreplay->map, ctlreplay->size );
+    free( ctlreplay->slots );
+    free( ctlreplay );
+}
+
+/**
+ * Applies events up to the given log time, and returns how many.
+ */
+static int ctlreplay_apply( ctlreplay_t *ctlreplay, uint64_t until_us )
+{
+    int count = 0;
+
+    while( ctlreplay->next < ctlreplay->num_events ) {
+        const uint8_t *event = ctlreplay->events + (ctlreplay->next * CTLFILE_EVENT_SIZE);
+        uint64_t when = ctlreplay->time_us + ctlreplay_read32( event );
+        if( when > until_us ) break;
+
+        uint16_t slot = ctlreplay_read16( event + 4 );
+        if( slot != CTLFILE_GAP && slot < ctlreplay->num_slots &&
+            ctlreplay->slots[ slot ] >= 0 ) {
+            controlbus_set( ctlreplay->controlbus, ctlreplay->slots[ slot ],
+                            ctlreplay_read16( event + 6 ) );
+            count++;
+        }
+        ctlreplay->time_us = when;
+        ctlreplay->next++;
+    }
+    if( ctlreplay->next == ctlreplay->num_events ) {
+        __atomic_store_n( &ctlreplay->done, 1, __ATOMIC_RELEASE );
+    }
+    return count;
+}
+
+static void *ctlreplay_thread( void *arg )
+{
+    ctlreplay_t *ctlreplay = arg;
+    struct timespec start;
+
+    pthread_setcanceltype( PTHREAD_CANCEL_DEFERRED, 0 );
+    clock_gettime( CLOCK_MONOTONIC, &start );
+
+    while( ctlreplay->next < ctlreplay->num_events ) {
+        const uint8_t *event = ctlreplay->events + (ctlreplay->next * CTLFILE_EVENT_SIZE);
+        uint64_t when = ctlreplay->time_us + ctlreplay_read32( event );
+        uint64_t wall_ns = (uint64_t) ((when * 1000) / ctlreplay->speed);
+        struct timespec due;
+
+        due.tv_sec = start.tv_sec + (wall_ns / 1000000000);
+        due.tv_nsec = start.tv_nsec + (wall_ns % 1000000000);
+        if( due.tv_nsec >= 1000000000 ) {
+            due.tv_sec++;
+            due.tv_nsec -= 1000000000;
+        }
+        while( clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &due, 0 ) == EINTR );
+        ctlreplay_apply( ctlreplay, when );
+    }
+
+    fprintf( stderr, "ctlreplay: finished\n" );
+    controlbus_wake( ctlreplay->controlbus );
+    return NULL;
+}
+
+void ctlreplay_start( ctlreplay_t *ctlreplay, double speed )
+{
+    ctlreplay->speed = (speed > 0.0) ? speed : 1.0;
+    if( pthread_create( &ctlreplay->thread_handle, NULL,
+                        ctlreplay_thread, ctlreplay ) != 0 ) {
+        fprintf( stderr, "ctlreplay: failed to create replay thread\n" );
+        ctlreplay->thread_handle = 0;
+    }
+}
+
+int ctlreplay_step( ctlreplay_t *ctlreplay, int ms )
+{
+    ctlreplay->clock_us += (uint64_t) ms * 1000;
+    return ctlreplay_apply( ctlreplay, ctlreplay->clock_us );
+}
+
+int ctlreplay_is_done( ctlreplay_t *ctlreplay )
+{
+    return __atomic_load_n( &ctlreplay->done, __ATOMIC_ACQUIRE );
+}
+
+unsigned int ctlreplay_get_duration( ctlreplay_t *ctlreplay )
+{
+    return ctlreplay->duration_us / 1000;
+}
@@ -0,0 +1,93 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef CTLREPLAY_H_INCLUDED
+#define CTLREPLAY_H_INCLUDED
+
+#include "controlbus.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Plays a log written by ctlrecord back into the control bus, so the
+ * channels see the same changes the inputs made when it was recorded.
+ *
+ * It can play on a thread of its own with the original timing, or be
+ * stepped from the render loop by a fixed time per frame.  Stepping
+ * applies exactly the same changes before each frame on every run,
+ * however long the frames take, which turns a recorded show into a
+ * repeatable benchmark.
+ *
+ * Example usage:
+ *
+ * ctlreplay_t *replay = ctlreplay_new( "show.vcc", bus );
+ * while( !ctlreplay_is_done( replay ) ) {
+ *     ctlreplay_step( replay, 1000 / 30 );
+ *     render a frame
+ * }
+ * ctlreplay_delete( replay );
+ */
+
+typedef struct ctlreplay_s ctlreplay_t;
+
+/**
+ * Loads the log and finds its slots on the bus by name.  Changes to
+ * slots the bus no longer has are skipped.  Returns 0 on error.
+ */
+ctlreplay_t *ctlreplay_new( const char *filename, controlbus_t *controlbus );
+
+/**
+ * Stops playing and frees the log.
+ */
+void ctlreplay_delete( ctlreplay_t *ctlreplay );
+
+/**
+ * Starts a thread that plays the log with its original timing, scaled
+ * by speed, so 2 plays twice as fast.
+ */
+void ctlreplay_start( ctlreplay_t *ctlreplay, double speed );
+
+/**
+ * Moves the log on by ms milliseconds, applying every change up to
+ * then, and returns how many there were.  Not to be mixed with
+ * ctlreplay_start().
+ */
+int ctlreplay_step( ctlreplay_t *ctlreplay, int ms );
+
+/**
+ * Returns true once every change has been applied.
+ */
+int ctlreplay_is_done( ctlreplay_t *ctlreplay );
+
+/**
+ * Returns the length of the log in milliseconds.
+ */
+unsigned int ctlreplay_get_duration( ctlreplay_t *ctlreplay );
+
+#ifdef __cplusplus
+};
+#endif
+#endif /* CTLREPLAY_H_INCLUDED */
@@ -0,0 +1,288 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "generator.h"
+
+#define PI 3.14159265358979323846f
+
+typedef float v4sf __attribute__(( vector_size( 16 ) ));
+typedef int32_t v4si __attribute__(( vector_size( 16 ) ));
+typedef uint32_t v4su __attribute__(( vector_size( 16 ) ));
+
+typedef void (*generator_row_t)( const generator_t *generator,
+                                 const generator_params_t *params,
+                                 uint32_t *out, int y );
+
+struct generator_s
+{
+    int width;
+    int height;
+    generator_row_t row;
+};
+
+/**
+ * Sine of each lane, good to about 0.001, which is plenty for 8 bit
+ * output.  The angle is wrapped to -pi..pi and then fit with a parabola
+ * and one correction step.
+ */
+static v4sf vsin( v4sf x )
+{
+    const v4sf one = { 1.0f, 1.0f, 1.0f, 1.0f };
+    v4sf t = (x * (1.0f / (2.0f * PI))) + 0.5f;
+    v4sf whole = __builtin_convertvector( __builtin_convertvector( t, v4si ), v4sf );
+
+    /* Truncation rounds negatives up, so take one off where it did. */
+    whole -= __builtin_convertvector( whole > t, v4sf ) * -one;
+    v4sf y = ((t - whole) - 0.5f) * (2.0f * PI);
+
+    v4sf ay = (v4sf) ((v4si) y & 0x7fffffff);
+    v4sf s = (y * (4.0f / PI)) - (y * ay * (4.0f / (PI * PI)));
+    v4sf as = (v4sf) ((v4si) s & 0x7fffffff);
+    return (0.225f * ((s * as) - s)) + s;
+}
+
+/**
+ * Converts 0 to 1 to a byte.  vsin() can overshoot 1 by a hair, so the
+ * top is clamped, and it never undershoots by enough to go below zero.
+ * Conversions are signed because SSE has no unsigned float conversion.
+ */
+static v4su vbyte( v4sf x )
+{
+    v4si b = __builtin_convertvector( (x * 255.0f) + 0.5f, v4si );
+    v4si over = b > 255;
+    return (v4su) ((b & ~over) | (over & 255));
+}
+
+/**
+ * Packs four pixels of 0 to 1 channels.
+ */
+static v4su vpack( v4sf r, v4sf g, v4sf b, v4sf a )
+{
+    return vbyte( r ) | (vbyte( g ) << 8) | (vbyte( b ) << 16) |
+           (vbyte( a ) << 24);
+}
+
+/**
+ * Stores four pixels at x, or as many as fit before the end of the row.
+ */
+static void vstore( uint32_t *out, int x, int width, v4su p )
+{
+    if( x + 4 <= width ) {
+        memcpy( out + x, &p, sizeof( p ) );
+    } else {
+        memcpy( out + x, &p, (width - x) * sizeof( uint32_t ) );
+    }
+}
+
+static v4sf vx( int x )
+{
+    v4sf xs = { 0.0f, 1.0f, 2.0f, 3.0f };
+    return xs + (float) x;
+}
+
+/**
+ * Time is kept small before it goes into single precision, so patterns
+ * do not get steppy after running for a few hours.
+ */
+static float wrap_time( double time )
+{
+    return (float) fmod( time, 3600.0 );
+}
+
+/**
+ * A soft band of light rolling across the screen at an angle set by
+ * the phase.
+ */
+static void gradient_row( const generator_t *generator,
+                          const generator_params_t *params,
+                          uint32_t *out, int y )
+{
+    float angle = params->phase * 2.0f * PI;
+    float k = (1.0f + (params->detail * 15.0f)) * 2.0f * PI / generator->width;
+    float dx = cosf( angle ) * k;
+    float dy = (sinf( angle ) * k * y) - wrap_time( params->time );
+    v4sf one = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+    for( int x = 0; x < generator->width; x += 4 ) {
+        v4sf v = (vsin( (vx( x ) * dx) + dy ) * 0.5f) + 0.5f;
+        vstore( out, x, generator->width, vpack( v, v, v, one ) );
+    }
+}
+
+/**
+ * Sums of sines, coloured by running the sum through three more sines
+ * a third of a turn apart.  The phase rotates the hue.
+ */
+static void plasma_row( const generator_t *generator,
+                        const generator_params_t *params,
+                        uint32_t *out, int y )
+{
+    float t = wrap_time( params->time );
+    float k = (1.0f + (params->detail * 15.0f)) * 2.0f * PI / generator->width;
+    float hue = params->phase * 2.0f * PI;
+    float fy = (float) y * k;
+    v4sf one = { 1.0f, 1.0f, 1.0f, 1.0f };
+    v4sf row = vsin( one * ((fy * 1.3f) - (t * 0.7f)) );
+    v4sf roll = vsin( one * ((fy * 0.5f) + (t * 1.7f)) );
+
+    for( int x = 0; x < generator->width; x += 4 ) {
+        v4sf fx = vx( x ) * k;
+        v4sf v = vsin( fx + t ) + row +
+                 vsin( ((fx + fy) * 0.7f) + (t * 1.1f) ) +
+                 (vsin( fx * 0.5f ) * roll);
+        v *= PI * 0.5f;
+
+        v4sf r = (vsin( v + hue ) * 0.5f) + 0.5f;
+        v4sf g = (vsin( v + hue + (2.0f * PI / 3.0f) ) * 0.5f) + 0.5f;
+        v4sf b = (vsin( v + hue + (4.0f * PI / 3.0f) ) * 0.5f) + 0.5f;
+        vstore( out, x, generator->width, vpack( r, g, b, one ) );
+    }
+}
+
+/**
+ * Grey static from an integer hash of the cell and the frame.  Detail
+ * sets the grain, from single pixels up to 16 pixel blocks.
+ */
+static void noise_row( const generator_t *generator,
+                       const generator_params_t *params,
+                       uint32_t *out, int y )
+{
+    int cell = 16 - (int) (params->detail * 15.0f);
+    uint32_t seed = (uint32_t) (int64_t) (params->time * 30.0);
+    uint32_t ry = ((uint32_t) (y / cell) * 19349663u) ^ (seed * 83492791u);
+    float inv = 1.0f / cell;
+
+    for( int x = 0; x < generator->width; x += 4 ) {
+        v4su h = (v4su) __builtin_convertvector( vx( x ) * inv, v4si );
+        h = (h * 73856093u) ^ ry;
+        h ^= h >> 13;
+        h *= 0x5bd1e995u;
+        h ^= h >> 15;
+        h >>= 24;
+        vstore( out, x, generator->width,
+                h | (h << 8) | (h << 16) | 0xff000000u );
+    }
+}
+
+static void fill_row( const generator_t *generator, uint32_t *out,
+                      uint32_t pixel )
+{
+    for( int x = 0; x < generator->width; x++ ) {
+        out[ x ] = pixel;
+    }
+}
+
+/**
+ * Dark lines scrolling down the screen, one period a second, to lay
+ * over other channels.  Detail sets the spacing from 2 to 32 pixels.
+ */
+static void scanlines_row( const generator_t *generator,
+                           const generator_params_t *params,
+                           uint32_t *out, int y )
+{
+    float period = 2.0f + (params->detail * 30.0f);
+    float pos = ((float) y / period) - wrap_time( params->time ) +
+                params->phase;
+    float a = 0.5f + (0.5f * sinf( pos * 2.0f * PI ));
+
+    fill_row( generator, out, (uint32_t) ((a * 255.0f) + 0.5f) << 24 );
+}
+
+/**
+ * A white flash from 1 to 30 times a second, with the phase moving the
+ * flash within each cycle.
+ */
+static void strobe_row( const generator_t *generator,
+                        const generator_params_t *params,
+                        uint32_t *out, int y )
+{
+    double rate = 1.0 + (params->detail * 29.0);
+    double cycle = (params->time * rate) + params->phase;
+    int on = (cycle - floor( cycle )) < 0.5;
+
+    fill_row( generator, out, on ? 0xffffffffu : 0x00ffffffu );
+}
+
+static const struct
+{
+    const char *name;
+    generator_row_t row;
+} patterns[] =
+{
+    { "gradient", gradient_row },
+    { "plasma", plasma_row },
+    { "noise", noise_row },
+    { "scanlines", scanlines_row },
+    { "strobe", strobe_row }
+};
+
+generator_t *generator_new( const char *pattern, int width, int height )
+{
+    generator_row_t row = 0;
+
+    for( size_t i = 0; i < sizeof( patterns ) / sizeof( patterns[ 0 ] ); i++ ) {
+        if( !strcmp( patterns[ i ].name, pattern ) ) row = patterns[ i ].row;
+    }
+    if( !row ) {
+        fprintf( stderr, "generator: Unknown pattern '%s'\n", pattern );
+        return 0;
+    }
+
+    generator_t *generator = malloc( sizeof( generator_t ) );
+    if( !generator ) return 0;
+
+    generator->width = width;
+    generator->height = height;
+    generator->row = row;
+    return generator;
+}
+
+void generator_delete( generator_t *generator )
+{
+    free( generator );
+}
+
+int generator_get_width( generator_t *generator )
+{
+    return generator->width;
+}
+
+int generator_get_height( generator_t *generator )
+{
+    return generator->height;
+}
+
+void generator_render( const generator_t *generator,
+                       const generator_params_t *params, uint8_t *pixels,
+                       int stride, int first, int count )
+{
+    for( int y = first; y < first + count && y < generator->height; y++ ) {
+        generator->row( generator, params,
+                        (uint32_t *) (pixels + ((size_t) y * stride)), y );
+    }
+}
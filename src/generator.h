@@ -0,0 +1,93 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GENERATOR_H_INCLUDED
+#define GENERATOR_H_INCLUDED
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Procedural patterns computed on the CPU: gradient, plasma, noise,
+ * scanlines and strobe.  A pattern is a pure function of its parameters,
+ * so any band of rows can be rendered on its own, and bands can be
+ * spread across a workpool.  The kernels work on four pixels at a time
+ * using GCC vector extensions.
+ *
+ * Pixels are 32 bit words with red in the low byte and alpha in the
+ * high byte, which is SDL_PIXELFORMAT_ABGR8888.
+ *
+ * Example usage:
+ *
+ * generator_t *gen = generator_new( "plasma", 720, 480 );
+ * generator_params_t params = { seconds, 0.5, 0.0 };
+ *
+ * generator_render( gen, &params, pixels, 720 * 4, 0, 480 );
+ * generator_delete( gen );
+ */
+
+typedef struct generator_s generator_t;
+
+typedef struct generator_params_s
+{
+    /* Time in seconds, which moves the pattern. */
+    double time;
+
+    /* How fine the pattern is, from 0 to 1. */
+    float detail;
+
+    /* A pattern specific offset from 0 to 1, such as angle or hue. */
+    float phase;
+} generator_params_t;
+
+/**
+ * Creates a generator for the named pattern at the given size.  Returns
+ * 0 if the pattern is unknown.
+ */
+generator_t *generator_new( const char *pattern, int width, int height );
+
+/**
+ * Frees the generator.
+ */
+void generator_delete( generator_t *generator );
+
+int generator_get_width( generator_t *generator );
+int generator_get_height( generator_t *generator );
+
+/**
+ * Renders rows first to first+count-1 into pixels, which points at row
+ * 0 and has stride bytes per row.  Safe to call from several threads at
+ * once on different rows.
+ */
+void generator_render( const generator_t *generator,
+                       const generator_params_t *params, uint8_t *pixels,
+                       int stride, int first, int count );
+
+#ifdef __cplusplus
+};
+#endif
+#endif /* GENERATOR_H_INCLUDED */
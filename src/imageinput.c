@@ -0,0 +1,210 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "bufpool.h"
+#include "pnginput.h"
+#include "qoiinput.h"
+#include "tgainput.h"
+#include "imageinput.h"
+
+#define PNG_MAGIC "\x89PNG\r\n\x1a\n"
+#define QOI_MAGIC "qoif"
+
+typedef enum
+{
+    FORMAT_PNG,
+    FORMAT_QOI,
+    FORMAT_TGA
+} imageformat_t;
+
+static const char *format_names[] = { "PNG", "QOI", "TGA" };
+
+struct imageinput_s
+{
+    imageformat_t format;
+    pnginput_t *png;
+    qoiinput_t *qoi;
+    tgainput_t *tga;
+};
+
+/**
+ * Decodes QOI or TGA from a copy of the file read into a pooled buffer,
+ * as pnginput does.  A file being saved may shrink while it is read, so
+ * this only decodes what was there, and the decoders reject it if that
+ * is not a whole image.
+ */
+static int imageinput_decode_buffered( imageinput_t *imageinput,
+                                       const char *filename, int fd,
+                                       size_t size )
+{
+    uint8_t *data = bufpool_alloc( size ? size : 1 );
+    size_t done = 0;
+
+    if( !data ) {
+        fprintf( stderr, "imageinput: No memory for %s.\n", filename );
+        return 0;
+    }
+    while( done < size ) {
+        ssize_t len = pread( fd, data + done, size - done, done );
+        if( len < 0 && errno == EINTR ) continue;
+        if( len < 0 ) {
+            fprintf( stderr, "imageinput: Cannot read %s: %s\n",
+                     filename, strerror( errno ) );
+            bufpool_free( data );
+            return 0;
+        }
+        if( !len ) break;
+        done += len;
+    }
+
+    if( imageinput->format == FORMAT_QOI ) {
+        imageinput->qoi = qoiinput_new( filename, data, done );
+    } else {
+        imageinput->tga = tgainput_new( filename, data, done );
+    }
+    bufpool_free( data );
+    return imageinput->qoi || imageinput->tga;
+}
+
+imageinput_t *imageinput_new( const char *filename )
+{
+    imageinput_t *imageinput = bufpool_alloc( sizeof( imageinput_t ) );
+    uint8_t magic[ 18 ];
+    struct stat st;
+    ssize_t len;
+    int fd;
+
+    if( !imageinput ) return 0;
+    imageinput->png = 0;
+    imageinput->qoi = 0;
+    imageinput->tga = 0;
+
+    fd = open( filename, O_RDONLY );
+    if( fd < 0 ) {
+        fprintf( stderr, "imageinput: Cannot open %s: %s\n",
+                 filename, strerror( errno ) );
+        bufpool_free( imageinput );
+        return 0;
+    }
+
+    len = read( fd, magic, sizeof( magic ) );
+    if( len < 0 || fstat( fd, &st ) < 0 ) {
+        fprintf( stderr, "imageinput: Cannot read %s: %s\n",
+                 filename, strerror( errno ) );
+        close( fd );
+        bufpool_free( imageinput );
+        return 0;
+    }
+
+    if( len >= 8 && !memcmp( magic, PNG_MAGIC, 8 ) ) {
+        imageinput->format = FORMAT_PNG;
+    } else if( len >= 4 && !memcmp( magic, QOI_MAGIC, 4 ) ) {
+        imageinput->format = FORMAT_QOI;
+    } else if( tgainput_probe( magic, len ) ) {
+        imageinput->format = FORMAT_TGA;
+    } else {
+        fprintf( stderr, "imageinput: %s is not a PNG, QOI or TGA file.\n",
+                 filename );
+        close( fd );
+        bufpool_free( imageinput );
+        return 0;
+    }
+
+    if( imageinput->format == FORMAT_PNG ) {
+        close( fd );
+        imageinput->png = pnginput_new( filename );
+        if( !imageinput->png ) {
+            bufpool_free( imageinput );
+            return 0;
+        }
+        return imageinput;
+    }
+
+    int ok = imageinput_decode_buffered( imageinput, filename, fd, st.st_size );
+    close( fd );
+    if( !ok ) {
+        bufpool_free( imageinput );
+        return 0;
+    }
+    return imageinput;
+}
+
+void imageinput_delete( imageinput_t *imageinput )
+{
+    if( imageinput->png ) pnginput_delete( imageinput->png );
+    if( imageinput->qoi ) qoiinput_delete( imageinput->qoi );
+    if( imageinput->tga ) tgainput_delete( imageinput->tga );
+    bufpool_free( imageinput );
+}
+
+const char *imageinput_get_format( imageinput_t *imageinput )
+{
+    return format_names[ imageinput->format ];
+}
+
+unsigned int imageinput_get_width( imageinput_t *imageinput )
+{
+    switch( imageinput->format ) {
+    case FORMAT_QOI: return qoiinput_get_width( imageinput->qoi );
+    case FORMAT_TGA: return tgainput_get_width( imageinput->tga );
+    default: return pnginput_get_width( imageinput->png );
+    }
+}
+
+unsigned int imageinput_get_height( imageinput_t *imageinput )
+{
+    switch( imageinput->format ) {
+    case FORMAT_QOI: return qoiinput_get_height( imageinput->qoi );
+    case FORMAT_TGA: return tgainput_get_height( imageinput->tga );
+    default: return pnginput_get_height( imageinput->png );
+    }
+}
+
+uint8_t *imageinput_get_scanline( imageinput_t *imageinput, int num )
+{
+    switch( imageinput->format ) {
+    case FORMAT_QOI: return qoiinput_get_scanline( imageinput->qoi, num );
+    case FORMAT_TGA: return tgainput_get_scanline( imageinput->tga, num );
+    default: return pnginput_get_scanline( imageinput->png, num );
+    }
+}
+
+int imageinput_has_alpha( imageinput_t *imageinput )
+{
+    switch( imageinput->format ) {
+    case FORMAT_QOI: return qoiinput_has_alpha( imageinput->qoi );
+    case FORMAT_TGA: return tgainput_has_alpha( imageinput->tga );
+    default: return pnginput_has_alpha( imageinput->png );
+    }
+}
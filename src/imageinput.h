@@ -0,0 +1,88 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef IMAGEINPUT_H_INCLUDED
+#define IMAGEINPUT_H_INCLUDED
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Opens an image in any of the formats we read, telling them apart by
+ * their first few bytes rather than their name.  PNG is smallest on
+ * disk, QOI is several times quicker to decode at a similar size, and
+ * uncompressed TGA is quicker still, so art that is swapped often while
+ * playing can be saved as QOI or TGA.  Scanlines come out the same way
+ * whatever the format, RGB or RGBA, so callers need not care which it
+ * was.
+ *
+ * Example usage:
+ *
+ * imageinput_t *image = imageinput_new( "myimage.qoi" );
+ *
+ * for( i = 0; i < imageinput_get_height( image ); i++ ) {
+ *     uint8_t *scanline = imageinput_get_scanline( image, i );
+ *     ...
+ * }
+ *
+ * imageinput_delete( image );
+ */
+
+typedef struct imageinput_s imageinput_t;
+
+/**
+ * Opens and decodes the filename.  Returns 0 on error.
+ */
+imageinput_t *imageinput_new( const char *filename );
+
+/**
+ * Closes the image.
+ */
+void imageinput_delete( imageinput_t *imageinput );
+
+/**
+ * Returns the name of the format the image was read as.
+ */
+const char *imageinput_get_format( imageinput_t *imageinput );
+
+unsigned int imageinput_get_width( imageinput_t *imageinput );
+unsigned int imageinput_get_height( imageinput_t *imageinput );
+
+/**
+ * Returns a pointer to the given scanline from 0 to height-1.
+ */
+uint8_t *imageinput_get_scanline( imageinput_t *imageinput, int num );
+
+/**
+ * Returns true if this image has an alpha channel.
+ */
+int imageinput_has_alpha( imageinput_t *imageinput );
+
+#ifdef __cplusplus
+};
+#endif
+#endif /* IMAGEINPUT_H_INCLUDED */
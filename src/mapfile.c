@@ -0,0 +1,231 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include "mapping.h"
+#include "mapfile.h"
+
+#define MAX_BINDINGS 256
+
+/* How often the file is checked for changes. */
+#define WATCH_MS 500
+
+typedef struct binding_s
+{
+    int slot;
+    mapping_t *mapping;
+} binding_t;
+
+typedef struct bindings_s
+{
+    int count;
+    binding_t bindings[ MAX_BINDINGS ];
+} bindings_t;
+
+struct mapfile_s
+{
+    const char *filename;
+    controlbus_t *controlbus;
+    struct timespec last_mtime;
+    pthread_t thread_handle;
+
+    /**
+     * The mappings in use, and those replaced by the last reload.  Input
+     * threads may still be reading a replaced mapping for a moment, so
+     * they are only freed on the reload after that.
+     */
+    bindings_t *current;
+    bindings_t *retired;
+};
+
+static void bindings_free( bindings_t *bindings )
+{
+    if( !bindings ) return;
+    for( int i = 0; i < bindings->count; i++ ) {
+        mapping_delete( bindings->bindings[ i ].mapping );
+    }
+    free( bindings );
+}
+
+static bindings_t *mapfile_parse( mapfile_t *mapfile, FILE *f )
+{
+    bindings_t *bindings = malloc( sizeof( bindings_t ) );
+    char line[ 512 ];
+    int lineno = 0;
+
+    if( !bindings ) return 0;
+    bindings->count = 0;
+
+    while( fgets( line, sizeof( line ), f ) ) {
+        char name[ 64 ];
+        int len;
+
+        lineno++;
+        char *hash = strchr( line, '#' );
+        if( hash ) *hash = '\0';
+        if( sscanf( line, " %63s %n", name, &len ) < 1 ) continue;
+
+        int slot = controlbus_find( mapfile->controlbus, name );
+        if( slot < 0 ) {
+            fprintf( stderr, "mapfile: %s:%d: no control named %s\n",
+                     mapfile->filename, lineno, name );
+            continue;
+        }
+        if( bindings->count == MAX_BINDINGS ) {
+            fprintf( stderr, "mapfile: %s:%d: too many mappings\n",
+                     mapfile->filename, lineno );
+            break;
+        }
+
+        mapping_t *mapping = mapping_new( line + len );
+        if( !mapping ) {
+            fprintf( stderr, "mapfile: %s:%d: bad mapping for %s\n",
+                     mapfile->filename, lineno, name );
+            continue;
+        }
+        bindings->bindings[ bindings->count ].slot = slot;
+        bindings->bindings[ bindings->count ].mapping = mapping;
+        bindings->count++;
+    }
+    return bindings;
+}
+
+static int bindings_has_slot( bindings_t *bindings, int slot )
+{
+    for( int i = 0; bindings && i < bindings->count; i++ ) {
+        if( bindings->bindings[ i ].slot == slot ) return 1;
+    }
+    return 0;
+}
+
+/**
+ * Swaps each slot straight from its old mapping to its new one, and
+ * only then restores the default of slots the new file leaves out, so
+ * a frame drawn during a reload never sees a default in between.
+ */
+static void mapfile_apply( mapfile_t *mapfile, bindings_t *bindings )
+{
+    for( int i = 0; bindings && i < bindings->count; i++ ) {
+        controlbus_set_mapping( mapfile->controlbus,
+                                bindings->bindings[ i ].slot,
+                                bindings->bindings[ i ].mapping );
+    }
+    for( int i = 0; mapfile->current && i < mapfile->current->count; i++ ) {
+        int slot = mapfile->current->bindings[ i ].slot;
+        if( !bindings_has_slot( bindings, slot ) ) {
+            controlbus_set_mapping( mapfile->controlbus, slot, 0 );
+        }
+    }
+
+    bindings_free( mapfile->retired );
+    mapfile->retired = mapfile->current;
+    mapfile->current = bindings;
+}
+
+/**
+ * Reloads the file if it has changed since the last load.
+ */
+static void mapfile_check( mapfile_t *mapfile )
+{
+    struct stat s;
+
+    if( stat( mapfile->filename, &s ) < 0 ) return;
+    if( s.st_mtim.tv_sec == mapfile->last_mtime.tv_sec &&
+        s.st_mtim.tv_nsec == mapfile->last_mtime.tv_nsec ) {
+        return;
+    }
+    mapfile->last_mtime = s.st_mtim;
+
+    FILE *f = fopen( mapfile->filename, "r" );
+    if( !f ) return;
+    bindings_t *bindings = mapfile_parse( mapfile, f );
+    fclose( f );
+
+    if( bindings ) {
+        mapfile_apply( mapfile, bindings );
+        fprintf( stderr, "mapfile: loaded %d mappings from %s\n",
+                 bindings->count, mapfile->filename );
+    }
+}
+
+mapfile_t *mapfile_new( const char *filename, controlbus_t *controlbus )
+{
+    mapfile_t *mapfile = malloc( sizeof( mapfile_t ) );
+    if( !mapfile ) return 0;
+
+    mapfile->filename = filename;
+    mapfile->controlbus = controlbus;
+    mapfile->last_mtime.tv_sec = 0;
+    mapfile->last_mtime.tv_nsec = 0;
+    mapfile->thread_handle = 0;
+    mapfile->current = 0;
+    mapfile->retired = 0;
+
+    mapfile_check( mapfile );
+    return mapfile;
+}
+
+void mapfile_delete( mapfile_t *mapfile )
+{
+    if( mapfile->thread_handle ) {
+        pthread_cancel( mapfile->thread_handle );
+        pthread_join( mapfile->thread_handle, NULL );
+    }
+    mapfile_apply( mapfile, 0 );
+    bindings_free( mapfile->retired );
+    free( mapfile );
+}
+
+static void *thread_thunk( void *arg )
+{
+    mapfile_t *mapfile = arg;
+    struct timespec wait = { 0, WATCH_MS * 1000000L };
+
+    pthread_setcanceltype( PTHREAD_CANCEL_DEFERRED, 0 );
+    for(;;) {
+        nanosleep( &wait, 0 );
+        pthread_testcancel();
+
+        /* Only stop between reloads, never half way through one. */
+        pthread_setcancelstate( PTHREAD_CANCEL_DISABLE, 0 );
+        mapfile_check( mapfile );
+        pthread_setcancelstate( PTHREAD_CANCEL_ENABLE, 0 );
+    }
+    return NULL;
+}
+
+void mapfile_start( mapfile_t *mapfile )
+{
+    if( pthread_create( &mapfile->thread_handle, NULL, thread_thunk, mapfile ) != 0 ) {
+        fprintf( stderr, "mapfile: failed to create watcher thread\n" );
+    }
+}
@@ -0,0 +1,70 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MAPFILE_H_INCLUDED
+#define MAPFILE_H_INCLUDED
+
+#include "controlbus.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Loads control mappings from a text file and applies them to the bus,
+ * then watches the file and reapplies it whenever it changes.  Each
+ * line names a slot followed by its mapping options, as described in
+ * mapping.h:
+ *
+ *   # slot         mapping
+ *   ch0.y_offset   invert curve=exp
+ *   ch1.x_offset   range=0.25,0.75 steps=8
+ *   ch1.y_control  deadzone=0.02 curve=log
+ *
+ * Slots not named in the file use their default mapping.  Mappings are
+ * compiled on the watcher thread, so a reload never stalls a frame.
+ */
+
+typedef struct mapfile_s mapfile_t;
+
+/**
+ * Loads the file, if it exists, and applies it to the bus.
+ */
+mapfile_t *mapfile_new( const char *filename, controlbus_t *controlbus );
+
+/**
+ * Stops watching and frees every mapping the file created.  The bus
+ * slots are returned to their defaults.
+ */
+void mapfile_delete( mapfile_t *mapfile );
+
+/**
+ * Starts the thread that watches the file for changes.
+ */
+void mapfile_start( mapfile_t *mapfile );
+
+#ifdef __cplusplus
+};
+#endif
+#endif /* MAPFILE_H_INCLUDED */
@@ -0,0 +1,159 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "mapping.h"
+
+/* Steepness of the exp and log curves. */
+#define CURVE_K 4.0
+
+enum
+{
+    CURVE_LINEAR,
+    CURVE_EXP,
+    CURVE_LOG,
+    CURVE_SCURVE
+};
+
+struct mapping_s
+{
+    int lut[ MAPPING_MAX + 1 ];
+};
+
+static double shape( int curve, double x )
+{
+    switch( curve ) {
+    case CURVE_EXP:
+        return (exp( CURVE_K * x ) - 1.0) / (exp( CURVE_K ) - 1.0);
+    case CURVE_LOG:
+        return log( 1.0 + (exp( CURVE_K ) - 1.0) * x ) / CURVE_K;
+    case CURVE_SCURVE:
+        return x * x * (3.0 - (2.0 * x));
+    default:
+        return x;
+    }
+}
+
+/**
+ * Returns how far along its travel a raw input is, from 0 to 1.  Each
+ * half of the range is scaled separately so the centre, MAPPING_CENTRE,
+ * lands on exactly one half, as centred parameters expect.
+ */
+static double mapping_position( int raw )
+{
+    if( raw <= MAPPING_CENTRE ) {
+        return (double) raw / (2 * MAPPING_CENTRE);
+    }
+    return 0.5 + ((double) (raw - MAPPING_CENTRE) /
+                  (2 * (MAPPING_MAX - MAPPING_CENTRE)));
+}
+
+mapping_t *mapping_new( const char *spec )
+{
+    int invert = 0;
+    int curve = CURVE_LINEAR;
+    double deadzone = 0.0;
+    int steps = 0;
+    double lo = 0.0;
+    double hi = 1.0;
+    char buf[ 256 ];
+    char *save;
+
+    snprintf( buf, sizeof( buf ), "%s", spec );
+    for( char *tok = strtok_r( buf, " \t\n", &save ); tok;
+         tok = strtok_r( 0, " \t\n", &save ) ) {
+        if( !strcmp( tok, "invert" ) ) {
+            invert = 1;
+        } else if( !strcmp( tok, "curve=linear" ) ) {
+            curve = CURVE_LINEAR;
+        } else if( !strcmp( tok, "curve=exp" ) ) {
+            curve = CURVE_EXP;
+        } else if( !strcmp( tok, "curve=log" ) ) {
+            curve = CURVE_LOG;
+        } else if( !strcmp( tok, "curve=scurve" ) ) {
+            curve = CURVE_SCURVE;
+        } else if( sscanf( tok, "deadzone=%lf", &deadzone ) == 1 ) {
+            if( deadzone < 0.0 || deadzone >= 1.0 ) {
+                fprintf( stderr, "mapping: deadzone must be from 0 to 1: %s\n", tok );
+                return 0;
+            }
+        } else if( sscanf( tok, "steps=%d", &steps ) == 1 ) {
+            if( steps < 2 ) {
+                fprintf( stderr, "mapping: need at least 2 steps: %s\n", tok );
+                return 0;
+            }
+        } else if( sscanf( tok, "range=%lf,%lf", &lo, &hi ) == 2 ) {
+            /* lo > hi is allowed, and inverts the range. */
+        } else {
+            fprintf( stderr, "mapping: unknown option '%s'\n", tok );
+            return 0;
+        }
+    }
+
+    mapping_t *mapping = malloc( sizeof( mapping_t ) );
+    if( !mapping ) return 0;
+
+    for( int i = 0; i <= MAPPING_MAX; i++ ) {
+        double x = mapping_position( i );
+
+        x = (x <= deadzone) ? 0.0 : (x - deadzone) / (1.0 - deadzone);
+        x = shape( curve, x );
+        if( invert ) x = 1.0 - x;
+        if( steps ) x = floor( (x * (steps - 1)) + 0.5 ) / (steps - 1);
+        x = lo + (x * (hi - lo));
+
+        mapping->lut[ i ] = (int) floor( (x * MAPPING_ONE) + 0.5 );
+    }
+    return mapping;
+}
+
+void mapping_delete( mapping_t *mapping )
+{
+    free( mapping );
+}
+
+int mapping_apply( const mapping_t *mapping, int raw )
+{
+    if( raw < 0 ) raw = 0;
+    if( raw > MAPPING_MAX ) raw = MAPPING_MAX;
+    return mapping->lut[ raw ];
+}
+
+int mapping_from_7bit( int value )
+{
+    if( value <= 64 ) return value << 7;
+    return MAPPING_CENTRE + (((value - 64) * (MAPPING_MAX - MAPPING_CENTRE)) / 63);
+}
+
+int mapping_from_unit( float value )
+{
+    if( !(value > 0.0f) ) return 0;
+    if( value >= 1.0f ) return MAPPING_MAX;
+    return (int) ((value * MAPPING_MAX) + 0.5f);
+}
@@ -0,0 +1,99 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MAPPING_H_INCLUDED
+#define MAPPING_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A mapping shapes raw control input into a parameter value.  Inputs all
+ * publish in a common 14 bit range, 0 to MAPPING_MAX, and mappings
+ * produce a fraction of the parameter's range in 16.16 fixed point,
+ * 0 to MAPPING_ONE.  A linear mapping takes MAPPING_CENTRE to exactly
+ * half, so centred parameters such as rotation rest at zero.  The whole
+ * curve is compiled into a lookup table when the mapping is made, so
+ * applying it is a single table fetch.
+ *
+ * Mappings are described by a string of options:
+ *
+ *   invert            flip the output, so the low end of the input
+ *                     gives the high end of the parameter
+ *   curve=linear      the default
+ *   curve=exp         slow at the bottom, fast at the top
+ *   curve=log         fast at the bottom, slow at the top
+ *   curve=scurve      slow at both ends
+ *   deadzone=0.05     ignore the bottom 5% of travel
+ *   steps=8           quantize the output to 8 levels
+ *   range=0.25,0.75   use only this part of the parameter's range
+ *
+ * Example usage:
+ *
+ * mapping_t *mapping = mapping_new( "invert curve=exp" );
+ * int value = mapping_apply( mapping, raw );
+ * mapping_delete( mapping );
+ */
+
+#define MAPPING_BITS 14
+#define MAPPING_MAX ((1 << MAPPING_BITS) - 1)
+#define MAPPING_CENTRE (1 << (MAPPING_BITS - 1))
+#define MAPPING_ONE 65536
+
+typedef struct mapping_s mapping_t;
+
+/**
+ * Compiles a mapping from its description.  Returns 0 and prints the
+ * problem if the description cannot be parsed.
+ */
+mapping_t *mapping_new( const char *spec );
+
+/**
+ * Frees the mapping.
+ */
+void mapping_delete( mapping_t *mapping );
+
+/**
+ * Maps a raw input, which is clamped to 0 to MAPPING_MAX.
+ */
+int mapping_apply( const mapping_t *mapping, int raw );
+
+/**
+ * Converts a 7 bit MIDI value to the 14 bit input range.  Both ends
+ * and the centre value 64 are kept exact.
+ */
+int mapping_from_7bit( int value );
+
+/**
+ * Converts a value from 0 to 1, as sent by OSC faders, to the 14 bit
+ * input range.  Out of range values and NaN are clamped.  A value of
+ * 0.5 gives MAPPING_CENTRE.
+ */
+int mapping_from_unit( float value );
+
+#ifdef __cplusplus
+};
+#endif
+#endif /* MAPPING_H_INCLUDED */
@@ -27,6 +27,8 @@
 #include <string.h>
 #include <sys/time.h>
 #include <alsa/asoundlib.h>
+#include <pthread.h>
+#include "mapping.h"
 #include "minput.h"
 
 #define MAX_TARGETS 32
@@ -34,17 +36,28 @@
 struct minput_s
 {
     snd_rawmidi_t *midi_in;
-    int c_active;
-    int c_id;
-    int *targets[ 32 ];
+    controlbus_t *controlbus;
+    int targets[ MAX_TARGETS ];
+    minput_note_t note_tap;
+    void *note_arg;
+
+    /**
+     * The status of the message being read, if it is one we handle, and
+     * its first data byte.  Running status is kept between messages.
+     */
+    int m_status;
+    int m_data;
+    pthread_t thread_handle;
 };
 
-minput_t *minput_new( const char *portname )
+minput_t *minput_new( const char *portname, controlbus_t *controlbus )
 {
     minput_t *minput = malloc( sizeof( minput_t ) );
     int mode = SND_RAWMIDI_NONBLOCK;
     int status;
 
+    minput->thread_handle = 0;
+
     status = snd_rawmidi_open( &minput->midi_in, NULL, portname, mode );
     if( status < 0 ) {
         fprintf( stderr, "minput: cannot open midi device: %s\n",
@@ -53,49 +66,99 @@ minput_t *minput_new( const char *portname )
         return 0;
     }
 
-    minput->c_active = 0;
-    minput->c_id = -1;
+    /* Open without blocking on a busy port, but block the reader thread. */
+    snd_rawmidi_nonblock( minput->midi_in, 0 );
+
+    minput->controlbus = controlbus;
+    minput->note_tap = 0;
+    minput->note_arg = 0;
+    minput->m_status = 0;
+    minput->m_data = -1;
     for( int i = 0; i < MAX_TARGETS; i++ ) {
-        minput->targets[ i ] = NULL;
+        minput->targets[ i ] = -1;
     }
     return minput;
 }
 
 void minput_delete( minput_t *minput )
 {
+    if( minput->thread_handle ) {
+        fprintf( stderr, "minput: cancel midi thread\n" );
+        pthread_cancel( minput->thread_handle );
+        pthread_join( minput->thread_handle, NULL );
+        fprintf( stderr, "minput: midi thread joined!\n" );
+    }
     snd_rawmidi_close( minput->midi_in );
     free( minput );
 }
 
-void minput_set_control( minput_t *minput, int controller, int *target )
+void minput_set_control( minput_t *minput, int controller, int slot )
+{
+    if( controller >= 0 && controller < MAX_TARGETS ) {
+        minput->targets[ controller ] = slot;
+    }
+}
+
+void minput_set_note_tap( minput_t *minput, minput_note_t tap, void *arg )
+{
+    minput->note_tap = tap;
+    minput->note_arg = arg;
+}
+
+static void minput_message( minput_t *minput, int status, int data1, int data2 )
 {
-    minput->targets[ controller ] = target;
+    if( status == 0xb0 ) {
+        if( data1 < MAX_TARGETS ) {
+            // fprintf( stderr, "MIDI: id %d, value %d\n", data1, data2 );
+            controlbus_set( minput->controlbus, minput->targets[ data1 ],
+                            mapping_from_7bit( data2 ) );
+        }
+    } else if( status == 0x90 && data2 > 0 && minput->note_tap ) {
+        minput->note_tap( minput->note_arg, data1, data2 );
+    }
 }
 
-void minput_check( minput_t *minput )
+static void minput_check( minput_t *minput )
 {
     int status;
-    char buffer[ 1 ];
+    unsigned char buffer[ 1 ];
     for(;;) {
+        pthread_testcancel();
         status = snd_rawmidi_read( minput->midi_in, buffer, 1 );
-        if( status == -EAGAIN ) return;
-        if( status >= 0 ) {
-            if( minput->c_id >= 0 ) {
-                int id = minput->c_id;
-                if( id >= 0 && id < MAX_TARGETS ) {
-                    if( minput->targets[ id ] ) {
-                        // fprintf( stderr, "MIDI: id %d, value %d\n", id, buffer[ 0 ] );
-                        *minput->targets[ id ] = buffer[ 0 ];
-                    }
-                }
-                minput->c_active = 0;
-                minput->c_id = -1;
-            } else if( minput->c_active ) {
-                minput->c_id = buffer[ 0 ];
-            } else if( buffer[ 0 ] == 0xb0 ) {
-                minput->c_active = 1;
+        if( status < 0 && status != -EAGAIN && status != -EINTR ) {
+            fprintf( stderr, "minput: read failed: %s\n", snd_strerror( status ) );
+            return;
+        }
+        if( status > 0 ) {
+            if( buffer[ 0 ] >= 0xf8 ) {
+                /* Realtime messages may come between any two bytes. */
+            } else if( buffer[ 0 ] & 0x80 ) {
+                /* Control changes and notes on the first channel. */
+                int type = buffer[ 0 ];
+                minput->m_status = (type == 0xb0 || type == 0x90) ? type : 0;
+                minput->m_data = -1;
+            } else if( minput->m_status && minput->m_data < 0 ) {
+                minput->m_data = buffer[ 0 ];
+            } else if( minput->m_status ) {
+                minput_message( minput, minput->m_status, minput->m_data,
+                                buffer[ 0 ] );
+                minput->m_data = -1;
             }
         }
     }
 }
 
+static void *thread_thunk( void *min )
+{
+    pthread_setcanceltype( PTHREAD_CANCEL_DEFERRED, 0 );
+    fprintf( stderr, "minput: thread main\n" );
+    minput_check( min );
+    return NULL;
+}
+
+void minput_start( minput_t *minput )
+{
+    if( pthread_create( &minput->thread_handle, NULL, thread_thunk, minput ) != 0 ) {
+        fprintf( stderr, "minput: failed to create midi thread\n" );
+    }
+}
@@ -26,6 +26,7 @@
 #define MINPUT_H_INCLUDED
 
 #include <stdint.h>
+#include "controlbus.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -33,10 +34,17 @@ extern "C" {
 
 typedef struct minput_s minput_t;
 
-minput_t *minput_new( const char *portname );
+/**
+ * Called on the midi thread with every note-on.  Must be quick and must
+ * not block.
+ */
+typedef void (*minput_note_t)( void *arg, int note, int velocity );
+
+minput_t *minput_new( const char *portname, controlbus_t *controlbus );
 void minput_delete( minput_t *minput );
-void minput_set_control( minput_t *minput, int controller, int *target );
-void minput_check( minput_t *minput );
+void minput_set_control( minput_t *minput, int controller, int slot );
+void minput_set_note_tap( minput_t *minput, minput_note_t tap, void *arg );
+void minput_start( minput_t *minput );
 
 #ifdef __cplusplus
 };
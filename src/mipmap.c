@@ -0,0 +1,125 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "bufpool.h"
+#include "mipmap.h"
+
+/**
+ * Averages four packed RGBA pixels, one byte lane at a time, rounding
+ * to nearest.  The top six bits and bottom two bits of each lane are
+ * summed separately so no lane can carry into its neighbour.
+ */
+static inline uint32_t average4( uint32_t a, uint32_t b, uint32_t c, uint32_t d )
+{
+    uint32_t hi = ((a >> 2) & 0x3f3f3f3f) + ((b >> 2) & 0x3f3f3f3f) +
+                  ((c >> 2) & 0x3f3f3f3f) + ((d >> 2) & 0x3f3f3f3f);
+    uint32_t lo = (a & 0x03030303) + (b & 0x03030303) +
+                  (c & 0x03030303) + (d & 0x03030303) + 0x02020202;
+    return hi + ((lo >> 2) & 0x03030303);
+}
+
+static void halve_row_rgba( uint8_t *dst, const uint8_t *top,
+                            const uint8_t *bot, int width )
+{
+    for( int x = 0; x < width; x++ ) {
+        uint32_t p[ 4 ];
+        memcpy( &p[ 0 ], top, 8 );
+        memcpy( &p[ 2 ], bot, 8 );
+        uint32_t out = average4( p[ 0 ], p[ 1 ], p[ 2 ], p[ 3 ] );
+        memcpy( dst, &out, 4 );
+        top += 8;
+        bot += 8;
+        dst += 4;
+    }
+}
+
+static void halve_row_rgb( uint8_t *dst, const uint8_t *top,
+                           const uint8_t *bot, int width )
+{
+    for( int x = 0; x < width; x++ ) {
+        for( int c = 0; c < 3; c++ ) {
+            dst[ c ] = (top[ c ] + top[ c + 3 ] + bot[ c ] + bot[ c + 3 ] + 2) >> 2;
+        }
+        top += 6;
+        bot += 6;
+        dst += 3;
+    }
+}
+
+void mipmap_halve( uint8_t *dst, int dst_stride,
+                   const uint8_t *src, int src_stride,
+                   int width, int height, int bpp )
+{
+    for( int y = 0; y < height; y++ ) {
+        const uint8_t *top = src + ((size_t) (y * 2) * src_stride);
+        const uint8_t *bot = top + src_stride;
+        uint8_t *out = dst + ((size_t) y * dst_stride);
+
+        if( bpp == 4 ) {
+            halve_row_rgba( out, top, bot, width );
+        } else {
+            halve_row_rgb( out, top, bot, width );
+        }
+    }
+}
+
+void mipmap_fit( int width, int height, int max_width, int max_height,
+                 int *fit_width, int *fit_height )
+{
+    *fit_width = width;
+    *fit_height = height;
+
+    if( width <= max_width && height <= max_height ) return;
+
+    if( (long long) width * max_height > (long long) height * max_width ) {
+        *fit_width = max_width;
+        *fit_height = (int) (((long long) height * max_width) / width);
+    } else {
+        *fit_width = (int) (((long long) width * max_height) / height);
+        *fit_height = max_height;
+    }
+    if( *fit_width < 1 ) *fit_width = 1;
+    if( *fit_height < 1 ) *fit_height = 1;
+}
+
+int mipmap_reduce( uint8_t **pixels, int *width, int *height, int *stride,
+                   int bpp, int fit_width, int fit_height )
+{
+    while( (*width / 2) >= fit_width && (*height / 2) >= fit_height ) {
+        int w = *width / 2;
+        int h = *height / 2;
+        uint8_t *level = bufpool_alloc( (size_t) w * h * bpp );
+        if( !level ) return 0;
+
+        mipmap_halve( level, w * bpp, *pixels, *stride, w, h, bpp );
+        bufpool_free( *pixels );
+        *pixels = level;
+        *width = w;
+        *height = h;
+        *stride = w * bpp;
+    }
+    return 1;
+}
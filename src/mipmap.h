@@ -0,0 +1,66 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MIPMAP_H_INCLUDED
+#define MIPMAP_H_INCLUDED
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Reduces an image by half in each dimension with a 2x2 box filter.
+ * The source must be at least 2 * width by 2 * height pixels, where
+ * width and height are the size of the destination.  bpp is the number
+ * of bytes per pixel, 3 or 4.
+ */
+void mipmap_halve( uint8_t *dst, int dst_stride,
+                   const uint8_t *src, int src_stride,
+                   int width, int height, int bpp );
+
+/**
+ * Returns the size an image of width by height should be shown at to
+ * fit within max_width by max_height, keeping its aspect ratio.  Images
+ * that already fit are left alone.
+ */
+void mipmap_fit( int width, int height, int max_width, int max_height,
+                 int *fit_width, int *fit_height );
+
+/**
+ * Reduces the image in place, by repeated halving, to the smallest
+ * level that is still at least fit_width by fit_height.  On return,
+ * *pixels may point to a new buffer from bufpool_alloc(), in which case
+ * the old one, which must also have come from the pool, has been
+ * freed.  Returns 0 if out of memory, leaving the image at whichever
+ * level it had reached.
+ */
+int mipmap_reduce( uint8_t **pixels, int *width, int *height, int *stride,
+                   int bpp, int fit_width, int fit_height );
+
+#ifdef __cplusplus
+};
+#endif
+#endif /* MIPMAP_H_INCLUDED */
@@ -0,0 +1,452 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "mapping.h"
+#include "oscinput.h"
+
+/* Datagrams taken from the socket per call. */
+#define BATCH 32
+
+/* Largest datagram accepted, bigger ones are counted as errors. */
+#define PACKET_SIZE 4096
+
+/* Extra addresses that can be bound with oscinput_set_control(). */
+#define MAX_BINDINGS 64
+
+/* Deepest nesting of bundles followed. */
+#define MAX_DEPTH 4
+
+/* Socket buffer, enough to ride out a burst while the thread sleeps. */
+#define RECV_BUFFER (1024 * 1024)
+
+typedef struct osc_entry_s
+{
+    const char *address;
+    uint32_t hash;
+    int slot;
+} osc_entry_t;
+
+struct oscinput_s
+{
+    int fd;
+    int port;
+    controlbus_t *controlbus;
+    pthread_t thread_handle;
+
+    char *bind_addresses[ MAX_BINDINGS ];
+    int bind_slots[ MAX_BINDINGS ];
+    int num_bindings;
+
+    /**
+     * Open addressed table of every address, built once before the
+     * thread starts and only read after.
+     */
+    osc_entry_t *table;
+    uint32_t mask;
+    char *names;
+
+    /**
+     * Values set by the current batch, so a fader sending many
+     * messages in one batch only reaches the bus once.  A slot's value
+     * is only good if its stamp is the batch's.
+     */
+    int num_slots;
+    int *values;
+    unsigned int *stamps;
+    int *touched;
+    int num_touched;
+    unsigned int stamp;
+
+    struct mmsghdr msgs[ BATCH ];
+    struct iovec iovs[ BATCH ];
+    uint8_t buffers[ BATCH ][ PACKET_SIZE ];
+
+    unsigned int messages;
+    unsigned int errors;
+};
+
+oscinput_t *oscinput_new( int port, controlbus_t *controlbus )
+{
+    struct sockaddr_in addr;
+    int size = RECV_BUFFER;
+    int on = 1;
+
+    oscinput_t *oscinput = malloc( sizeof( oscinput_t ) );
+    if( !oscinput ) return 0;
+
+    oscinput->fd = socket( AF_INET, SOCK_DGRAM, 0 );
+    if( oscinput->fd < 0 ) {
+        fprintf( stderr, "oscinput: Cannot create socket: %s\n", strerror( errno ) );
+        free( oscinput );
+        return 0;
+    }
+    setsockopt( oscinput->fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof( on ) );
+    setsockopt( oscinput->fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof( size ) );
+
+    memset( &addr, 0, sizeof( addr ) );
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl( INADDR_ANY );
+    addr.sin_port = htons( port );
+    if( bind( oscinput->fd, (struct sockaddr *) &addr, sizeof( addr ) ) < 0 ) {
+        fprintf( stderr, "oscinput: Cannot listen on port %d: %s\n",
+                 port, strerror( errno ) );
+        close( oscinput->fd );
+        free( oscinput );
+        return 0;
+    }
+
+    oscinput->port = port;
+    oscinput->controlbus = controlbus;
+    oscinput->thread_handle = 0;
+    oscinput->num_bindings = 0;
+    oscinput->table = 0;
+    oscinput->mask = 0;
+    oscinput->names = 0;
+    oscinput->num_slots = 0;
+    oscinput->values = 0;
+    oscinput->stamps = 0;
+    oscinput->touched = 0;
+    oscinput->num_touched = 0;
+    oscinput->stamp = 0;
+    oscinput->messages = 0;
+    oscinput->errors = 0;
+
+    for( int i = 0; i < BATCH; i++ ) {
+        oscinput->iovs[ i ].iov_base = oscinput->buffers[ i ];
+        oscinput->iovs[ i ].iov_len = PACKET_SIZE;
+        memset( &oscinput->msgs[ i ], 0, sizeof( struct mmsghdr ) );
+        oscinput->msgs[ i ].msg_hdr.msg_iov = &oscinput->iovs[ i ];
+        oscinput->msgs[ i ].msg_hdr.msg_iovlen = 1;
+    }
+    return oscinput;
+}
+
+void oscinput_delete( oscinput_t *oscinput )
+{
+    if( oscinput->thread_handle ) {
+        pthread_cancel( oscinput->thread_handle );
+        pthread_join( oscinput->thread_handle, NULL );
+    }
+    close( oscinput->fd );
+    for( int i = 0; i < oscinput->num_bindings; i++ ) {
+        free( oscinput->bind_addresses[ i ] );
+    }
+    free( oscinput->table );
+    free( oscinput->names );
+    free( oscinput->values );
+    free( oscinput->stamps );
+    free( oscinput->touched );
+    free( oscinput );
+}
+
+void oscinput_set_control( oscinput_t *oscinput, const char *address, int slot )
+{
+    if( oscinput->num_bindings == MAX_BINDINGS ) {
+        fprintf( stderr, "oscinput: too many controls, %s ignored\n", address );
+        return;
+    }
+    char *copy = strdup( address );
+    if( !copy ) return;
+    oscinput->bind_addresses[ oscinput->num_bindings ] = copy;
+    oscinput->bind_slots[ oscinput->num_bindings ] = slot;
+    oscinput->num_bindings++;
+}
+
+/**
+ * FNV-1a over a NUL terminated address.
+ */
+static uint32_t osc_hash( const char *address )
+{
+    uint32_t hash = 2166136261u;
+    while( *address ) {
+        hash = (hash ^ (uint8_t) *address++) * 16777619u;
+    }
+    return hash;
+}
+
+static void osc_insert( oscinput_t *oscinput, const char *address, int slot )
+{
+    uint32_t hash = osc_hash( address );
+    uint32_t i = hash & oscinput->mask;
+
+    while( oscinput->table[ i ].address ) {
+        if( oscinput->table[ i ].hash == hash &&
+            !strcmp( oscinput->table[ i ].address, address ) ) {
+            break;
+        }
+        i = (i + 1) & oscinput->mask;
+    }
+    oscinput->table[ i ].address = address;
+    oscinput->table[ i ].hash = hash;
+    oscinput->table[ i ].slot = slot;
+}
+
+static int osc_lookup( oscinput_t *oscinput, const char *address )
+{
+    uint32_t hash = osc_hash( address );
+    uint32_t i = hash & oscinput->mask;
+
+    while( oscinput->table[ i ].address ) {
+        if( oscinput->table[ i ].hash == hash &&
+            !strcmp( oscinput->table[ i ].address, address ) ) {
+            return oscinput->table[ i ].slot;
+        }
+        i = (i + 1) & oscinput->mask;
+    }
+    return -1;
+}
+
+static int osc_build( oscinput_t *oscinput )
+{
+    controlbus_t *bus = oscinput->controlbus;
+    int count = controlbus_get_count( bus );
+    uint32_t size = 16;
+    size_t names_size = 0;
+    char *name;
+
+    /* Keep the table at most half full so probes stay short. */
+    while( size < (uint32_t) (count + oscinput->num_bindings) * 2 ) size *= 2;
+    for( int i = 0; i < count; i++ ) {
+        names_size += strlen( controlbus_get_name( bus, i ) ) + 2;
+    }
+
+    oscinput->table = calloc( size, sizeof( osc_entry_t ) );
+    oscinput->names = malloc( names_size + 1 );
+    oscinput->values = calloc( count + 1, sizeof( int ) );
+    oscinput->stamps = calloc( count + 1, sizeof( unsigned int ) );
+    oscinput->touched = calloc( count + 1, sizeof( int ) );
+    if( !oscinput->table || !oscinput->names || !oscinput->values ||
+        !oscinput->stamps || !oscinput->touched ) {
+        return 0;
+    }
+    oscinput->mask = size - 1;
+    oscinput->num_slots = count;
+
+    name = oscinput->names;
+    for( int i = 0; i < count; i++ ) {
+        const char *src = controlbus_get_name( bus, i );
+        char *address = name;
+        *name++ = '/';
+        while( *src ) {
+            *name++ = (*src == '.') ? '/' : *src;
+            src++;
+        }
+        *name++ = '\0';
+        osc_insert( oscinput, address, i );
+    }
+
+    /* Bindings go in last so they can take over a slot's own name. */
+    for( int i = 0; i < oscinput->num_bindings; i++ ) {
+        osc_insert( oscinput, oscinput->bind_addresses[ i ], oscinput->bind_slots[ i ] );
+    }
+    return 1;
+}
+
+static uint32_t osc_read32( const uint8_t *p )
+{
+    return ((uint32_t) p[ 0 ] << 24) | ((uint32_t) p[ 1 ] << 16) |
+           ((uint32_t) p[ 2 ] << 8) | p[ 3 ];
+}
+
+static uint64_t osc_read64( const uint8_t *p )
+{
+    return ((uint64_t) osc_read32( p ) << 32) | osc_read32( p + 4 );
+}
+
+/**
+ * Returns the length of the string at p including its padding to four
+ * bytes, or 0 if it is not terminated within len bytes.
+ */
+static size_t osc_string( const uint8_t *p, size_t len )
+{
+    const uint8_t *end = memchr( p, 0, len );
+    if( !end ) return 0;
+
+    size_t padded = ((end - p) + 4) & ~((size_t) 3);
+    return (padded <= len) ? padded : 0;
+}
+
+/**
+ * Takes the value for a slot, replacing any given earlier in the batch.
+ */
+static void osc_publish( oscinput_t *oscinput, int slot, int raw )
+{
+    if( oscinput->stamps[ slot ] != oscinput->stamp ) {
+        oscinput->stamps[ slot ] = oscinput->stamp;
+        oscinput->touched[ oscinput->num_touched++ ] = slot;
+    }
+    oscinput->values[ slot ] = raw;
+}
+
+static int osc_message( oscinput_t *oscinput, const uint8_t *p, size_t len )
+{
+    size_t address_len = osc_string( p, len );
+    if( !address_len || address_len == len ) return 0;
+
+    const uint8_t *tags = p + address_len;
+    size_t tags_len = osc_string( tags, len - address_len );
+    if( !tags_len || tags[ 0 ] != ',' ) return 0;
+
+    const uint8_t *args = tags + tags_len;
+    size_t args_len = len - address_len - tags_len;
+    int raw;
+
+    switch( tags[ 1 ] ) {
+    case 'f': {
+        if( args_len < 4 ) return 0;
+        union { uint32_t i; float f; } u = { osc_read32( args ) };
+        raw = mapping_from_unit( u.f );
+        break;
+    }
+    case 'd': {
+        if( args_len < 8 ) return 0;
+        union { uint64_t i; double d; } u = { osc_read64( args ) };
+        raw = mapping_from_unit( u.d );
+        break;
+    }
+    case 'i': {
+        if( args_len < 4 ) return 0;
+        int32_t value = (int32_t) osc_read32( args );
+        raw = (value < 0) ? 0 : (value > MAPPING_MAX) ? MAPPING_MAX : value;
+        break;
+    }
+    case 'T': raw = MAPPING_MAX; break;
+    case 'F': raw = 0; break;
+    default: return 0;
+    }
+
+    int slot = osc_lookup( oscinput, (const char *) p );
+    if( slot < 0 || slot >= oscinput->num_slots ) return 0;
+    osc_publish( oscinput, slot, raw );
+    return 1;
+}
+
+/**
+ * Parses a message or bundle in place, and returns the number of
+ * messages taken from it, or -1 if any part of it was bad.
+ */
+static int osc_packet( oscinput_t *oscinput, const uint8_t *p, size_t len, int depth )
+{
+    if( !len || (len & 3) ) return -1;
+
+    if( p[ 0 ] == '/' ) {
+        return osc_message( oscinput, p, len ) ? 1 : -1;
+    }
+    if( len < 16 || memcmp( p, "#bundle", 8 ) || depth >= MAX_DEPTH ) return -1;
+
+    /* Skip the time tag, everything is applied on arrival. */
+    size_t pos = 16;
+    int count = 0;
+    int bad = 0;
+    while( pos + 4 <= len ) {
+        size_t size = osc_read32( p + pos );
+        pos += 4;
+        if( size > len - pos ) return -1;
+
+        int taken = osc_packet( oscinput, p + pos, size, depth + 1 );
+        if( taken < 0 ) bad = 1;
+        else count += taken;
+        pos += size;
+    }
+    return (bad || pos != len) ? -1 : count;
+}
+
+static void oscinput_receive( oscinput_t *oscinput )
+{
+    for(;;) {
+        pthread_testcancel();
+        int count = recvmmsg( oscinput->fd, oscinput->msgs, BATCH, MSG_WAITFORONE, 0 );
+        if( count < 0 ) {
+            if( errno == EINTR ) continue;
+            fprintf( stderr, "oscinput: receive failed: %s\n", strerror( errno ) );
+            return;
+        }
+
+        unsigned int messages = 0;
+        unsigned int errors = 0;
+        if( !++oscinput->stamp ) oscinput->stamp = 1;
+        oscinput->num_touched = 0;
+
+        for( int i = 0; i < count; i++ ) {
+            struct mmsghdr *msg = &oscinput->msgs[ i ];
+            int taken = -1;
+            if( !(msg->msg_hdr.msg_flags & MSG_TRUNC) ) {
+                taken = osc_packet( oscinput, oscinput->buffers[ i ], msg->msg_len, 0 );
+            }
+            if( taken < 0 ) errors++;
+            else messages += taken;
+        }
+
+        for( int i = 0; i < oscinput->num_touched; i++ ) {
+            int slot = oscinput->touched[ i ];
+            controlbus_set( oscinput->controlbus, slot, oscinput->values[ slot ] );
+        }
+        __atomic_add_fetch( &oscinput->messages, messages, __ATOMIC_RELAXED );
+        __atomic_add_fetch( &oscinput->errors, errors, __ATOMIC_RELAXED );
+    }
+}
+
+static void *thread_thunk( void *osc )
+{
+    pthread_setcanceltype( PTHREAD_CANCEL_DEFERRED, 0 );
+    oscinput_receive( osc );
+    return NULL;
+}
+
+void oscinput_start( oscinput_t *oscinput )
+{
+    if( !osc_build( oscinput ) ) {
+        fprintf( stderr, "oscinput: Out of memory\n" );
+        return;
+    }
+    fprintf( stderr, "oscinput: Listening on port %d for %d addresses\n",
+             oscinput->port, oscinput->num_slots + oscinput->num_bindings );
+
+    if( pthread_create( &oscinput->thread_handle, NULL, thread_thunk, oscinput ) != 0 ) {
+        fprintf( stderr, "oscinput: failed to create receive thread\n" );
+        oscinput->thread_handle = 0;
+    }
+}
+
+unsigned int oscinput_get_messages( oscinput_t *oscinput )
+{
+    return __atomic_load_n( &oscinput->messages, __ATOMIC_RELAXED );
+}
+
+unsigned int oscinput_get_errors( oscinput_t *oscinput )
+{
+    return __atomic_load_n( &oscinput->errors, __ATOMIC_RELAXED );
+}
@@ -0,0 +1,92 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OSCINPUT_H_INCLUDED
+#define OSCINPUT_H_INCLUDED
+
+#include "controlbus.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Receives OSC messages over UDP and publishes them to the control bus.
+ * Every bus slot can be addressed by its name, with the dots turned
+ * into slashes, so "ch0.x_offset" is "/ch0/x_offset".  Other addresses
+ * can be bound to slots with oscinput_set_control(), the way MIDI
+ * controllers are bound with minput_set_control().
+ *
+ * A message sets its slot from its first argument: a float from 0 to 1,
+ * an int already in the bus range of 0 to MAPPING_MAX, or true or
+ * false for the ends of the range.  Bundles are taken apart and their
+ * messages applied straight away, whatever their time tag.  There is no
+ * authentication, so any host that can reach the port can move every
+ * slot.
+ *
+ * Example usage:
+ *
+ * oscinput_t *osc = oscinput_new( 9000, bus );
+ * oscinput_set_control( osc, "/1/fader1",
+ *                       channel_get_slot( ch0, CHANNEL_A_OFFSET ) );
+ * oscinput_start( osc );
+ */
+
+typedef struct oscinput_s oscinput_t;
+
+/**
+ * Opens a UDP socket on the given port on every interface.  Returns 0
+ * on error.
+ */
+oscinput_t *oscinput_new( int port, controlbus_t *controlbus );
+
+/**
+ * Stops the receive thread and closes the socket.
+ */
+void oscinput_delete( oscinput_t *oscinput );
+
+/**
+ * Binds an extra address to a slot.  Must be called before
+ * oscinput_start().
+ */
+void oscinput_set_control( oscinput_t *oscinput, const char *address,
+                           int slot );
+
+/**
+ * Builds the address table from the bus and starts the receive thread.
+ * Every slot must already have been added to the bus.
+ */
+void oscinput_start( oscinput_t *oscinput );
+
+/**
+ * Returns the number of messages applied, and the number of datagrams
+ * that could not be parsed or named no known address.
+ */
+unsigned int oscinput_get_messages( oscinput_t *oscinput );
+unsigned int oscinput_get_errors( oscinput_t *oscinput );
+
+#ifdef __cplusplus
+};
+#endif
+#endif /* OSCINPUT_H_INCLUDED */
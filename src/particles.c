@@ -0,0 +1,263 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "particles.h"
+
+typedef float v4sf __attribute__(( vector_size( 16 ) ));
+
+struct particles_s
+{
+    int capacity;
+
+    /* One past the highest live particle, so updates can stop there. */
+    int high;
+    int alive;
+
+    /* Per particle fields, padded to a multiple of four and aligned. */
+    float *x;
+    float *y;
+    float *vx;
+    float *vy;
+    float *life;
+    float *fade;
+    float *size;
+    uint8_t *live;
+
+    /* Free slots, popped from the top, lowest index first. */
+    int *free_list;
+    int free_top;
+
+    int *indices;
+    float *uvs;
+    uint32_t random;
+};
+
+static float *particles_array( int count )
+{
+    void *mem = 0;
+    if( posix_memalign( &mem, 16, count * sizeof( float ) ) ) return 0;
+    memset( mem, 0, count * sizeof( float ) );
+    return mem;
+}
+
+/**
+ * Returns a random number from 0 to 1, from a xorshift generator.
+ */
+static float particles_random( particles_t *particles )
+{
+    uint32_t r = particles->random;
+    r ^= r << 13;
+    r ^= r >> 17;
+    r ^= r << 5;
+    particles->random = r;
+    return (r >> 8) * (1.0f / 16777216.0f);
+}
+
+particles_t *particles_new( int capacity )
+{
+    particles_t *particles = malloc( sizeof( particles_t ) );
+    int padded = (capacity + 3) & ~3;
+
+    if( !particles ) return 0;
+
+    particles->capacity = capacity;
+    particles->high = 0;
+    particles->alive = 0;
+    particles->x = particles_array( padded );
+    particles->y = particles_array( padded );
+    particles->vx = particles_array( padded );
+    particles->vy = particles_array( padded );
+    particles->life = particles_array( padded );
+    particles->fade = particles_array( padded );
+    particles->size = particles_array( padded );
+    particles->live = calloc( padded, 1 );
+    particles->free_list = malloc( capacity * sizeof( int ) );
+    particles->indices = malloc( capacity * 6 * sizeof( int ) );
+    particles->uvs = malloc( capacity * 8 * sizeof( float ) );
+    particles->random = 0x9e3779b9u;
+
+    if( !particles->x || !particles->y || !particles->vx || !particles->vy ||
+        !particles->life || !particles->fade || !particles->size ||
+        !particles->live || !particles->free_list || !particles->indices ||
+        !particles->uvs ) {
+        fprintf( stderr, "particles: No memory for %d particles\n", capacity );
+        particles_delete( particles );
+        return 0;
+    }
+
+    for( int i = 0; i < capacity; i++ ) {
+        static const float uv[ 8 ] = { 0, 0, 1, 0, 0, 1, 1, 1 };
+        int *idx = particles->indices + (i * 6);
+
+        particles->free_list[ i ] = capacity - 1 - i;
+        idx[ 0 ] = (i * 4) + 0;
+        idx[ 1 ] = (i * 4) + 1;
+        idx[ 2 ] = (i * 4) + 2;
+        idx[ 3 ] = (i * 4) + 2;
+        idx[ 4 ] = (i * 4) + 1;
+        idx[ 5 ] = (i * 4) + 3;
+        memcpy( particles->uvs + (i * 8), uv, sizeof( uv ) );
+    }
+    particles->free_top = capacity;
+    return particles;
+}
+
+void particles_delete( particles_t *particles )
+{
+    free( particles->x );
+    free( particles->y );
+    free( particles->vx );
+    free( particles->vy );
+    free( particles->life );
+    free( particles->fade );
+    free( particles->size );
+    free( particles->live );
+    free( particles->free_list );
+    free( particles->indices );
+    free( particles->uvs );
+    free( particles );
+}
+
+int particles_get_capacity( particles_t *particles )
+{
+    return particles->capacity;
+}
+
+int particles_get_alive( particles_t *particles )
+{
+    return particles->alive;
+}
+
+int particles_spawn( particles_t *particles, int count,
+                     const particles_emitter_t *emitter )
+{
+    int spawned = 0;
+
+    while( spawned < count && particles->free_top > 0 ) {
+        int i = particles->free_list[ --particles->free_top ];
+        float angle = emitter->angle +
+            ((particles_random( particles ) - 0.5f) * emitter->spread);
+        float speed = emitter->speed +
+            (particles_random( particles ) * emitter->jitter);
+
+        particles->x[ i ] = emitter->x;
+        particles->y[ i ] = emitter->y;
+        particles->vx[ i ] = sinf( angle ) * speed;
+        particles->vy[ i ] = -cosf( angle ) * speed;
+        particles->life[ i ] = emitter->life;
+        particles->fade[ i ] = 1.0f / emitter->life;
+        particles->size[ i ] = emitter->size;
+        particles->live[ i ] = 1;
+        if( i >= particles->high ) particles->high = i + 1;
+        spawned++;
+    }
+    particles->alive += spawned;
+    return spawned;
+}
+
+void particles_update( particles_t *particles, float dt, float gravity,
+                       float drag )
+{
+    float keep = powf( drag, dt );
+    float fall = gravity * dt;
+
+    /**
+     * Dead particles between live ones are moved along too.  That costs
+     * less than testing each lane, and they are never drawn.
+     */
+    for( int i = 0; i < particles->high; i += 4 ) {
+        v4sf *x = (v4sf *) (particles->x + i);
+        v4sf *y = (v4sf *) (particles->y + i);
+        v4sf *vx = (v4sf *) (particles->vx + i);
+        v4sf *vy = (v4sf *) (particles->vy + i);
+        v4sf *life = (v4sf *) (particles->life + i);
+
+        *vx = *vx * keep;
+        *vy = (*vy * keep) + fall;
+        *x += *vx * dt;
+        *y += *vy * dt;
+        *life -= dt;
+    }
+}
+
+int particles_build( particles_t *particles, float *xy, uint8_t *rgba,
+                     const uint8_t *tint )
+{
+    int quads = 0;
+
+    for( int i = 0; i < particles->high; i++ ) {
+        if( !particles->live[ i ] ) continue;
+
+        if( particles->life[ i ] <= 0.0f ) {
+            particles->live[ i ] = 0;
+            particles->free_list[ particles->free_top++ ] = i;
+            particles->alive--;
+            continue;
+        }
+
+        float h = particles->size[ i ] * 0.5f;
+        float x0 = particles->x[ i ] - h;
+        float y0 = particles->y[ i ] - h;
+        float x1 = particles->x[ i ] + h;
+        float y1 = particles->y[ i ] + h;
+        float fade = particles->life[ i ] * particles->fade[ i ];
+        uint8_t a = (uint8_t) (tint[ 3 ] * (fade < 1.0f ? fade : 1.0f));
+        float *v = xy + (quads * 8);
+        uint8_t *c = rgba + (quads * 16);
+
+        v[ 0 ] = x0; v[ 1 ] = y0;
+        v[ 2 ] = x1; v[ 3 ] = y0;
+        v[ 4 ] = x0; v[ 5 ] = y1;
+        v[ 6 ] = x1; v[ 7 ] = y1;
+        for( int k = 0; k < 4; k++ ) {
+            c[ (k * 4) + 0 ] = tint[ 0 ];
+            c[ (k * 4) + 1 ] = tint[ 1 ];
+            c[ (k * 4) + 2 ] = tint[ 2 ];
+            c[ (k * 4) + 3 ] = a;
+        }
+        quads++;
+    }
+
+    /* Let the update loop stop short of the dead at the end. */
+    while( particles->high > 0 && !particles->live[ particles->high - 1 ] ) {
+        particles->high--;
+    }
+    return quads;
+}
+
+const int *particles_get_indices( particles_t *particles )
+{
+    return particles->indices;
+}
+
+const float *particles_get_uvs( particles_t *particles )
+{
+    return particles->uvs;
+}
@@ -0,0 +1,125 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef PARTICLES_H_INCLUDED
+#define PARTICLES_H_INCLUDED
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A fixed pool of particles, stored as one array per field so the
+ * integrator can move four at a time with GCC vector extensions.  Dead
+ * particles go on a free list and are reused by later spawns, so
+ * nothing is allocated after particles_new().
+ *
+ * particles_build() writes a textured quad for each live particle, laid
+ * out for SDL_RenderGeometryRaw(): four xy pairs and four RGBA colours
+ * per particle.  particles_get_indices() and particles_get_uvs() give the
+ * matching index and texture coordinate arrays, which never change.
+ *
+ * Example usage:
+ *
+ * particles_t *p = particles_new( 50000 );
+ *
+ * particles_spawn( p, 100, &emitter );
+ * particles_update( p, dt, 400.0f, 0.5f );
+ * int n = particles_build( p, xy, rgba, tint );
+ * SDL_RenderGeometryRaw( renderer, dot, xy, 8, rgba, 4,
+ *                        particles_get_uvs( p ), 8, n * 4,
+ *                        particles_get_indices( p ), n * 6, 4 );
+ */
+
+typedef struct particles_s particles_t;
+
+typedef struct particles_emitter_s
+{
+    /* Where particles start, in pixels. */
+    float x;
+    float y;
+
+    /* Direction in radians, clockwise from straight up, and the width of
+     * the fan around it. */
+    float angle;
+    float spread;
+
+    /* Speed in pixels per second, plus up to jitter more at random. */
+    float speed;
+    float jitter;
+
+    /* Lifetime in seconds, and size in pixels. */
+    float life;
+    float size;
+} particles_emitter_t;
+
+/**
+ * Creates a pool of up to capacity particles.  Returns 0 on error.
+ */
+particles_t *particles_new( int capacity );
+
+/**
+ * Frees the pool.
+ */
+void particles_delete( particles_t *particles );
+
+int particles_get_capacity( particles_t *particles );
+int particles_get_alive( particles_t *particles );
+
+/**
+ * Spawns up to count particles from the emitter, as many as the pool
+ * has room for.  Returns the number spawned.
+ */
+int particles_spawn( particles_t *particles, int count,
+                     const particles_emitter_t *emitter );
+
+/**
+ * Moves every particle on by dt seconds, under gravity in pixels per
+ * second squared, keeping drag of their velocity each second.
+ */
+void particles_update( particles_t *particles, float dt, float gravity,
+                       float drag );
+
+/**
+ * Writes a quad for every live particle, fading out over its life and
+ * coloured by tint, which is RGBA.  Particles that have died go back on
+ * the free list.  xy needs room for 8 floats and rgba for 16 bytes per
+ * particle in the pool.  Returns the number of quads written.
+ */
+int particles_build( particles_t *particles, float *xy, uint8_t *rgba,
+                     const uint8_t *tint );
+
+/**
+ * Returns the index and texture coordinate arrays for a full pool of
+ * quads.  Indices are 32 bit.
+ */
+const int *particles_get_indices( particles_t *particles );
+const float *particles_get_uvs( particles_t *particles );
+
+#ifdef __cplusplus
+};
+#endif
+#endif /* PARTICLES_H_INCLUDED */
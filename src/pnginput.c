@@ -22,28 +22,109 @@
  * SOFTWARE.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 #include <png.h>
+#include "bufpool.h"
 #include "pnginput.h"
 
+/**
+ * The file is read whole into a pooled buffer and decoded from there,
+ * and libpng takes its own memory, every row included, from the pool
+ * too, so reloading an image does not go to the heap at all once the
+ * pool has buffers of the right sizes.
+ */
 struct pnginput_s
 {
-    FILE *f;
+    uint8_t *data;
+    size_t size;
+    size_t pos;
     png_structp png_ptr;
     png_infop info_ptr;
     int has_alpha;
-    int channels;
-    uint8_t *inscanline;
 };
 
+static png_voidp pnginput_malloc( png_structp png_ptr, png_alloc_size_t size )
+{
+    return bufpool_alloc( size );
+}
+
+static void pnginput_free( png_structp png_ptr, png_voidp ptr )
+{
+    bufpool_free( ptr );
+}
+
+static void pnginput_read( png_structp png_ptr, png_bytep out, png_size_t len )
+{
+    pnginput_t *pnginput = png_get_io_ptr( png_ptr );
+
+    if( len > pnginput->size - pnginput->pos ) {
+        png_error( png_ptr, "file is truncated" );
+    }
+    memcpy( out, pnginput->data + pnginput->pos, len );
+    pnginput->pos += len;
+}
+
+/**
+ * Reads the whole file into a pooled buffer.  Returns 0 on error.
+ */
+static int pnginput_load( pnginput_t *pnginput, const char *filename )
+{
+    struct stat st;
+    size_t done = 0;
+    int fd;
+
+    fd = open( filename, O_RDONLY );
+    if( fd < 0 ) {
+        fprintf( stderr, "pnginput: Cannot open %s: %s\n",
+                 filename, strerror( errno ) );
+        return 0;
+    }
+    if( fstat( fd, &st ) < 0 ) {
+        fprintf( stderr, "pnginput: Cannot read %s: %s\n",
+                 filename, strerror( errno ) );
+        close( fd );
+        return 0;
+    }
+
+    pnginput->size = st.st_size;
+    pnginput->data = bufpool_alloc( pnginput->size );
+    if( !pnginput->data ) {
+        fprintf( stderr, "pnginput: No memory for %s.\n", filename );
+        close( fd );
+        return 0;
+    }
+
+    /* A file being saved may shrink under us, which libpng then reports. */
+    while( done < pnginput->size ) {
+        ssize_t len = read( fd, pnginput->data + done, pnginput->size - done );
+        if( len < 0 && errno == EINTR ) continue;
+        if( len < 0 ) {
+            fprintf( stderr, "pnginput: Cannot read %s: %s\n",
+                     filename, strerror( errno ) );
+            close( fd );
+            return 0;
+        }
+        if( !len ) break;
+        done += len;
+    }
+    pnginput->size = done;
+    close( fd );
+    return 1;
+}
+
 pnginput_t *pnginput_new( const char *filename )
 {
-    pnginput_t *pnginput = malloc( sizeof( pnginput_t ) );
-    png_uint_32 width;
-    //, height;
+    pnginput_t *pnginput = bufpool_alloc( sizeof( pnginput_t ) );
+    // png_uint_32 width, height;
     int colour_type, channels;
     // int bit_depth;
     // int rowbytes;
@@ -53,16 +134,18 @@ pnginput_t *pnginput_new( const char *filename )
 
     pnginput->png_ptr = 0;
     pnginput->info_ptr = 0;
+    pnginput->data = 0;
+    pnginput->size = 0;
+    pnginput->pos = 0;
 
-    pnginput->f = fopen( filename, "rb" );
-    if( !pnginput->f ) {
-        fprintf( stderr, "pnginput: Cannot open %s: %s\n",
-                 filename, strerror( errno ) );
+    if( !pnginput_load( pnginput, filename ) ) {
         pnginput_delete( pnginput );
         return 0;
     }
 
-    pnginput->png_ptr = png_create_read_struct( PNG_LIBPNG_VER_STRING, 0, 0, 0 );
+    pnginput->png_ptr = png_create_read_struct_2( PNG_LIBPNG_VER_STRING, 0, 0, 0,
+                                                  0, pnginput_malloc,
+                                                  pnginput_free );
     if( !pnginput->png_ptr ) {
         fprintf( stderr, "pnginput: Cannot open PNG write struct.\n" );
         pnginput_delete( pnginput );
@@ -78,15 +161,37 @@ pnginput_t *pnginput_new( const char *filename )
         return 0;
     }
 
-    png_init_io( pnginput->png_ptr, pnginput->f );
+    /**
+     * libpng reports corrupt or truncated files by longjmp'ing back
+     * here, which happens whenever we catch a file half way through
+     * being saved.
+     */
+    if( setjmp( png_jmpbuf( pnginput->png_ptr ) ) ) {
+        fprintf( stderr, "pnginput: Cannot decode %s.\n", filename );
+        pnginput_delete( pnginput );
+        return 0;
+    }
+
+    png_set_read_fn( pnginput->png_ptr, pnginput, pnginput_read );
 
     /* So paletted pngs work... Need to detect about alpha still though.. */
     png_set_expand( pnginput->png_ptr );
 
+    /**
+     * Gray has no layout SDL can take once expanding tRNS or an alpha
+     * channel gives it a second channel, so it is always widened to RGB
+     * or RGBA, whatever the colour type turns out to be.
+     */
+    png_set_gray_to_rgb( pnginput->png_ptr );
+
     png_read_png( pnginput->png_ptr, pnginput->info_ptr,
-                  PNG_TRANSFORM_IDENTITY, 0 );
+                  PNG_TRANSFORM_STRIP_16 | PNG_TRANSFORM_PACKING, 0 );
+
+    /* Every row has been decoded, so the file is done with. */
+    bufpool_free( pnginput->data );
+    pnginput->data = 0;
 
-    width = png_get_image_width( pnginput->png_ptr, pnginput->info_ptr );
+    // width = png_get_image_width( pnginput->png_ptr, pnginput->info_ptr );
     // height = png_get_image_height( pnginput->png_ptr, pnginput->info_ptr );
     // bit_depth = png_get_bit_depth( pnginput->png_ptr, pnginput->info_ptr );
     colour_type = png_get_color_type( pnginput->png_ptr, pnginput->info_ptr );
@@ -102,9 +207,11 @@ pnginput_t *pnginput_new( const char *filename )
         pnginput->has_alpha = 0;
     }
 
-    pnginput->channels = channels;
-    if( channels == 1 ) {
-        pnginput->inscanline = malloc( width * 3 );
+    if( channels != 3 && channels != 4 ) {
+        fprintf( stderr, "pnginput: Unsupported format in %s (%d channels).\n",
+                 filename, channels );
+        pnginput_delete( pnginput );
+        return 0;
     }
 
     return pnginput;
@@ -115,29 +222,13 @@ void pnginput_delete( pnginput_t *pnginput )
     if( pnginput->png_ptr && pnginput->info_ptr ) {
         png_destroy_read_struct( &(pnginput->png_ptr), &(pnginput->info_ptr), 0 );
     }
-    if( pnginput->f ) {
-        fclose( pnginput->f );
-    }
-    free( pnginput );
+    bufpool_free( pnginput->data );
+    bufpool_free( pnginput );
 }
 
 uint8_t *pnginput_get_scanline( pnginput_t *pnginput, int num )
 {
-    uint8_t *in = png_get_rows( pnginput->png_ptr, pnginput->info_ptr )[ num ];
-    if( pnginput->channels == 1 ) {
-        int w = pnginput_get_width( pnginput );
-        uint8_t *cur = pnginput->inscanline;
-
-        while( w-- ) {
-            *cur++ = *in;
-            *cur++ = *in;
-            *cur++ = *in;
-            in++;
-        }
-        return pnginput->inscanline;
-    } else {
-        return in;
-    }
+    return png_get_rows( pnginput->png_ptr, pnginput->info_ptr )[ num ];
 }
 
 unsigned int pnginput_get_width( pnginput_t *pnginput )
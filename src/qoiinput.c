@@ -0,0 +1,194 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bufpool.h"
+#include "qoiinput.h"
+
+#define QOI_MAGIC "qoif"
+#define QOI_HEADER_SIZE 14
+#define QOI_PADDING 8
+
+/* The largest image the format allows. */
+#define QOI_PIXELS_MAX 400000000
+
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF  0x40
+#define QOI_OP_LUMA  0x80
+#define QOI_OP_RUN   0xc0
+#define QOI_OP_RGB   0xfe
+#define QOI_OP_RGBA  0xff
+#define QOI_MASK_2   0xc0
+
+struct qoiinput_s
+{
+    uint8_t *pixels;
+    unsigned int width;
+    unsigned int height;
+    int channels;
+};
+
+static unsigned int read_be32( const uint8_t *p )
+{
+    return ((unsigned int) p[ 0 ] << 24) | ((unsigned int) p[ 1 ] << 16) |
+           ((unsigned int) p[ 2 ] << 8) | p[ 3 ];
+}
+
+/**
+ * Runs the decoder over the chunk stream.  The stream is followed by
+ * eight bytes of padding, and no op is longer than five bytes, so as
+ * long as each op starts before the padding it can be read without
+ * checking every byte.  Returns 0 if the stream runs out early.
+ */
+static int qoiinput_decode( qoiinput_t *qoiinput, const uint8_t *p,
+                            const uint8_t *end )
+{
+    uint8_t index[ 64 ][ 4 ];
+    uint8_t px[ 4 ] = { 0, 0, 0, 255 };
+    size_t count = (size_t) qoiinput->width * qoiinput->height;
+    int channels = qoiinput->channels;
+    uint8_t *out = qoiinput->pixels;
+    int run = 0;
+
+    memset( index, 0, sizeof( index ) );
+
+    for( size_t i = 0; i < count; i++ ) {
+        if( run > 0 ) {
+            run--;
+        } else {
+            if( p >= end ) return 0;
+
+            int b1 = *p++;
+            if( b1 == QOI_OP_RGB ) {
+                px[ 0 ] = p[ 0 ];
+                px[ 1 ] = p[ 1 ];
+                px[ 2 ] = p[ 2 ];
+                p += 3;
+            } else if( b1 == QOI_OP_RGBA ) {
+                memcpy( px, p, 4 );
+                p += 4;
+            } else if( (b1 & QOI_MASK_2) == QOI_OP_INDEX ) {
+                memcpy( px, index[ b1 ], 4 );
+            } else if( (b1 & QOI_MASK_2) == QOI_OP_DIFF ) {
+                px[ 0 ] += ((b1 >> 4) & 0x03) - 2;
+                px[ 1 ] += ((b1 >> 2) & 0x03) - 2;
+                px[ 2 ] += (b1 & 0x03) - 2;
+            } else if( (b1 & QOI_MASK_2) == QOI_OP_LUMA ) {
+                int b2 = *p++;
+                int vg = (b1 & 0x3f) - 32;
+                px[ 0 ] += vg - 8 + ((b2 >> 4) & 0x0f);
+                px[ 1 ] += vg;
+                px[ 2 ] += vg - 8 + (b2 & 0x0f);
+            } else {
+                run = b1 & 0x3f;
+            }
+
+            int hash = ((px[ 0 ] * 3) + (px[ 1 ] * 5) +
+                        (px[ 2 ] * 7) + (px[ 3 ] * 11)) % 64;
+            memcpy( index[ hash ], px, 4 );
+        }
+
+        out[ 0 ] = px[ 0 ];
+        out[ 1 ] = px[ 1 ];
+        out[ 2 ] = px[ 2 ];
+        if( channels == 4 ) out[ 3 ] = px[ 3 ];
+        out += channels;
+    }
+    return 1;
+}
+
+qoiinput_t *qoiinput_new( const char *filename, const uint8_t *data,
+                          size_t size )
+{
+    qoiinput_t *qoiinput;
+    unsigned int width, height;
+    int channels;
+
+    if( size < QOI_HEADER_SIZE + QOI_PADDING ||
+        memcmp( data, QOI_MAGIC, strlen( QOI_MAGIC ) ) ) {
+        fprintf( stderr, "qoiinput: %s is not a QOI file.\n", filename );
+        return 0;
+    }
+
+    width = read_be32( data + 4 );
+    height = read_be32( data + 8 );
+    channels = data[ 12 ];
+    if( !width || !height || height >= QOI_PIXELS_MAX / width ||
+        (channels != 3 && channels != 4) ) {
+        fprintf( stderr, "qoiinput: Unsupported format in %s "
+                 "(w %u, h %u, %d channels).\n", filename, width, height,
+                 channels );
+        return 0;
+    }
+
+    qoiinput = bufpool_alloc( sizeof( qoiinput_t ) );
+    if( !qoiinput ) return 0;
+
+    qoiinput->width = width;
+    qoiinput->height = height;
+    qoiinput->channels = channels;
+    qoiinput->pixels = bufpool_alloc( (size_t) width * height * channels );
+    if( !qoiinput->pixels ) {
+        fprintf( stderr, "qoiinput: No memory for %s.\n", filename );
+        bufpool_free( qoiinput );
+        return 0;
+    }
+
+    if( !qoiinput_decode( qoiinput, data + QOI_HEADER_SIZE,
+                          data + size - QOI_PADDING ) ) {
+        fprintf( stderr, "qoiinput: Cannot decode %s.\n", filename );
+        qoiinput_delete( qoiinput );
+        return 0;
+    }
+    return qoiinput;
+}
+
+void qoiinput_delete( qoiinput_t *qoiinput )
+{
+    bufpool_free( qoiinput->pixels );
+    bufpool_free( qoiinput );
+}
+
+unsigned int qoiinput_get_width( qoiinput_t *qoiinput )
+{
+    return qoiinput->width;
+}
+
+unsigned int qoiinput_get_height( qoiinput_t *qoiinput )
+{
+    return qoiinput->height;
+}
+
+uint8_t *qoiinput_get_scanline( qoiinput_t *qoiinput, int num )
+{
+    return qoiinput->pixels +
+        ((size_t) num * qoiinput->width * qoiinput->channels);
+}
+
+int qoiinput_has_alpha( qoiinput_t *qoiinput )
+{
+    return qoiinput->channels == 4;
+}
@@ -0,0 +1,73 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef QOIINPUT_H_INCLUDED
+#define QOIINPUT_H_INCLUDED
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Decodes QOI, the "Quite OK Image" format.  QOI compresses almost as
+ * well as PNG for typical art, but decodes in a single pass with no
+ * inflate, which makes it several times quicker to reload.  The whole
+ * image is decoded up front from the file's contents, which the caller
+ * provides.  Scanlines are RGB, or RGBA if the image has alpha.
+ */
+
+typedef struct qoiinput_s qoiinput_t;
+
+/**
+ * Decodes size bytes of QOI data read from filename.  Returns 0 on
+ * error, including when the data ends before the image does.
+ */
+qoiinput_t *qoiinput_new( const char *filename, const uint8_t *data,
+                          size_t size );
+
+/**
+ * Frees the decoded image.
+ */
+void qoiinput_delete( qoiinput_t *qoiinput );
+
+unsigned int qoiinput_get_width( qoiinput_t *qoiinput );
+unsigned int qoiinput_get_height( qoiinput_t *qoiinput );
+
+/**
+ * Returns a pointer to the given scanline from 0 to height-1.
+ */
+uint8_t *qoiinput_get_scanline( qoiinput_t *qoiinput, int num );
+
+/**
+ * Returns true if this image has an alpha channel.
+ */
+int qoiinput_has_alpha( qoiinput_t *qoiinput );
+
+#ifdef __cplusplus
+};
+#endif
+#endif /* QOIINPUT_H_INCLUDED */
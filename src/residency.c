@@ -0,0 +1,248 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "residency.h"
+
+#define MAX_CHANNELS 64
+
+/* Frames a channel must be out of view before it may be evicted. */
+#define MIN_IDLE_FRAMES 100
+
+/* Frames to wait before trying again to restore an image that failed. */
+#define RETRY_FRAMES 60
+
+enum
+{
+    RESTORE_NONE,
+    RESTORE_QUEUED,
+    RESTORE_DECODING
+};
+
+typedef struct resident_s
+{
+    channel_t *channel;
+    unsigned int last_used;
+    unsigned int retry_frame;
+    int restoring;
+} resident_t;
+
+struct residency_s
+{
+    workpool_t *workpool;
+    controlbus_t *controlbus;
+    channel_t *decoding[ MAX_CHANNELS ];
+    int num_decoding;
+    int unfinished;
+    unsigned int ticket;
+
+    size_t budget;
+    size_t bytes;
+    unsigned int frame;
+    unsigned int evictions;
+    unsigned int restores;
+    int num_channels;
+    resident_t channels[ MAX_CHANNELS ];
+};
+
+residency_t *residency_new( size_t budget, workpool_t *workpool,
+                            controlbus_t *controlbus )
+{
+    residency_t *residency = malloc( sizeof( residency_t ) );
+    if( !residency ) return 0;
+
+    residency->workpool = workpool;
+    residency->controlbus = controlbus;
+    residency->num_decoding = 0;
+    residency->unfinished = 0;
+    residency->ticket = 0;
+    residency->budget = budget;
+    residency->bytes = 0;
+    residency->frame = 0;
+    residency->evictions = 0;
+    residency->restores = 0;
+    residency->num_channels = 0;
+    return residency;
+}
+
+void residency_delete( residency_t *residency )
+{
+    if( residency->num_decoding ) {
+        workpool_wait( residency->workpool, residency->ticket );
+    }
+    free( residency );
+}
+
+void residency_add( residency_t *residency, channel_t *channel )
+{
+    if( residency->num_channels == MAX_CHANNELS ) {
+        fprintf( stderr, "residency: too many channels\n" );
+        return;
+    }
+    residency->channels[ residency->num_channels ].channel = channel;
+    residency->channels[ residency->num_channels ].last_used = 0;
+    residency->channels[ residency->num_channels ].retry_frame = 0;
+    residency->channels[ residency->num_channels ].restoring = RESTORE_NONE;
+    residency->num_channels++;
+}
+
+static resident_t *residency_find_victim( residency_t *residency )
+{
+    resident_t *victim = NULL;
+
+    for( int i = 0; i < residency->num_channels; i++ ) {
+        resident_t *r = &residency->channels[ i ];
+        if( !channel_is_resident( r->channel ) ) continue;
+        if( channel_is_pinned( r->channel ) ) continue;
+        if( residency->frame - r->last_used < MIN_IDLE_FRAMES ) continue;
+        if( !victim || r->last_used < victim->last_used ) {
+            victim = r;
+        }
+    }
+    return victim;
+}
+
+static void residency_decode_one( void *arg, int index )
+{
+    residency_t *residency = arg;
+    channel_restore_decode( residency->decoding[ index ] );
+
+    /* The render loop may be asleep with nothing else to wake it. */
+    if( !__atomic_sub_fetch( &residency->unfinished, 1, __ATOMIC_ACQ_REL ) &&
+        residency->controlbus ) {
+        controlbus_wake( residency->controlbus );
+    }
+}
+
+static int residency_restore( residency_t *residency, resident_t *r )
+{
+    if( channel_restore( r->channel ) ) {
+        residency->restores++;
+        fprintf( stderr, "residency: restored %s\n",
+                 channel_get_filename( r->channel ) );
+        return 1;
+    }
+    r->retry_frame = residency->frame + RETRY_FRAMES;
+    return 0;
+}
+
+int residency_update( residency_t *residency )
+{
+    size_t bytes = 0;
+    int restored = 0;
+
+    residency->frame++;
+
+    /* Upload the images the workers have finished decoding. */
+    if( residency->num_decoding &&
+        !__atomic_load_n( &residency->unfinished, __ATOMIC_ACQUIRE ) ) {
+        for( int i = 0; i < residency->num_channels; i++ ) {
+            resident_t *r = &residency->channels[ i ];
+            if( r->restoring == RESTORE_DECODING ) {
+                r->restoring = RESTORE_NONE;
+                restored += residency_restore( residency, r );
+            }
+        }
+        residency->num_decoding = 0;
+    }
+
+    for( int i = 0; i < residency->num_channels; i++ ) {
+        resident_t *r = &residency->channels[ i ];
+        if( channel_wants_texture( r->channel ) ) {
+            r->last_used = residency->frame;
+            if( !channel_is_resident( r->channel ) &&
+                r->restoring == RESTORE_NONE &&
+                residency->frame >= r->retry_frame ) {
+                if( channel_restore_begin( r->channel ) ) {
+                    r->restoring = RESTORE_QUEUED;
+                } else {
+                    restored += residency_restore( residency, r );
+                }
+            }
+        }
+        bytes += channel_get_texture_bytes( r->channel );
+    }
+
+    /* Hand the images waiting to be decoded to the workers. */
+    if( !residency->num_decoding ) {
+        for( int i = 0; i < residency->num_channels; i++ ) {
+            resident_t *r = &residency->channels[ i ];
+            if( r->restoring == RESTORE_QUEUED ) {
+                r->restoring = RESTORE_DECODING;
+                residency->decoding[ residency->num_decoding++ ] = r->channel;
+            }
+        }
+        if( residency->num_decoding ) {
+            residency->unfinished = residency->num_decoding;
+            residency->ticket = workpool_start( residency->workpool,
+                                                residency_decode_one, residency,
+                                                residency->num_decoding );
+        }
+    }
+
+    while( bytes > residency->budget ) {
+        resident_t *victim = residency_find_victim( residency );
+        if( !victim ) break;
+
+        /* Only the image on show is given up, the others stay. */
+        bytes -= channel_get_texture_bytes( victim->channel );
+        channel_evict( victim->channel );
+        bytes += channel_get_texture_bytes( victim->channel );
+        residency->evictions++;
+        fprintf( stderr, "residency: evicted %s, %.1fMB of %.1fMB resident\n",
+                 channel_get_filename( victim->channel ),
+                 bytes / (1024.0 * 1024.0),
+                 residency->budget / (1024.0 * 1024.0) );
+    }
+
+    residency->bytes = bytes;
+    return restored;
+}
+
+int residency_is_restoring( residency_t *residency )
+{
+    /* Channels are only left queued while another batch is decoding. */
+    return residency->num_decoding != 0;
+}
+
+size_t residency_get_budget( residency_t *residency )
+{
+    return residency->budget;
+}
+
+size_t residency_get_bytes( residency_t *residency )
+{
+    return residency->bytes;
+}
+
+unsigned int residency_get_evictions( residency_t *residency )
+{
+    return residency->evictions;
+}
+
+unsigned int residency_get_restores( residency_t *residency )
+{
+    return residency->restores;
+}
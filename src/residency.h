@@ -0,0 +1,84 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef RESIDENCY_H_INCLUDED
+#define RESIDENCY_H_INCLUDED
+
+#include <stddef.h>
+#include "channel.h"
+#include "controlbus.h"
+#include "workpool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Keeps the textures of registered channels within a byte budget.
+ *
+ * Call residency_update() once per frame, after channel_prepare() and
+ * before channel_render().  Channels that are on or near the screen get
+ * their textures restored, and while the budget is exceeded, channels
+ * that have been out of view for a while are evicted, least recently
+ * seen first.  Pinned channels are never evicted.
+ *
+ * Still images are decoded on the workpool and uploaded on a later
+ * update, so a channel coming back into view never stalls a frame on
+ * the disk.  The workpool runs one batch at a time, so give residency
+ * one of its own rather than the one generators draw on.  The last
+ * image of a batch to finish wakes the control bus, so the render loop
+ * can sleep in controlbus_wait() while residency_is_restoring().
+ */
+
+typedef struct residency_s residency_t;
+
+residency_t *residency_new( size_t budget, workpool_t *workpool,
+                            controlbus_t *controlbus );
+void residency_delete( residency_t *residency );
+void residency_add( residency_t *residency, channel_t *channel );
+
+/**
+ * Returns the number of channels whose textures were restored, which
+ * must be drawn even if nothing else changed.
+ */
+int residency_update( residency_t *residency );
+
+/**
+ * Returns true while images are waiting to be decoded or uploaded, when
+ * residency_update() must keep being called.
+ */
+int residency_is_restoring( residency_t *residency );
+
+/**
+ * Statistics for monitoring.
+ */
+size_t residency_get_budget( residency_t *residency );
+size_t residency_get_bytes( residency_t *residency );
+unsigned int residency_get_evictions( residency_t *residency );
+unsigned int residency_get_restores( residency_t *residency );
+
+#ifdef __cplusplus
+};
+#endif
+#endif /* RESIDENCY_H_INCLUDED */
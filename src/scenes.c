@@ -0,0 +1,354 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "scenes.h"
+
+/* Fade time given to a scene when it is first stored. */
+#define DEFAULT_FADE_MS 1000
+
+/* Channel parameters that jump instead of fading. */
+static const int stepped_params[] =
+{
+    CHANNEL_FLIP, CHANNEL_BLEND, CHANNEL_IMAGE
+};
+
+typedef struct scene_s
+{
+    int stored;
+    char name[ 32 ];
+    int fade_ms;
+
+    /* The raw value of each slot, or -1 to leave it alone. */
+    int *raw;
+
+    /* Whether each channel was on or near the screen. */
+    int *needs;
+} scene_t;
+
+struct scenes_s
+{
+    const char *filename;
+    controlbus_t *controlbus;
+    channel_t **channels;
+    int num_channels;
+    int num_slots;
+    int *stepped;
+    scene_t scenes[ SCENES_MAX ];
+
+    /* The scene asked for by scenes_trigger(), plus one, or 0. */
+    int pending;
+
+    /* The scene being applied, or -1, and where its slots started. */
+    int current;
+    int *from;
+    uint64_t start_ns;
+};
+
+static uint64_t scenes_now( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ((uint64_t) ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+static int scenes_find_channel( scenes_t *scenes, const char *name )
+{
+    for( int i = 0; i < scenes->num_channels; i++ ) {
+        if( !strcmp( channel_get_name( scenes->channels[ i ] ), name ) ) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Clears a scene, so every slot is left alone and no channel is needed.
+ */
+static void scenes_clear( scenes_t *scenes, scene_t *scene )
+{
+    for( int i = 0; i < scenes->num_slots; i++ ) {
+        scene->raw[ i ] = -1;
+    }
+    memset( scene->needs, 0, scenes->num_channels * sizeof( int ) );
+    scene->stored = 0;
+}
+
+/**
+ * Pins every channel that some scene needs, and unpins the rest.
+ */
+static void scenes_pin( scenes_t *scenes )
+{
+    for( int c = 0; c < scenes->num_channels; c++ ) {
+        int pinned = 0;
+        for( int i = 0; i < SCENES_MAX; i++ ) {
+            if( scenes->scenes[ i ].stored && scenes->scenes[ i ].needs[ c ] ) {
+                pinned = 1;
+            }
+        }
+        channel_set_pinned( scenes->channels[ c ], pinned );
+    }
+}
+
+static void scenes_load( scenes_t *scenes )
+{
+    scene_t *scene = 0;
+    char line[ 512 ];
+    int lineno = 0;
+    int count = 0;
+
+    FILE *f = fopen( scenes->filename, "r" );
+    if( !f ) return;
+
+    while( fgets( line, sizeof( line ), f ) ) {
+        char name[ 64 ];
+        char title[ 32 ];
+        int index, fade, raw, len;
+
+        lineno++;
+        char *hash = strchr( line, '#' );
+        if( hash ) *hash = '\0';
+        if( sscanf( line, " %63s %n", name, &len ) < 1 ) continue;
+
+        if( !strcmp( name, "scene" ) ) {
+            scene = 0;
+            if( sscanf( line + len, "%d %31s %d", &index, title, &fade ) != 3 ||
+                index < 0 || index >= SCENES_MAX || fade < 0 ) {
+                fprintf( stderr, "scenes: %s:%d: bad scene\n",
+                         scenes->filename, lineno );
+                continue;
+            }
+            scene = &scenes->scenes[ index ];
+            scenes_clear( scenes, scene );
+            snprintf( scene->name, sizeof( scene->name ), "%s", title );
+            scene->fade_ms = fade;
+            scene->stored = 1;
+            count++;
+        } else if( !scene ) {
+            continue;
+        } else if( !strcmp( name, "need" ) ) {
+            char *p = line + len;
+            int n;
+            while( sscanf( p, "%63s%n", name, &n ) == 1 ) {
+                int c = scenes_find_channel( scenes, name );
+                if( c < 0 ) {
+                    fprintf( stderr, "scenes: %s:%d: no channel named %s\n",
+                             scenes->filename, lineno, name );
+                } else {
+                    scene->needs[ c ] = 1;
+                }
+                p += n;
+            }
+        } else {
+            int slot = controlbus_find( scenes->controlbus, name );
+            if( slot < 0 ) {
+                fprintf( stderr, "scenes: %s:%d: no control named %s\n",
+                         scenes->filename, lineno, name );
+            } else if( sscanf( line + len, "%d", &raw ) != 1 || raw < 0 ) {
+                fprintf( stderr, "scenes: %s:%d: bad value for %s\n",
+                         scenes->filename, lineno, name );
+            } else {
+                scene->raw[ slot ] = raw;
+            }
+        }
+    }
+    fclose( f );
+    fprintf( stderr, "scenes: loaded %d scenes from %s\n", count,
+             scenes->filename );
+}
+
+/**
+ * Writes every stored scene to a new file, then moves it over the old
+ * one, so a failed write never loses the scenes already saved.
+ */
+static int scenes_save( scenes_t *scenes )
+{
+    char tmpname[ 256 ];
+    FILE *f;
+
+    snprintf( tmpname, sizeof( tmpname ), "%s.tmp", scenes->filename );
+    f = fopen( tmpname, "w" );
+    if( !f ) {
+        fprintf( stderr, "scenes: Cannot write %s: %s\n", tmpname, strerror( errno ) );
+        return 0;
+    }
+
+    fprintf( f, "# scene number, name and fade in ms, the channels it draws,\n"
+                "# then the raw value of each control\n" );
+    for( int i = 0; i < SCENES_MAX; i++ ) {
+        scene_t *scene = &scenes->scenes[ i ];
+        if( !scene->stored ) continue;
+
+        fprintf( f, "\nscene %d %s %d\nneed", i, scene->name, scene->fade_ms );
+        for( int c = 0; c < scenes->num_channels; c++ ) {
+            if( scene->needs[ c ] ) {
+                fprintf( f, " %s", channel_get_name( scenes->channels[ c ] ) );
+            }
+        }
+        fprintf( f, "\n" );
+        for( int s = 0; s < scenes->num_slots; s++ ) {
+            if( scene->raw[ s ] >= 0 ) {
+                fprintf( f, "%s %d\n", controlbus_get_name( scenes->controlbus, s ),
+                         scene->raw[ s ] );
+            }
+        }
+    }
+
+    if( fclose( f ) != 0 || rename( tmpname, scenes->filename ) < 0 ) {
+        fprintf( stderr, "scenes: Cannot write %s: %s\n", scenes->filename,
+                 strerror( errno ) );
+        remove( tmpname );
+        return 0;
+    }
+    return 1;
+}
+
+scenes_t *scenes_new( const char *filename, controlbus_t *controlbus,
+                      channel_t **channels, int num_channels )
+{
+    scenes_t *scenes = calloc( 1, sizeof( scenes_t ) );
+    int failed = 0;
+
+    if( !scenes ) return 0;
+
+    scenes->filename = filename;
+    scenes->controlbus = controlbus;
+    scenes->channels = channels;
+    scenes->num_channels = num_channels;
+    scenes->num_slots = controlbus_get_count( controlbus );
+    scenes->pending = 0;
+    scenes->current = -1;
+    scenes->stepped = calloc( scenes->num_slots + 1, sizeof( int ) );
+    scenes->from = calloc( scenes->num_slots + 1, sizeof( int ) );
+    failed = !scenes->stepped || !scenes->from;
+    for( int i = 0; i < SCENES_MAX; i++ ) {
+        scenes->scenes[ i ].raw = malloc( (scenes->num_slots + 1) * sizeof( int ) );
+        scenes->scenes[ i ].needs = calloc( num_channels + 1, sizeof( int ) );
+        failed |= !scenes->scenes[ i ].raw || !scenes->scenes[ i ].needs;
+    }
+    if( failed ) {
+        scenes_delete( scenes );
+        return 0;
+    }
+
+    for( int c = 0; c < num_channels; c++ ) {
+        for( size_t i = 0; i < sizeof( stepped_params ) / sizeof( int ); i++ ) {
+            int slot = channel_get_slot( channels[ c ], stepped_params[ i ] );
+            if( slot >= 0 ) scenes->stepped[ slot ] = 1;
+        }
+    }
+    for( int i = 0; i < SCENES_MAX; i++ ) {
+        scenes_clear( scenes, &scenes->scenes[ i ] );
+    }
+
+    scenes_load( scenes );
+    scenes_pin( scenes );
+    return scenes;
+}
+
+void scenes_delete( scenes_t *scenes )
+{
+    for( int i = 0; i < SCENES_MAX; i++ ) {
+        free( scenes->scenes[ i ].raw );
+        free( scenes->scenes[ i ].needs );
+    }
+    free( scenes->stepped );
+    free( scenes->from );
+    free( scenes );
+}
+
+int scenes_store( scenes_t *scenes, int index )
+{
+    if( index < 0 || index >= SCENES_MAX ) return 0;
+
+    scene_t *scene = &scenes->scenes[ index ];
+    if( !scene->stored ) {
+        snprintf( scene->name, sizeof( scene->name ), "scene%d", index );
+        scene->fade_ms = DEFAULT_FADE_MS;
+    }
+    for( int i = 0; i < scenes->num_slots; i++ ) {
+        scene->raw[ i ] = controlbus_get_raw( scenes->controlbus, i );
+    }
+    for( int c = 0; c < scenes->num_channels; c++ ) {
+        scene->needs[ c ] = channel_wants_texture( scenes->channels[ c ] );
+    }
+    scene->stored = 1;
+    scenes_pin( scenes );
+
+    fprintf( stderr, "scenes: stored %s\n", scene->name );
+    return scenes_save( scenes );
+}
+
+void scenes_trigger( scenes_t *scenes, int index )
+{
+    if( index < 0 || index >= SCENES_MAX ) return;
+    __atomic_store_n( &scenes->pending, index + 1, __ATOMIC_RELEASE );
+    controlbus_wake( scenes->controlbus );
+}
+
+int scenes_update( scenes_t *scenes )
+{
+    int cue = __atomic_exchange_n( &scenes->pending, 0, __ATOMIC_ACQUIRE ) - 1;
+
+    if( cue >= 0 && scenes->scenes[ cue ].stored ) {
+        for( int i = 0; i < scenes->num_slots; i++ ) {
+            scenes->from[ i ] = controlbus_get_raw( scenes->controlbus, i );
+        }
+        scenes->current = cue;
+        scenes->start_ns = scenes_now();
+        fprintf( stderr, "scenes: recalling %s over %dms\n",
+                 scenes->scenes[ cue ].name, scenes->scenes[ cue ].fade_ms );
+    }
+    if( scenes->current < 0 ) return 0;
+
+    scene_t *scene = &scenes->scenes[ scenes->current ];
+    double t = 1.0;
+    if( scene->fade_ms > 0 ) {
+        t = (scenes_now() - scenes->start_ns) / (scene->fade_ms * 1000000.0);
+        if( t > 1.0 ) t = 1.0;
+    }
+
+    for( int i = 0; i < scenes->num_slots; i++ ) {
+        int to = scene->raw[ i ];
+        int raw = to;
+
+        if( to < 0 ) continue;
+        if( scenes->stepped[ i ] ) {
+            if( t < 0.5 ) raw = scenes->from[ i ];
+        } else {
+            raw = scenes->from[ i ] + (int) ((to - scenes->from[ i ]) * t);
+        }
+        controlbus_set( scenes->controlbus, i, raw );
+    }
+
+    if( t >= 1.0 ) scenes->current = -1;
+    return 1;
+}
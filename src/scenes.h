@@ -0,0 +1,105 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SCENES_H_INCLUDED
+#define SCENES_H_INCLUDED
+
+#include "controlbus.h"
+#include "channel.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Scene presets.  A scene is a snapshot of the raw value of every slot
+ * on the bus, which includes the image control of each channel, so
+ * recalling it brings back the whole look at once, either straight away
+ * or as a crossfade over the scene's fade time.  Controls that step,
+ * like blend, flip and image, switch halfway through a fade, and the
+ * rest move smoothly from where they were.
+ *
+ * Each scene also remembers which channels it had on or near the
+ * screen, and those channels are pinned so their textures stay
+ * resident.  Together with channel_add_image(), which keeps every
+ * alternative image uploaded, a cue never waits on the disk.
+ *
+ * Scenes are kept in a text file, loaded once at startup and rewritten
+ * whenever a scene is stored:
+ *
+ *   scene 0 intro 2000       # number, name, fade in ms
+ *   need ch0 ch5             # channels it draws
+ *   ch0.x_offset 32768       # raw value of each slot
+ *
+ * Slots a scene does not name are left alone when it is recalled.
+ *
+ * Example usage:
+ *
+ * scenes_t *scenes = scenes_new( "vcontrol.scenes", bus, channels, count );
+ *
+ * // any thread
+ * scenes_trigger( scenes, 3 );
+ *
+ * // render thread, before controlbus_collect()
+ * animating |= scenes_update( scenes );
+ */
+
+#define SCENES_MAX 16
+
+typedef struct scenes_s scenes_t;
+
+/**
+ * Loads the scenes in the file, if it exists, and pins the channels
+ * they need.  Every slot must already have been added to the bus.
+ * Returns 0 on error.
+ */
+scenes_t *scenes_new( const char *filename, controlbus_t *controlbus,
+                      channel_t **channels, int num_channels );
+void scenes_delete( scenes_t *scenes );
+
+/**
+ * Captures the bus into the numbered scene, keeping its name and fade
+ * time if it already had them, and rewrites the file.  Only the render
+ * thread should call this, after channel_prepare() has placed the
+ * channels.  Returns 0 if the file could not be written.
+ */
+int scenes_store( scenes_t *scenes, int index );
+
+/**
+ * Asks for a scene to be recalled on the next scenes_update().  Safe to
+ * call from any thread.  Unknown or empty scenes are ignored.
+ */
+void scenes_trigger( scenes_t *scenes, int index );
+
+/**
+ * Starts any scene triggered since the last call, and moves a fade in
+ * progress on.  Returns true while a scene is being applied, so the
+ * caller keeps drawing.  Only the render thread should call this.
+ */
+int scenes_update( scenes_t *scenes );
+
+#ifdef __cplusplus
+};
+#endif
+#endif /* SCENES_H_INCLUDED */
@@ -0,0 +1,115 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include "shmout.h"
+
+/**
+ * Publishes a test pattern through shmout, so shmview and other readers
+ * can be tried without running vcontrol.  Every pixel of row y in frame
+ * n holds the 32 bit word (n << 16) | y, in native byte order, which
+ * lets a reader check that a frame it copied is whole.
+ */
+
+#define SHMFEED_SLOTS 4
+
+static double now_ms( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (ts.tv_sec * 1000.0) + (ts.tv_nsec / 1000000.0);
+}
+
+static void usage( const char *argv0 )
+{
+    fprintf( stderr, "usage: %s [-w width] [-h height] [-r fps] [-s seconds] "
+             "[name]\n", argv0 );
+}
+
+int main( int argc, char **argv )
+{
+    const char *name = "/vcontrol";
+    int width = 720;
+    int height = 480;
+    int fps = 60;
+    int seconds = 10;
+    int opt;
+
+    while( (opt = getopt( argc, argv, "w:h:r:s:" )) != -1 ) {
+        switch( opt ) {
+        case 'w': width = atoi( optarg ); break;
+        case 'h': height = atoi( optarg ); break;
+        case 'r': fps = atoi( optarg ); break;
+        case 's': seconds = atoi( optarg ); break;
+        default: usage( argv[ 0 ] ); return 1;
+        }
+    }
+    if( optind < argc ) name = argv[ optind ];
+    if( width <= 0 || height <= 0 || fps < 0 || seconds <= 0 ) {
+        usage( argv[ 0 ] );
+        return 1;
+    }
+
+    shmout_t *shmout = shmout_new( name, width, height, SHMFEED_SLOTS );
+    if( !shmout ) return 1;
+    int stride = shmout_get_stride( shmout );
+
+    /* A rate of 0 publishes as fast as it can. */
+    double start = now_ms();
+    double end = start + (seconds * 1000.0);
+    double now;
+    while( (now = now_ms()) < end ) {
+        uint64_t frame = shmout_get_frames( shmout ) + 1;
+        uint8_t *pixels = shmout_begin( shmout );
+
+        for( int y = 0; y < height; y++ ) {
+            uint32_t *row = (uint32_t *) (pixels + ((size_t) y * stride));
+            uint32_t word = ((uint32_t) frame << 16) | (y & 0xffff);
+            for( int x = 0; x < width; x++ ) row[ x ] = word;
+        }
+        shmout_end( shmout, (uint64_t) now );
+
+        if( fps ) {
+            double due = start + ((frame * 1000.0) / fps);
+            double wait = due - now_ms();
+            if( wait > 0 ) {
+                struct timespec ts;
+                ts.tv_sec = (time_t) (wait / 1000.0);
+                ts.tv_nsec = (long) (wait * 1000000.0) % 1000000000L;
+                nanosleep( &ts, 0 );
+            }
+        }
+    }
+
+    fprintf( stderr, "shmfeed: published %llu frames in %d seconds\n",
+             (unsigned long long) shmout_get_frames( shmout ), seconds );
+    shmout_delete( shmout );
+    return 0;
+}
@@ -0,0 +1,85 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SHMFRAME_H_INCLUDED
+#define SHMFRAME_H_INCLUDED
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * The layout of the shared memory frame ring written by shmout and read
+ * by shmin, for readers that would rather map it themselves.
+ *
+ * The object starts with one page of header, followed by num_slots
+ * frames of slot_size bytes each, the first at data_offset.  Frames are
+ * written to the slots in turn, so frame n is in slot n % num_slots.
+ *
+ * Each slot's sequence is a seqlock: it is odd while the slot is being
+ * written, and 2 * n once frame n is complete.  The header's frame is
+ * the number of the newest complete frame, counting from 1, or 0 if
+ * none has been written yet.  Readers never write to the object, they
+ * check the sequence before and after using a slot instead, and try
+ * again if it has changed.
+ */
+
+#define SHMFRAME_MAGIC "vcshmfr"
+#define SHMFRAME_VERSION 1
+#define SHMFRAME_MAX_SLOTS 16
+#define SHMFRAME_PAGE 4096
+
+/* Four bytes per pixel, in R, G, B, A order. */
+#define SHMFRAME_FORMAT_RGBA 0x41424752
+
+typedef struct shmframe_slot_s
+{
+    uint64_t sequence;
+    uint64_t ticks;
+} shmframe_slot_t;
+
+typedef struct shmframe_header_s
+{
+    char magic[ 8 ];
+    uint32_t version;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;
+    uint32_t num_slots;
+    uint64_t slot_size;
+    uint64_t data_offset;
+
+    /* Written by the producer with release ordering. */
+    uint64_t frame;
+    uint8_t pad[ 8 ];
+    shmframe_slot_t slots[ SHMFRAME_MAX_SLOTS ];
+} shmframe_header_t;
+
+#ifdef __cplusplus
+};
+#endif
+#endif /* SHMFRAME_H_INCLUDED */
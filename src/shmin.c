@@ -0,0 +1,194 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "shmframe.h"
+#include "shmin.h"
+
+/* How often shmin_wait() looks for a new frame. */
+#define POLL_US 500
+
+/* Attempts at copying a frame before giving up on a fast producer. */
+#define COPY_TRIES 8
+
+struct shmin_s
+{
+    void *map;
+    size_t size;
+    const shmframe_header_t *header;
+};
+
+shmin_t *shmin_new( const char *name )
+{
+    const shmframe_header_t *h;
+    struct stat st;
+    int fd;
+
+    fd = shm_open( name, O_RDONLY, 0 );
+    if( fd < 0 ) {
+        fprintf( stderr, "shmin: Cannot open %s: %s\n", name, strerror( errno ) );
+        return 0;
+    }
+    if( fstat( fd, &st ) < 0 || (size_t) st.st_size < SHMFRAME_PAGE ) {
+        fprintf( stderr, "shmin: %s is not a frame ring\n", name );
+        close( fd );
+        return 0;
+    }
+
+    shmin_t *shmin = malloc( sizeof( shmin_t ) );
+    if( !shmin ) {
+        close( fd );
+        return 0;
+    }
+    shmin->size = st.st_size;
+    shmin->map = mmap( 0, shmin->size, PROT_READ, MAP_SHARED, fd, 0 );
+    close( fd );
+    if( shmin->map == MAP_FAILED ) {
+        fprintf( stderr, "shmin: Cannot map %s: %s\n", name, strerror( errno ) );
+        free( shmin );
+        return 0;
+    }
+    shmin->header = h = shmin->map;
+
+    if( memcmp( h->magic, SHMFRAME_MAGIC, sizeof( SHMFRAME_MAGIC ) ) ) {
+        fprintf( stderr, "shmin: %s is not a frame ring\n", name );
+        shmin_delete( shmin );
+        return 0;
+    }
+    __atomic_thread_fence( __ATOMIC_ACQUIRE );
+    if( h->version != SHMFRAME_VERSION || h->format != SHMFRAME_FORMAT_RGBA ||
+        h->num_slots < 2 || h->num_slots > SHMFRAME_MAX_SLOTS ||
+        h->stride < h->width * 4 || h->slot_size < (uint64_t) h->stride * h->height ||
+        h->data_offset < sizeof( shmframe_header_t ) ||
+        (shmin->size - h->data_offset) / h->slot_size < h->num_slots ) {
+        fprintf( stderr, "shmin: %s has an unsupported layout\n", name );
+        shmin_delete( shmin );
+        return 0;
+    }
+    return shmin;
+}
+
+void shmin_delete( shmin_t *shmin )
+{
+    munmap( shmin->map, shmin->size );
+    free( shmin );
+}
+
+int shmin_get_width( shmin_t *shmin )
+{
+    return shmin->header->width;
+}
+
+int shmin_get_height( shmin_t *shmin )
+{
+    return shmin->header->height;
+}
+
+int shmin_get_stride( shmin_t *shmin )
+{
+    return shmin->header->stride;
+}
+
+int shmin_get_slots( shmin_t *shmin )
+{
+    return shmin->header->num_slots;
+}
+
+uint64_t shmin_get_latest( shmin_t *shmin )
+{
+    return __atomic_load_n( &shmin->header->frame, __ATOMIC_ACQUIRE );
+}
+
+uint64_t shmin_wait( shmin_t *shmin, uint64_t last, int timeout_ms )
+{
+    struct timespec poll = { 0, POLL_US * 1000 };
+    int tries = (timeout_ms * 1000) / POLL_US;
+    uint64_t latest;
+
+    while( (latest = shmin_get_latest( shmin )) == last && tries-- > 0 ) {
+        nanosleep( &poll, 0 );
+    }
+    return latest;
+}
+
+static const shmframe_slot_t *shmin_slot( shmin_t *shmin, uint64_t frame )
+{
+    return &shmin->header->slots[ frame % shmin->header->num_slots ];
+}
+
+const uint8_t *shmin_get_pixels( shmin_t *shmin, uint64_t frame )
+{
+    const shmframe_slot_t *slot = shmin_slot( shmin, frame );
+
+    if( !frame || __atomic_load_n( &slot->sequence, __ATOMIC_ACQUIRE ) != frame * 2 ) {
+        return 0;
+    }
+    return ((const uint8_t *) shmin->map) + shmin->header->data_offset +
+           (frame % shmin->header->num_slots) * shmin->header->slot_size;
+}
+
+uint64_t shmin_get_ticks( shmin_t *shmin, uint64_t frame )
+{
+    return __atomic_load_n( &shmin_slot( shmin, frame )->ticks, __ATOMIC_RELAXED );
+}
+
+int shmin_check( shmin_t *shmin, uint64_t frame )
+{
+    /* Keep the reads of the pixels from moving past the sequence. */
+    __atomic_thread_fence( __ATOMIC_ACQUIRE );
+    return __atomic_load_n( &shmin_slot( shmin, frame )->sequence,
+                            __ATOMIC_RELAXED ) == frame * 2;
+}
+
+uint64_t shmin_copy( shmin_t *shmin, uint8_t *dst, int stride )
+{
+    int width = shmin->header->width * 4;
+    int height = shmin->header->height;
+    int src_stride = shmin->header->stride;
+
+    for( int i = 0; i < COPY_TRIES; i++ ) {
+        uint64_t frame = shmin_get_latest( shmin );
+        const uint8_t *src = shmin_get_pixels( shmin, frame );
+        if( !src ) {
+            if( !frame ) return 0;
+            continue;
+        }
+        for( int y = 0; y < height; y++ ) {
+            memcpy( dst + (y * stride), src + (y * src_stride), width );
+        }
+        if( shmin_check( shmin, frame ) ) return frame;
+    }
+    return 0;
+}
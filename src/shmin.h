@@ -0,0 +1,109 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SHMIN_H_INCLUDED
+#define SHMIN_H_INCLUDED
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Attaches read-only to a frame ring published by shmout.  Frames can
+ * be used in place, as long as shmin_check() is asked afterwards
+ * whether the producer came round and overwrote the slot meanwhile, or
+ * copied out with shmin_copy() which takes care of that itself.
+ *
+ * Example usage:
+ *
+ * shmin_t *in = shmin_new( "/vcontrol" );
+ * uint64_t frame = shmin_wait( in, 0, 1000 );
+ * const uint8_t *pixels = shmin_get_pixels( in, frame );
+ * use pixels
+ * if( !shmin_check( in, frame ) ) throw away what was done with them
+ * shmin_delete( in );
+ */
+
+typedef struct shmin_s shmin_t;
+
+/**
+ * Maps the shared memory object with the given name.  Returns 0 if it
+ * does not exist or is not a frame ring.
+ */
+shmin_t *shmin_new( const char *name );
+
+/**
+ * Unmaps the object.
+ */
+void shmin_delete( shmin_t *shmin );
+
+/**
+ * Returns the frame size, the bytes per row, and the number of slots.
+ */
+int shmin_get_width( shmin_t *shmin );
+int shmin_get_height( shmin_t *shmin );
+int shmin_get_stride( shmin_t *shmin );
+int shmin_get_slots( shmin_t *shmin );
+
+/**
+ * Returns the number of the newest frame, or 0 if there is none yet.
+ */
+uint64_t shmin_get_latest( shmin_t *shmin );
+
+/**
+ * Waits up to timeout_ms for a frame newer than last, polling the
+ * header, and returns the newest frame number, which is last if none
+ * arrived in time.
+ */
+uint64_t shmin_wait( shmin_t *shmin, uint64_t last, int timeout_ms );
+
+/**
+ * Returns the pixels of the given frame, or 0 if it has already been
+ * overwritten.
+ */
+const uint8_t *shmin_get_pixels( shmin_t *shmin, uint64_t frame );
+
+/**
+ * Returns the time the given frame was drawn, in milliseconds.
+ */
+uint64_t shmin_get_ticks( shmin_t *shmin, uint64_t frame );
+
+/**
+ * Returns true if the given frame is still intact in its slot, so
+ * anything read from shmin_get_pixels() since is good.
+ */
+int shmin_check( shmin_t *shmin, uint64_t frame );
+
+/**
+ * Copies the newest intact frame to dst, with stride bytes per row,
+ * and returns its number, or 0 if there was none.
+ */
+uint64_t shmin_copy( shmin_t *shmin, uint8_t *dst, int stride );
+
+#ifdef __cplusplus
+};
+#endif
+#endif /* SHMIN_H_INCLUDED */
@@ -0,0 +1,165 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "shmframe.h"
+#include "shmout.h"
+
+struct shmout_s
+{
+    char *name;
+    void *map;
+    size_t size;
+    shmframe_header_t *header;
+    uint64_t frame;
+};
+
+shmout_t *shmout_new( const char *name, int width, int height, int slots )
+{
+    shmframe_header_t *header;
+    size_t stride, slot_size;
+    int fd;
+
+    if( slots < 2 || slots > SHMFRAME_MAX_SLOTS ) {
+        fprintf( stderr, "shmout: Need 2 to %d slots, not %d\n",
+                 SHMFRAME_MAX_SLOTS, slots );
+        return 0;
+    }
+
+    shmout_t *shmout = malloc( sizeof( shmout_t ) );
+    if( !shmout ) return 0;
+    shmout->name = strdup( name );
+    if( !shmout->name ) {
+        free( shmout );
+        return 0;
+    }
+
+    /* Rows start on cache lines and slots on pages. */
+    stride = ((size_t) width * 4 + 63) & ~((size_t) 63);
+    slot_size = (stride * height + SHMFRAME_PAGE - 1) & ~((size_t) SHMFRAME_PAGE - 1);
+    shmout->size = SHMFRAME_PAGE + slot_size * slots;
+    shmout->frame = 0;
+
+    /**
+     * Readers still attached to an old object keep it, and whoever
+     * opens the name from now on gets the new one.
+     */
+    shm_unlink( name );
+    fd = shm_open( name, O_RDWR | O_CREAT | O_EXCL, 0644 );
+    if( fd < 0 ) {
+        fprintf( stderr, "shmout: Cannot create %s: %s\n", name, strerror( errno ) );
+        free( shmout->name );
+        free( shmout );
+        return 0;
+    }
+    if( ftruncate( fd, shmout->size ) < 0 ) {
+        fprintf( stderr, "shmout: Cannot size %s: %s\n", name, strerror( errno ) );
+        close( fd );
+        shm_unlink( name );
+        free( shmout->name );
+        free( shmout );
+        return 0;
+    }
+
+    shmout->map = mmap( 0, shmout->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    close( fd );
+    if( shmout->map == MAP_FAILED ) {
+        fprintf( stderr, "shmout: Cannot map %s: %s\n", name, strerror( errno ) );
+        shm_unlink( name );
+        free( shmout->name );
+        free( shmout );
+        return 0;
+    }
+
+    /* The object starts zeroed, so every slot is empty and frame is 0. */
+    header = shmout->map;
+    header->version = SHMFRAME_VERSION;
+    header->format = SHMFRAME_FORMAT_RGBA;
+    header->width = width;
+    header->height = height;
+    header->stride = stride;
+    header->num_slots = slots;
+    header->slot_size = slot_size;
+    header->data_offset = SHMFRAME_PAGE;
+    shmout->header = header;
+
+    /* Readers check the magic last, once the rest is in place. */
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+    memcpy( header->magic, SHMFRAME_MAGIC, sizeof( SHMFRAME_MAGIC ) );
+
+    fprintf( stderr, "shmout: Publishing %dx%d frames to %s\n", width, height, name );
+    return shmout;
+}
+
+void shmout_delete( shmout_t *shmout )
+{
+    munmap( shmout->map, shmout->size );
+    shm_unlink( shmout->name );
+    free( shmout->name );
+    free( shmout );
+}
+
+int shmout_get_stride( shmout_t *shmout )
+{
+    return shmout->header->stride;
+}
+
+uint8_t *shmout_begin( shmout_t *shmout )
+{
+    uint64_t next = shmout->frame + 1;
+    shmframe_slot_t *slot = &shmout->header->slots[ next % shmout->header->num_slots ];
+
+    /* Readers of the frame this slot held will see it change. */
+    __atomic_store_n( &slot->sequence, (next * 2) - 1, __ATOMIC_RELAXED );
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+
+    return ((uint8_t *) shmout->map) + shmout->header->data_offset +
+           (next % shmout->header->num_slots) * shmout->header->slot_size;
+}
+
+void shmout_end( shmout_t *shmout, uint64_t ticks )
+{
+    uint64_t next = shmout->frame + 1;
+    shmframe_slot_t *slot = &shmout->header->slots[ next % shmout->header->num_slots ];
+
+    __atomic_store_n( &slot->ticks, ticks, __ATOMIC_RELAXED );
+    __atomic_store_n( &slot->sequence, next * 2, __ATOMIC_RELEASE );
+    __atomic_store_n( &shmout->header->frame, next, __ATOMIC_RELEASE );
+    shmout->frame = next;
+}
+
+uint64_t shmout_get_frames( shmout_t *shmout )
+{
+    return shmout->frame;
+}
@@ -0,0 +1,90 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SHMOUT_H_INCLUDED
+#define SHMOUT_H_INCLUDED
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Publishes frames to other processes through a POSIX shared memory
+ * ring, laid out as described in shmframe.h.  Frames are written in
+ * place, and readers attach read-only with shmin, so the producer never
+ * waits for them and a slow reader only misses frames.
+ *
+ * Example usage:
+ *
+ * shmout_t *out = shmout_new( "/vcontrol", 720, 480, 3 );
+ * uint8_t *pixels = shmout_begin( out );
+ * fill pixels, shmout_get_stride( out ) bytes per row
+ * shmout_end( out, SDL_GetTicks() );
+ * shmout_delete( out );
+ */
+
+typedef struct shmout_s shmout_t;
+
+/**
+ * Creates the shared memory object with the given name, which should
+ * start with a slash, holding slots RGBA frames of width by height.
+ * Any old object of the same name is replaced.  Returns 0 on error.
+ */
+shmout_t *shmout_new( const char *name, int width, int height, int slots );
+
+/**
+ * Unmaps and unlinks the object.  Readers already attached keep their
+ * mapping, but see no new frames.
+ */
+void shmout_delete( shmout_t *shmout );
+
+/**
+ * Returns the number of bytes per row in a slot.
+ */
+int shmout_get_stride( shmout_t *shmout );
+
+/**
+ * Marks the next slot as being written and returns its pixels.  If the
+ * frame cannot be filled, skip shmout_end(), and the slot is left to
+ * readers as unfinished until the next shmout_begin() rewrites it.
+ */
+uint8_t *shmout_begin( shmout_t *shmout );
+
+/**
+ * Publishes the slot from shmout_begin() as the newest frame, drawn at
+ * the given time in milliseconds.
+ */
+void shmout_end( shmout_t *shmout, uint64_t ticks );
+
+/**
+ * Returns the number of frames published.
+ */
+uint64_t shmout_get_frames( shmout_t *shmout );
+
+#ifdef __cplusplus
+};
+#endif
+#endif /* SHMOUT_H_INCLUDED */
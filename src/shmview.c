@@ -0,0 +1,157 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "shmin.h"
+
+/**
+ * Attaches to vcontrol's shared memory output with one or more reader
+ * threads, each copying out every frame it can, and reports how many
+ * frames each one got, missed, or found overwritten under it.  shmfeed
+ * publishes a test pattern to try it against without vcontrol.
+ */
+
+typedef struct reader_s
+{
+    const char *name;
+    int seconds;
+    pthread_t thread_handle;
+    uint64_t frames;
+    uint64_t missed;
+    uint64_t torn;
+    uint64_t bytes;
+} reader_t;
+
+static double now_ms( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (ts.tv_sec * 1000.0) + (ts.tv_nsec / 1000000.0);
+}
+
+static void *reader_thread( void *arg )
+{
+    reader_t *reader = arg;
+    shmin_t *shmin = shmin_new( reader->name );
+    if( !shmin ) return NULL;
+
+    int stride = shmin_get_width( shmin ) * 4;
+    uint8_t *copy = malloc( (size_t) stride * shmin_get_height( shmin ) );
+    if( !copy ) {
+        shmin_delete( shmin );
+        return NULL;
+    }
+
+    double end = now_ms() + (reader->seconds * 1000.0);
+    uint64_t last = shmin_get_latest( shmin );
+    while( now_ms() < end ) {
+        uint64_t frame = shmin_wait( shmin, last, 100 );
+        if( frame == last ) continue;
+
+        const uint8_t *pixels = shmin_get_pixels( shmin, frame );
+        if( pixels ) {
+            for( int y = 0; y < shmin_get_height( shmin ); y++ ) {
+                memcpy( copy + (y * stride), pixels + (y * shmin_get_stride( shmin )),
+                        stride );
+            }
+        }
+        if( !pixels || !shmin_check( shmin, frame ) ) {
+            reader->torn++;
+        } else {
+            reader->frames++;
+            reader->bytes += (uint64_t) stride * shmin_get_height( shmin );
+        }
+        if( last && frame > last + 1 ) reader->missed += frame - last - 1;
+        last = frame;
+    }
+
+    free( copy );
+    shmin_delete( shmin );
+    return NULL;
+}
+
+static void usage( const char *argv0 )
+{
+    fprintf( stderr, "usage: %s [-t readers] [-s seconds] [name]\n", argv0 );
+}
+
+int main( int argc, char **argv )
+{
+    const char *name = "/vcontrol";
+    int readers = 1;
+    int seconds = 5;
+    int opt;
+
+    while( (opt = getopt( argc, argv, "t:s:" )) != -1 ) {
+        switch( opt ) {
+        case 't': readers = atoi( optarg ); break;
+        case 's': seconds = atoi( optarg ); break;
+        default: usage( argv[ 0 ] ); return 1;
+        }
+    }
+    if( optind < argc ) name = argv[ optind ];
+    if( readers <= 0 || seconds <= 0 ) {
+        usage( argv[ 0 ] );
+        return 1;
+    }
+
+    shmin_t *shmin = shmin_new( name );
+    if( !shmin ) return 1;
+    fprintf( stderr, "shmview: %s is %dx%d, %d slots, at frame %llu\n", name,
+             shmin_get_width( shmin ), shmin_get_height( shmin ),
+             shmin_get_slots( shmin ), (unsigned long long) shmin_get_latest( shmin ) );
+    shmin_delete( shmin );
+
+    reader_t *reader = calloc( readers, sizeof( reader_t ) );
+    if( !reader ) return 1;
+    for( int i = 0; i < readers; i++ ) {
+        reader[ i ].name = name;
+        reader[ i ].seconds = seconds;
+        if( pthread_create( &reader[ i ].thread_handle, NULL,
+                            reader_thread, &reader[ i ] ) != 0 ) {
+            fprintf( stderr, "shmview: failed to create reader thread\n" );
+            readers = i;
+            break;
+        }
+    }
+
+    for( int i = 0; i < readers; i++ ) {
+        pthread_join( reader[ i ].thread_handle, NULL );
+        fprintf( stderr, "shmview: reader %d: %.1f fps, %.1f MB/s, %llu missed, "
+                 "%llu torn\n", i, reader[ i ].frames / (double) seconds,
+                 reader[ i ].bytes / (seconds * 1024.0 * 1024.0),
+                 (unsigned long long) reader[ i ].missed,
+                 (unsigned long long) reader[ i ].torn );
+    }
+    free( reader );
+    return 0;
+}
@@ -0,0 +1,287 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "bufpool.h"
+#include "imageinput.h"
+#include "mipmap.h"
+#include "testimage.h"
+
+/**
+ * Soaks the buffer pool.  Worker threads allocate, fill, check and free
+ * buffers of many sizes at once, and the pool must never hand the same
+ * buffer out twice or keep more than its limit.  Meanwhile images of
+ * every format and colour type are reloaded over and over the way a
+ * channel decodes them, through imageinput and mipmap.  Once the first
+ * reloads have filled the pool, nothing may miss it, and the resident
+ * set must stay flat.
+ *
+ * Runs for a couple of seconds by default, or give it a number of
+ * seconds for a long soak, such as 28800 for a night.
+ */
+
+#define THREADS 4
+#define HELD 4
+#define NUM_SIZES 16
+#define NUM_IMAGES 6
+#define IMAGE_WIDTH 1031
+#define IMAGE_HEIGHT 517
+#define SCREEN_WIDTH 320
+#define SCREEN_HEIGHT 240
+#define WARMUP_RELOADS 2
+
+/* Growth in the resident set allowed for stacks and the like. */
+#define MAX_RSS_GROWTH (4 * 1024 * 1024)
+
+static size_t sizes[ NUM_SIZES ];
+static double end_ms;
+static int corrupt;
+
+static double now_ms( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (ts.tv_sec * 1000.0) + (ts.tv_nsec / 1000000.0);
+}
+
+/**
+ * Returns the resident set size in bytes, or 0 if it cannot be read.
+ */
+static size_t resident_bytes( void )
+{
+    FILE *f = fopen( "/proc/self/statm", "r" );
+    unsigned long size, resident;
+    int ok;
+
+    if( !f ) return 0;
+    ok = fscanf( f, "%lu %lu", &size, &resident ) == 2;
+    fclose( f );
+    return ok ? (size_t) resident * sysconf( _SC_PAGESIZE ) : 0;
+}
+
+static void *worker( void *arg )
+{
+    uint8_t *held[ HELD ] = { 0 };
+    size_t held_size[ HELD ] = { 0 };
+    uint8_t mark = (uint8_t) (uintptr_t) arg;
+    uint32_t seed = mark + 1;
+
+    while( now_ms() < end_ms ) {
+        for( int i = 0; i < 1000; i++ ) {
+            seed = (seed * 1103515245) + 12345;
+            int slot = (seed >> 8) % HELD;
+
+            /* Anyone else writing to our buffer shows up here. */
+            if( held[ slot ] ) {
+                if( held[ slot ][ 0 ] != mark ||
+                    held[ slot ][ held_size[ slot ] - 1 ] != mark ) {
+                    __atomic_store_n( &corrupt, 1, __ATOMIC_RELAXED );
+                }
+                bufpool_free( held[ slot ] );
+            }
+            held_size[ slot ] = sizes[ (seed >> 16) % NUM_SIZES ];
+            held[ slot ] = bufpool_alloc( held_size[ slot ] );
+            if( !held[ slot ] ) {
+                __atomic_store_n( &corrupt, 1, __ATOMIC_RELAXED );
+                return NULL;
+            }
+            held[ slot ][ 0 ] = mark;
+            held[ slot ][ held_size[ slot ] - 1 ] = mark;
+        }
+        if( bufpool_get_cached() > BUFPOOL_MAX_CACHED ) {
+            __atomic_store_n( &corrupt, 1, __ATOMIC_RELAXED );
+        }
+    }
+    for( int i = 0; i < HELD; i++ ) bufpool_free( held[ i ] );
+    return NULL;
+}
+
+/**
+ * Loads an image the way channel_decode() does: decode it, copy out its
+ * scanlines, and reduce it to the smallest mip level covering the
+ * screen.
+ */
+static int reload( const char *name )
+{
+    imageinput_t *image = imageinput_new( name );
+    if( !image ) return 0;
+
+    int width = imageinput_get_width( image );
+    int height = imageinput_get_height( image );
+    int bpp = imageinput_has_alpha( image ) ? 4 : 3;
+    int stride = bpp * width;
+    int display_width, display_height;
+    uint8_t *data = bufpool_alloc( (size_t) width * height * 4 );
+
+    if( !data ) {
+        imageinput_delete( image );
+        return 0;
+    }
+    for( int i = 0; i < height; i++ ) {
+        memcpy( data + ((size_t) i * stride),
+                imageinput_get_scanline( image, i ), stride );
+    }
+    imageinput_delete( image );
+
+    mipmap_fit( width, height, SCREEN_WIDTH, SCREEN_HEIGHT,
+                &display_width, &display_height );
+    int ok = mipmap_reduce( &data, &width, &height, &stride, bpp,
+                            display_width, display_height );
+    bufpool_free( data );
+    return ok;
+}
+
+/**
+ * Writes PNGs of every colour type, and RGB and RGBA as QOI and TGA.
+ */
+static int write_images( char names[ NUM_IMAGES ][ 256 ] )
+{
+    for( int i = 0; i < NUM_IMAGES; i++ ) {
+        int channels = (i < 4) ? i + 1 : i - 1;
+        char suffix[ 32 ];
+        int ok;
+        uint8_t *pixels = testimage_pixels( IMAGE_WIDTH, IMAGE_HEIGHT,
+                                            channels );
+
+        if( !pixels ) return 0;
+        if( i < 4 ) {
+            snprintf( suffix, sizeof( suffix ), "soak%d.png", channels );
+            testimage_name( names[ i ], 256, suffix );
+            ok = testimage_write_png( names[ i ], pixels, IMAGE_WIDTH,
+                                      IMAGE_HEIGHT, channels );
+        } else if( i == 4 ) {
+            testimage_name( names[ i ], 256, "soak.qoi" );
+            ok = testimage_write_qoi( names[ i ], pixels, IMAGE_WIDTH,
+                                      IMAGE_HEIGHT, channels );
+        } else {
+            testimage_name( names[ i ], 256, "soak.tga" );
+            ok = testimage_write_tga( names[ i ], pixels, IMAGE_WIDTH,
+                                      IMAGE_HEIGHT, channels );
+        }
+        free( pixels );
+        if( !ok ) return 0;
+    }
+    return 1;
+}
+
+/**
+ * Fills the pool with as many buffers of each size as the workers can
+ * ever hold between them, on top of what reloading every image takes,
+ * so neither needs the heap once the soak starts.  Every buffer is
+ * touched, so it already counts in the resident set.
+ */
+static int prefill( char names[ NUM_IMAGES ][ 256 ] )
+{
+    static void *bufs[ NUM_SIZES * THREADS * HELD ];
+    int count = 0;
+    int ok = 1;
+
+    for( int i = 0; i < NUM_SIZES; i++ ) {
+        for( int j = 0; j < THREADS * HELD; j++ ) {
+            bufs[ count ] = bufpool_alloc( sizes[ i ] );
+            if( bufs[ count ] ) memset( bufs[ count ], 0, sizes[ i ] );
+            count++;
+        }
+    }
+    for( int run = 0; run < WARMUP_RELOADS && ok; run++ ) {
+        for( int i = 0; i < NUM_IMAGES && ok; i++ ) {
+            ok = reload( names[ i ] );
+        }
+    }
+    for( int i = 0; i < count; i++ ) bufpool_free( bufs[ i ] );
+    return ok;
+}
+
+int main( int argc, char **argv )
+{
+    int seconds = (argc > 1) ? atoi( argv[ 1 ] ) : 2;
+    pthread_t threads[ THREADS ];
+    char names[ NUM_IMAGES ][ 256 ];
+    unsigned long reloads = 0;
+    int failed = 0;
+
+    /* From 48 bytes to 1.5MB, a little off the class sizes. */
+    for( int i = 0; i < NUM_SIZES; i++ ) {
+        sizes[ i ] = ((size_t) 3 << (i + 4)) + (i * 7);
+    }
+    if( !write_images( names ) ) return 1;
+
+    if( !prefill( names ) ) return 1;
+    unsigned int misses = bufpool_get_misses();
+    size_t warm_rss = resident_bytes();
+
+    end_ms = now_ms() + (seconds * 1000.0);
+    for( int i = 0; i < THREADS; i++ ) {
+        pthread_create( &threads[ i ], NULL, worker, (void *) (uintptr_t) i );
+    }
+    while( now_ms() < end_ms ) {
+        if( !reload( names[ reloads % NUM_IMAGES ] ) ) {
+            fprintf( stderr, "test_bufpool: %s did not reload\n",
+                     names[ reloads % NUM_IMAGES ] );
+            failed = 1;
+            break;
+        }
+        reloads++;
+    }
+    for( int i = 0; i < THREADS; i++ ) pthread_join( threads[ i ], NULL );
+    size_t end_rss = resident_bytes();
+
+    if( corrupt ) {
+        fprintf( stderr, "test_bufpool: a buffer was shared, lost, or the "
+                 "pool grew past its limit\n" );
+        failed = 1;
+    }
+    if( bufpool_get_misses() != misses ) {
+        fprintf( stderr, "test_bufpool: %u allocations missed a full pool\n",
+                 bufpool_get_misses() - misses );
+        failed = 1;
+    }
+    if( !warm_rss || !end_rss ) {
+        fprintf( stderr, "test_bufpool: cannot read the resident set size\n" );
+        failed = 1;
+    } else if( end_rss > warm_rss + MAX_RSS_GROWTH ) {
+        fprintf( stderr, "test_bufpool: resident set grew from %.1fMB to "
+                 "%.1fMB\n", warm_rss / (1024.0 * 1024.0),
+                 end_rss / (1024.0 * 1024.0) );
+        failed = 1;
+    }
+    for( int i = 0; i < NUM_IMAGES; i++ ) unlink( names[ i ] );
+
+    fprintf( stderr, "test_bufpool: %lu reloads in %ds, %.1fMB cached, "
+             "%u misses in all, resident %.1fMB to %.1fMB\n", reloads, seconds,
+             bufpool_get_cached() / (1024.0 * 1024.0), bufpool_get_misses(),
+             warm_rss / (1024.0 * 1024.0), end_rss / (1024.0 * 1024.0) );
+    bufpool_flush();
+    if( bufpool_get_cached() ) failed = 1;
+    fprintf( stderr, "test_bufpool: %s\n", failed ? "FAILED" : "ok" );
+    return failed;
+}
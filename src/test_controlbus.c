@@ -0,0 +1,117 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "mapping.h"
+#include "controlbus.h"
+
+/**
+ * Races several setters on one slot against a thread swapping its
+ * mapping, as the MIDI, audio and OSC threads do while an operator
+ * loads a new mapping file.  Once everyone stops, the slot's value must
+ * be its raw value through its mapping, whichever thread got there
+ * last.
+ */
+
+#define SETTERS 4
+#define SETS 20000
+#define ROUNDS 50
+
+typedef struct race_s
+{
+    controlbus_t *bus;
+    const mapping_t *mappings[ 2 ];
+    uint32_t seed;
+} race_t;
+
+static void *setter( void *arg )
+{
+    race_t *race = arg;
+    uint32_t seed = race->seed;
+
+    for( int i = 0; i < SETS; i++ ) {
+        seed = (seed * 1103515245) + 12345;
+        controlbus_set( race->bus, 0, (seed >> 8) & MAPPING_MAX );
+    }
+    return 0;
+}
+
+static void *swapper( void *arg )
+{
+    race_t *race = arg;
+
+    for( int i = 0; i < SETS / 10; i++ ) {
+        controlbus_set_mapping( race->bus, 0, race->mappings[ i & 1 ] );
+    }
+    return 0;
+}
+
+int main( int argc, char **argv )
+{
+    mapping_t *invert = mapping_new( "invert curve=exp" );
+    mapping_t *steps = mapping_new( "steps=8" );
+    int failed = 0;
+
+    if( !invert || !steps ) return 1;
+
+    for( int round = 0; round < ROUNDS && !failed; round++ ) {
+        controlbus_t *bus = controlbus_new();
+        pthread_t threads[ SETTERS + 1 ];
+        race_t races[ SETTERS ];
+
+        if( !bus || controlbus_add( bus, "knob", 0, 0 ) < 0 ) return 1;
+        for( int i = 0; i < SETTERS; i++ ) {
+            races[ i ].bus = bus;
+            races[ i ].mappings[ 0 ] = invert;
+            races[ i ].mappings[ 1 ] = steps;
+            races[ i ].seed = (round * SETTERS) + i + 1;
+            pthread_create( &threads[ i ], 0, setter, &races[ i ] );
+        }
+        pthread_create( &threads[ SETTERS ], 0, swapper, &races[ 0 ] );
+        for( int i = 0; i <= SETTERS; i++ ) {
+            pthread_join( threads[ i ], 0 );
+        }
+
+        /* The swapper finishes on the steps mapping. */
+        int raw = controlbus_get_raw( bus, 0 );
+        int value = controlbus_get( bus, 0 );
+        if( value != mapping_apply( steps, raw ) ) {
+            fprintf( stderr, "test_controlbus: round %d left value %d for raw "
+                     "%d, expected %d\n", round, value, raw,
+                     mapping_apply( steps, raw ) );
+            failed = 1;
+        }
+        controlbus_delete( bus );
+    }
+
+    mapping_delete( steps );
+    mapping_delete( invert );
+    fprintf( stderr, "test_controlbus: %s\n", failed ? "FAILED" : "ok" );
+    return failed;
+}
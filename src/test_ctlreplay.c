@@ -0,0 +1,164 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "controlbus.h"
+#include "ctlrecord.h"
+#include "ctlreplay.h"
+#include "testimage.h"
+
+/**
+ * Records a burst of control changes with ctlrecord, then replays the
+ * log into fresh buses: stepped twice, which must apply exactly the
+ * same changes at every step, and once on the replay thread.  Every
+ * replay has to finish with the bus as the recording left it.
+ */
+
+#define SLOTS 3
+#define CHANGES 60
+#define STEP_MS 5
+#define MAX_STEPS 1000
+
+static const char *names[ SLOTS ] = { "ch0.x_offset", "ch0.y_offset",
+                                      "ch1.rate" };
+
+static controlbus_t *new_bus( int raw )
+{
+    controlbus_t *bus = controlbus_new();
+    if( !bus ) return 0;
+    for( int i = 0; i < SLOTS; i++ ) {
+        if( controlbus_add( bus, names[ i ], raw, 0 ) < 0 ) return 0;
+    }
+    return bus;
+}
+
+static int same_values( controlbus_t *a, controlbus_t *b )
+{
+    for( int i = 0; i < SLOTS; i++ ) {
+        if( controlbus_get_raw( a, i ) != controlbus_get_raw( b, i ) ) return 0;
+    }
+    return 1;
+}
+
+/**
+ * Steps a replay to the end, keeping every slot's value after each
+ * step.  Returns the number of changes applied, or -1 on error.
+ */
+static int replay_stepped( const char *log, int *history, int *steps )
+{
+    controlbus_t *bus = new_bus( 0 );
+    ctlreplay_t *replay = bus ? ctlreplay_new( log, bus ) : 0;
+    int applied = 0;
+
+    if( !replay ) return -1;
+    for( *steps = 0; !ctlreplay_is_done( replay ) && *steps < MAX_STEPS;
+         (*steps)++ ) {
+        applied += ctlreplay_step( replay, STEP_MS );
+        for( int i = 0; i < SLOTS; i++ ) {
+            history[ (*steps * SLOTS) + i ] = controlbus_get_raw( bus, i );
+        }
+    }
+    ctlreplay_delete( replay );
+    controlbus_delete( bus );
+    return applied;
+}
+
+int main( int argc, char **argv )
+{
+    static int first[ MAX_STEPS * SLOTS ];
+    static int second[ MAX_STEPS * SLOTS ];
+    char log[ 256 ];
+    uint32_t seed = 7;
+    int failed = 0;
+
+    testimage_name( log, sizeof( log ), "test.vcc" );
+
+    controlbus_t *live = new_bus( 1000 );
+    ctlrecord_t *record = live ? ctlrecord_new( log, live ) : 0;
+    if( !record ) return 1;
+    for( int i = 0; i < CHANGES; i++ ) {
+        struct timespec ts = { 0, 2000000L };
+        seed = (seed * 1103515245) + 12345;
+        controlbus_set( live, i % SLOTS, (seed >> 8) % 16384 );
+        nanosleep( &ts, 0 );
+    }
+    unsigned int events = ctlrecord_get_events( record );
+    if( ctlrecord_get_dropped( record ) ) {
+        fprintf( stderr, "test_ctlreplay: recording dropped changes\n" );
+        failed = 1;
+    }
+    ctlrecord_delete( record );
+
+    int first_steps, second_steps;
+    int applied = replay_stepped( log, first, &first_steps );
+    if( replay_stepped( log, second, &second_steps ) != applied ||
+        second_steps != first_steps ||
+        memcmp( first, second, first_steps * SLOTS * sizeof( int ) ) ) {
+        fprintf( stderr, "test_ctlreplay: two stepped replays differ\n" );
+        failed = 1;
+    }
+    if( applied < 0 || (unsigned int) applied < events ||
+        first_steps == MAX_STEPS ) {
+        fprintf( stderr, "test_ctlreplay: stepped replay applied %d of %u "
+                 "changes in %d steps\n", applied, events, first_steps );
+        failed = 1;
+    }
+    for( int i = 0; first_steps && i < SLOTS; i++ ) {
+        if( first[ ((first_steps - 1) * SLOTS) + i ] !=
+            controlbus_get_raw( live, i ) ) {
+            fprintf( stderr, "test_ctlreplay: stepped replay left %s at %d, "
+                     "not %d\n", names[ i ],
+                     first[ ((first_steps - 1) * SLOTS) + i ],
+                     controlbus_get_raw( live, i ) );
+            failed = 1;
+        }
+    }
+
+    controlbus_t *bus = new_bus( 0 );
+    ctlreplay_t *replay = bus ? ctlreplay_new( log, bus ) : 0;
+    if( !replay ) return 1;
+    ctlreplay_start( replay, 4.0 );
+    for( int i = 0; i < 500 && !ctlreplay_is_done( replay ); i++ ) {
+        struct timespec ts = { 0, 10000000L };
+        nanosleep( &ts, 0 );
+    }
+    if( !ctlreplay_is_done( replay ) || !same_values( bus, live ) ) {
+        fprintf( stderr, "test_ctlreplay: threaded replay did not match\n" );
+        failed = 1;
+    }
+    ctlreplay_delete( replay );
+    controlbus_delete( bus );
+
+    controlbus_delete( live );
+    unlink( log );
+    fprintf( stderr, "test_ctlreplay: %s\n", failed ? "FAILED" : "ok" );
+    return failed;
+}
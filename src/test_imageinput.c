@@ -0,0 +1,138 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "imageinput.h"
+#include "testimage.h"
+
+/**
+ * Loads QOI and TGA images, RGB and RGBA, and checks the pixels, then
+ * loads every truncated length of a small file.  Those are what the
+ * loader sees when it catches a save half way through, and they must
+ * be rejected, never crash.
+ */
+
+#define WIDTH 29
+#define HEIGHT 19
+
+static int write_image( const char *name, int qoi, const uint8_t *pixels,
+                        int channels )
+{
+    if( qoi ) {
+        return testimage_write_qoi( name, pixels, WIDTH, HEIGHT, channels );
+    }
+    return testimage_write_tga( name, pixels, WIDTH, HEIGHT, channels );
+}
+
+static int check_decode( const char *name, int qoi, int channels )
+{
+    uint8_t *pixels = testimage_pixels( WIDTH, HEIGHT, channels );
+    const char *format = qoi ? "QOI" : "TGA";
+    int ok = 1;
+
+    if( !pixels || !write_image( name, qoi, pixels, channels ) ) {
+        free( pixels );
+        return 0;
+    }
+
+    imageinput_t *image = imageinput_new( name );
+    if( !image || strcmp( imageinput_get_format( image ), format ) ||
+        imageinput_get_width( image ) != WIDTH ||
+        imageinput_get_height( image ) != HEIGHT ||
+        imageinput_has_alpha( image ) != (channels == 4) ) {
+        fprintf( stderr, "test_imageinput: %d channel %s did not load\n",
+                 channels, format );
+        ok = 0;
+    }
+    for( int y = 0; ok && y < HEIGHT; y++ ) {
+        if( memcmp( imageinput_get_scanline( image, y ),
+                    pixels + (y * WIDTH * channels), WIDTH * channels ) ) {
+            fprintf( stderr, "test_imageinput: %d channel %s differs on "
+                     "row %d\n", channels, format, y );
+            ok = 0;
+        }
+    }
+
+    if( image ) imageinput_delete( image );
+    free( pixels );
+    return ok;
+}
+
+int main( int argc, char **argv )
+{
+    char name[ 256 ];
+    int failed = 0;
+
+    testimage_name( name, sizeof( name ), "test.img" );
+
+    for( int qoi = 0; qoi < 2; qoi++ ) {
+        for( int channels = 3; channels <= 4; channels++ ) {
+            if( !check_decode( name, qoi, channels ) ) failed = 1;
+        }
+    }
+
+    /* The loader complains about every bad file, so keep it quiet. */
+    int saved = dup( 2 );
+    int devnull = open( "/dev/null", O_WRONLY );
+    dup2( devnull, 2 );
+    close( devnull );
+
+    for( int qoi = 0; qoi < 2; qoi++ ) {
+        uint8_t *pixels = testimage_pixels( WIDTH, HEIGHT, 4 );
+        size_t size;
+        uint8_t *good;
+
+        if( !pixels || !write_image( name, qoi, pixels, 4 ) ||
+            !(good = testimage_read( name, &size )) ) {
+            return 1;
+        }
+        /* QOI's end marker is padding, so the image is whole without it. */
+        size_t whole = qoi ? size - 8 : size;
+        for( size_t len = 0; len < whole; len++ ) {
+            if( !testimage_write( name, good, len ) ) return 1;
+            imageinput_t *image = imageinput_new( name );
+            if( image ) {
+                dprintf( saved, "test_imageinput: %s truncated to %zu bytes "
+                         "was accepted\n", qoi ? "QOI" : "TGA", len );
+                imageinput_delete( image );
+                failed = 1;
+            }
+        }
+        free( good );
+        free( pixels );
+    }
+    dup2( saved, 2 );
+    close( saved );
+
+    unlink( name );
+    fprintf( stderr, "test_imageinput: %s\n", failed ? "FAILED" : "ok" );
+    return failed;
+}
@@ -0,0 +1,179 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "mapping.h"
+#include "controlbus.h"
+#include "oscinput.h"
+
+/**
+ * Sends OSC over loopback to an oscinput, the way a tablet controller
+ * would: floats, ints and booleans, a bound address, a bundle holding
+ * two values for one slot, and some datagrams that must be counted as
+ * errors.  Then checks what reached the bus.
+ */
+
+#define BASE_PORT 19000
+
+typedef struct packet_s
+{
+    uint8_t data[ 256 ];
+    size_t len;
+} packet_t;
+
+static void put_string( packet_t *packet, const char *s )
+{
+    size_t len = strlen( s ) + 1;
+    memcpy( packet->data + packet->len, s, len );
+    packet->len += len;
+    while( packet->len & 3 ) packet->data[ packet->len++ ] = 0;
+}
+
+static void put32( packet_t *packet, uint32_t value )
+{
+    for( int shift = 24; shift >= 0; shift -= 8 ) {
+        packet->data[ packet->len++ ] = value >> shift;
+    }
+}
+
+static packet_t message( const char *address, const char *tags, uint32_t arg )
+{
+    packet_t packet;
+    packet.len = 0;
+    put_string( &packet, address );
+    put_string( &packet, tags );
+    if( !strcmp( tags, ",f" ) || !strcmp( tags, ",i" ) ) put32( &packet, arg );
+    return packet;
+}
+
+static uint32_t float_bits( float f )
+{
+    union { float f; uint32_t i; } u = { f };
+    return u.i;
+}
+
+static void bundle_add( packet_t *bundle, const packet_t *packet )
+{
+    put32( bundle, packet->len );
+    memcpy( bundle->data + bundle->len, packet->data, packet->len );
+    bundle->len += packet->len;
+}
+
+int main( int argc, char **argv )
+{
+    controlbus_t *bus = controlbus_new();
+    oscinput_t *osc = 0;
+    struct sockaddr_in addr;
+    int failed = 0;
+    int port;
+
+    if( !bus ) return 1;
+    int x = controlbus_add( bus, "ch0.x_offset", 0, 0 );
+    int y = controlbus_add( bus, "ch0.y_offset", 0, 0 );
+    int rate = controlbus_add( bus, "ch1.rate", 0, 0 );
+    int enable = controlbus_add( bus, "ch2.enable", 0, 0 );
+
+    /* Another test run may hold a port, so try a few. */
+    for( int i = 0; !osc && i < 100; i++ ) {
+        port = BASE_PORT + ((getpid() + (i * 7)) % 2000);
+        osc = oscinput_new( port, bus );
+    }
+    if( !osc ) return 1;
+    oscinput_set_control( osc, "/1/fader1", rate );
+    oscinput_start( osc );
+
+    int fd = socket( AF_INET, SOCK_DGRAM, 0 );
+    if( fd < 0 ) return 1;
+    memset( &addr, 0, sizeof( addr ) );
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    addr.sin_port = htons( port );
+
+    packet_t packets[ 6 ];
+    packets[ 0 ] = message( "/ch0/x_offset", ",f", float_bits( 0.5f ) );
+    packets[ 1 ] = message( "/1/fader1", ",i", 1000 );
+    packets[ 2 ] = message( "/ch2/enable", ",T", 0 );
+
+    /* Both values arrive at once, so the later one wins. */
+    packet_t first = message( "/ch0/y_offset", ",i", 5 );
+    packet_t second = message( "/ch0/y_offset", ",i", 7 );
+    packets[ 3 ].len = 0;
+    put_string( &packets[ 3 ], "#bundle" );
+    put32( &packets[ 3 ], 0 );
+    put32( &packets[ 3 ], 1 );
+    bundle_add( &packets[ 3 ], &first );
+    bundle_add( &packets[ 3 ], &second );
+
+    /* An address nobody has, and a datagram that is not OSC at all. */
+    packets[ 4 ] = message( "/ch9/nothing", ",f", float_bits( 1.0f ) );
+    memcpy( packets[ 5 ].data, "hey", 3 );
+    packets[ 5 ].len = 3;
+
+    for( int i = 0; i < 6; i++ ) {
+        sendto( fd, packets[ i ].data, packets[ i ].len, 0,
+                (struct sockaddr *) &addr, sizeof( addr ) );
+    }
+
+    for( int i = 0; i < 200; i++ ) {
+        struct timespec ts = { 0, 10000000L };
+        if( oscinput_get_messages( osc ) + oscinput_get_errors( osc ) >= 7 ) {
+            break;
+        }
+        nanosleep( &ts, 0 );
+    }
+
+    if( oscinput_get_messages( osc ) != 5 || oscinput_get_errors( osc ) != 2 ) {
+        fprintf( stderr, "test_oscinput: %u messages and %u errors, expected 5 "
+                 "and 2\n", oscinput_get_messages( osc ),
+                 oscinput_get_errors( osc ) );
+        failed = 1;
+    }
+    if( controlbus_get_raw( bus, x ) != mapping_from_unit( 0.5f ) ||
+        controlbus_get_raw( bus, y ) != 7 ||
+        controlbus_get_raw( bus, rate ) != 1000 ||
+        controlbus_get_raw( bus, enable ) != MAPPING_MAX ) {
+        fprintf( stderr, "test_oscinput: bus holds %d %d %d %d\n",
+                 controlbus_get_raw( bus, x ), controlbus_get_raw( bus, y ),
+                 controlbus_get_raw( bus, rate ),
+                 controlbus_get_raw( bus, enable ) );
+        failed = 1;
+    }
+
+    close( fd );
+    oscinput_delete( osc );
+    controlbus_delete( bus );
+    fprintf( stderr, "test_oscinput: %s\n", failed ? "FAILED" : "ok" );
+    return failed;
+}
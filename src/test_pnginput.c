@@ -0,0 +1,279 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <zlib.h>
+#include "pnginput.h"
+#include "testimage.h"
+
+/**
+ * Decodes PNGs of every colour type and checks the pixels that come
+ * out, then feeds the loader truncated and corrupted files, as it sees
+ * when it catches an artist's save half way through.  Those must be
+ * rejected or decoded, never crash.  Corrupted files get their chunk
+ * CRCs fixed up, so the damage reaches inflate and the row filters
+ * rather than stopping at the first CRC check.  Last, a writer thread
+ * keeps saving the file in small pieces while the loader reads it.
+ */
+
+#define WIDTH 61
+#define HEIGHT 37
+#define FUZZ_RUNS 1000
+#define WRITE_CHUNK 256
+
+static uint32_t seed = 1;
+
+static uint32_t test_random( void )
+{
+    seed = (seed * 1103515245) + 12345;
+    return seed >> 8;
+}
+
+static uint32_t read_be32( const uint8_t *p )
+{
+    return ((uint32_t) p[ 0 ] << 24) | (p[ 1 ] << 16) | (p[ 2 ] << 8) | p[ 3 ];
+}
+
+static void fix_crcs( uint8_t *data, size_t size )
+{
+    size_t pos = 8;
+
+    while( pos + 12 <= size ) {
+        uint32_t len = read_be32( data + pos );
+        if( len > size - pos - 12 ) break;
+        uint32_t crc = crc32( 0, data + pos + 4, len + 4 );
+        data[ pos + 8 + len ] = crc >> 24;
+        data[ pos + 9 + len ] = crc >> 16;
+        data[ pos + 10 + len ] = crc >> 8;
+        data[ pos + 11 + len ] = crc;
+        pos += len + 12;
+    }
+}
+
+typedef struct writer_s
+{
+    const char *name;
+    const uint8_t *good;
+    size_t size;
+    int runs;
+    volatile int done;
+} writer_t;
+
+/**
+ * Saves the file over and over the way an editor does, truncating it
+ * and writing it back a piece at a time, every other save stopping
+ * short as if the editor had been killed.
+ */
+static void *writer_thread( void *arg )
+{
+    writer_t *writer = arg;
+
+    for( int run = 0; run < writer->runs; run++ ) {
+        size_t len = (run & 1) ? test_random() % writer->size : writer->size;
+        int fd = open( writer->name, O_WRONLY | O_TRUNC );
+        if( fd < 0 ) break;
+        for( size_t pos = 0; pos < len; pos += WRITE_CHUNK ) {
+            size_t chunk = (len - pos < WRITE_CHUNK) ? len - pos : WRITE_CHUNK;
+            if( write( fd, writer->good + pos, chunk ) != (ssize_t) chunk ) {
+                break;
+            }
+        }
+        close( fd );
+    }
+    __atomic_store_n( &writer->done, 1, __ATOMIC_RELEASE );
+    return 0;
+}
+
+static int check_pixels( pnginput_t *png )
+{
+    /* Whatever did decode must be safe to read all of. */
+    volatile unsigned int sum = 0;
+    int out = pnginput_has_alpha( png ) ? 4 : 3;
+    for( unsigned int y = 0; y < pnginput_get_height( png ); y++ ) {
+        const uint8_t *row = pnginput_get_scanline( png, y );
+        for( unsigned int x = 0; x < pnginput_get_width( png ) * out; x++ ) {
+            sum += row[ x ];
+        }
+    }
+    return pnginput_get_width( png ) == WIDTH &&
+           pnginput_get_height( png ) == HEIGHT;
+}
+
+static int check_decode( const char *name, int channels, int keyed )
+{
+    uint8_t *pixels = testimage_pixels( WIDTH, HEIGHT, channels );
+    int alpha = (channels == 2 || channels == 4 || keyed);
+    int out = alpha ? 4 : 3;
+    int ok;
+
+    if( !pixels ) return 0;
+    if( keyed ) {
+        /* The first pixel's colour is the key, so some pixels match it. */
+        ok = testimage_write_png_key( name, pixels, WIDTH, HEIGHT, channels,
+                                      pixels );
+    } else {
+        ok = testimage_write_png( name, pixels, WIDTH, HEIGHT, channels );
+    }
+    if( !ok ) {
+        free( pixels );
+        return 0;
+    }
+
+    pnginput_t *png = pnginput_new( name );
+    if( !png ) {
+        fprintf( stderr, "test_pnginput: %d channel PNG did not load\n", channels );
+        free( pixels );
+        return 0;
+    }
+    if( pnginput_get_width( png ) != WIDTH || pnginput_get_height( png ) != HEIGHT ||
+        pnginput_has_alpha( png ) != alpha ) {
+        fprintf( stderr, "test_pnginput: %d channel PNG has the wrong shape\n",
+                 channels );
+        pnginput_delete( png );
+        free( pixels );
+        return 0;
+    }
+
+    for( int y = 0; y < HEIGHT; y++ ) {
+        const uint8_t *row = pnginput_get_scanline( png, y );
+        for( int x = 0; x < WIDTH; x++ ) {
+            const uint8_t *src = pixels + (((y * WIDTH) + x) * channels);
+            uint8_t want[ 4 ];
+            if( channels <= 2 ) {
+                want[ 0 ] = want[ 1 ] = want[ 2 ] = src[ 0 ];
+                if( channels == 2 ) want[ 3 ] = src[ 1 ];
+            } else {
+                memcpy( want, src, channels );
+            }
+            if( keyed ) {
+                want[ 3 ] = memcmp( src, pixels, channels ) ? 255 : 0;
+            }
+            if( memcmp( row + (x * out), want, out ) ) {
+                fprintf( stderr, "test_pnginput: %d channel PNG differs at "
+                         "%d,%d\n", channels, x, y );
+                pnginput_delete( png );
+                free( pixels );
+                return 0;
+            }
+        }
+    }
+
+    pnginput_delete( png );
+    free( pixels );
+    return 1;
+}
+
+int main( int argc, char **argv )
+{
+    char name[ 256 ];
+    int runs = (argc > 1) ? atoi( argv[ 1 ] ) : FUZZ_RUNS;
+    int failed = 0;
+
+    testimage_name( name, sizeof( name ), "test.png" );
+
+    for( int channels = 1; channels <= 4; channels++ ) {
+        if( !check_decode( name, channels, 0 ) ) failed = 1;
+    }
+    if( !check_decode( name, 1, 1 ) || !check_decode( name, 3, 1 ) ) failed = 1;
+
+    size_t size;
+    uint8_t *good = testimage_read( name, &size );
+    uint8_t *bad = malloc( size );
+    if( !good || !bad ) return 1;
+
+    /* The loader complains about every bad file, so keep it quiet. */
+    int saved = dup( 2 );
+    int devnull = open( "/dev/null", O_WRONLY );
+    dup2( devnull, 2 );
+    close( devnull );
+
+    int rejected = 0;
+    for( int run = 0; run < runs; run++ ) {
+        size_t len = size;
+        memcpy( bad, good, size );
+        if( run & 1 ) {
+            len = test_random() % size;
+        } else {
+            int flips = 1 + (test_random() % 8);
+            for( int i = 0; i < flips; i++ ) {
+                bad[ 8 + (test_random() % (size - 8)) ] ^= 1 << (test_random() % 8);
+            }
+            fix_crcs( bad, size );
+        }
+        if( !testimage_write( name, bad, len ) ) return 1;
+
+        pnginput_t *png = pnginput_new( name );
+        if( !png ) {
+            rejected++;
+            continue;
+        }
+        check_pixels( png );
+        pnginput_delete( png );
+    }
+
+    /**
+     * The writer only ever leaves some prefix of the good file behind,
+     * so anything that decodes must have its shape.
+     */
+    if( !testimage_write( name, good, size ) ) return 1;
+    writer_t writer = { name, good, size, runs, 0 };
+    pthread_t thread;
+    int loads = 0;
+    int decoded = 0;
+    pthread_create( &thread, 0, writer_thread, &writer );
+    while( !__atomic_load_n( &writer.done, __ATOMIC_ACQUIRE ) ) {
+        pnginput_t *png = pnginput_new( name );
+        loads++;
+        if( !png ) continue;
+        if( check_pixels( png ) ) {
+            decoded++;
+        } else {
+            failed = 1;
+        }
+        pnginput_delete( png );
+    }
+    pthread_join( thread, 0 );
+
+    dup2( saved, 2 );
+    close( saved );
+
+    fprintf( stderr, "test_pnginput: %d damaged files, %d rejected, %d decoded\n",
+             runs, rejected, runs - rejected );
+    fprintf( stderr, "test_pnginput: %d saves, %d loads during them, "
+             "%d decoded\n", runs, loads, decoded );
+
+    unlink( name );
+    free( bad );
+    free( good );
+    fprintf( stderr, "test_pnginput: %s\n", failed ? "FAILED" : "ok" );
+    return failed;
+}
@@ -0,0 +1,183 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "shmin.h"
+
+/**
+ * Runs shmfeed as the producer and attaches several shmin readers to
+ * it, each copying out every frame it can.  A frame the producer
+ * overwrote while it was being copied must be caught by shmin_check(),
+ * so every frame a reader keeps has to match shmfeed's pattern all the
+ * way through.  Reports each reader's throughput.
+ */
+
+#define READERS 4
+#define SECONDS 2
+
+typedef struct reader_s
+{
+    const char *name;
+    pthread_t thread_handle;
+    uint64_t frames;
+    uint64_t torn;
+    uint64_t corrupt;
+    uint64_t bytes;
+} reader_t;
+
+static double now_ms( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (ts.tv_sec * 1000.0) + (ts.tv_nsec / 1000000.0);
+}
+
+static int reader_verify( const uint8_t *copy, int width, int height,
+                          uint64_t frame )
+{
+    for( int y = 0; y < height; y++ ) {
+        const uint32_t *row = (const uint32_t *)
+                              (copy + ((size_t) y * width * 4));
+        uint32_t word = ((uint32_t) frame << 16) | (y & 0xffff);
+        for( int x = 0; x < width; x++ ) {
+            if( row[ x ] != word ) return 0;
+        }
+    }
+    return 1;
+}
+
+static void *reader_thread( void *arg )
+{
+    reader_t *reader = arg;
+    shmin_t *shmin = shmin_new( reader->name );
+    if( !shmin ) return NULL;
+
+    int width = shmin_get_width( shmin );
+    int height = shmin_get_height( shmin );
+    uint8_t *copy = malloc( (size_t) width * height * 4 );
+    if( !copy ) {
+        shmin_delete( shmin );
+        return NULL;
+    }
+
+    double end = now_ms() + (SECONDS * 1000.0);
+    uint64_t last = shmin_get_latest( shmin );
+    while( now_ms() < end ) {
+        uint64_t frame = shmin_wait( shmin, last, 100 );
+        if( frame == last ) continue;
+        last = frame;
+
+        const uint8_t *pixels = shmin_get_pixels( shmin, frame );
+        if( pixels ) {
+            for( int y = 0; y < height; y++ ) {
+                memcpy( copy + ((size_t) y * width * 4),
+                        pixels + ((size_t) y * shmin_get_stride( shmin )),
+                        width * 4 );
+            }
+        }
+        if( !pixels || !shmin_check( shmin, frame ) ) {
+            reader->torn++;
+        } else if( !reader_verify( copy, width, height, frame ) ) {
+            reader->corrupt++;
+        } else {
+            reader->frames++;
+            reader->bytes += (uint64_t) width * height * 4;
+        }
+    }
+
+    free( copy );
+    shmin_delete( shmin );
+    return NULL;
+}
+
+int main( int argc, char **argv )
+{
+    reader_t readers[ READERS ];
+    char name[ 64 ];
+    char seconds[ 16 ];
+    shmin_t *shmin = 0;
+    int failed = 0;
+    int status;
+
+    snprintf( name, sizeof( name ), "/vcontrol-test-%d", (int) getpid() );
+    snprintf( seconds, sizeof( seconds ), "%d", SECONDS + 2 );
+
+    pid_t feed = fork();
+    if( feed < 0 ) return 1;
+    if( !feed ) {
+        execl( "./shmfeed", "shmfeed", "-r", "0", "-s", seconds, name,
+               (char *) 0 );
+        perror( "test_shm: Cannot run ./shmfeed" );
+        _exit( 1 );
+    }
+
+    /* Wait for the producer to publish its first frame. */
+    for( int i = 0; i < 100; i++ ) {
+        struct timespec ts = { 0, 20000000L };
+        if( !shmin ) shmin = shmin_new( name );
+        if( shmin && shmin_get_latest( shmin ) ) break;
+        nanosleep( &ts, 0 );
+    }
+    if( !shmin || !shmin_get_latest( shmin ) ) {
+        fprintf( stderr, "test_shm: shmfeed did not start\n" );
+        kill( feed, SIGTERM );
+        waitpid( feed, &status, 0 );
+        if( shmin ) shmin_delete( shmin );
+        return 1;
+    }
+    shmin_delete( shmin );
+
+    memset( readers, 0, sizeof( readers ) );
+    for( int i = 0; i < READERS; i++ ) {
+        readers[ i ].name = name;
+        pthread_create( &readers[ i ].thread_handle, NULL, reader_thread,
+                        &readers[ i ] );
+    }
+    for( int i = 0; i < READERS; i++ ) {
+        pthread_join( readers[ i ].thread_handle, NULL );
+        fprintf( stderr, "test_shm: reader %d: %.1f fps, %.1f MB/s, %llu torn, "
+                 "%llu corrupt\n", i, readers[ i ].frames / (double) SECONDS,
+                 readers[ i ].bytes / (SECONDS * 1024.0 * 1024.0),
+                 (unsigned long long) readers[ i ].torn,
+                 (unsigned long long) readers[ i ].corrupt );
+        if( !readers[ i ].frames || readers[ i ].corrupt ) failed = 1;
+    }
+
+    waitpid( feed, &status, 0 );
+    if( !WIFEXITED( status ) || WEXITSTATUS( status ) ) failed = 1;
+
+    fprintf( stderr, "test_shm: %s\n", failed ? "FAILED" : "ok" );
+    return failed;
+}
@@ -0,0 +1,198 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "controlbus.h"
+#include "wall.h"
+
+/**
+ * Runs a video wall on loopback: this process leads, and forked
+ * followers draw alongside it, each taking a little longer than the
+ * last.  The leader changes a control every frame, and every tile
+ * notes the control's value and the frame time it was given.  For each
+ * frame a follower drew, both must match the leader exactly, and the
+ * leader must have waited for every follower to be ready.
+ */
+
+#define FOLLOWERS 2
+#define FRAMES 200
+#define SLOTS 8
+#define BASE_PORT 19500
+
+/* Slot 0 tells the followers to stop, slot 1 counts frames. */
+#define SLOT_STOP 0
+#define SLOT_COUNT 1
+
+typedef struct record_s
+{
+    int32_t value;
+    double seconds;
+} record_t;
+
+static controlbus_t *new_bus( void )
+{
+    controlbus_t *bus = controlbus_new();
+    char name[ 32 ];
+
+    if( !bus ) return 0;
+    for( int i = 0; i < SLOTS; i++ ) {
+        snprintf( name, sizeof( name ), "slot%d", i );
+        if( controlbus_add( bus, name, 0, 0 ) < 0 ) return 0;
+    }
+    return bus;
+}
+
+static void sleep_ms( int ms )
+{
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    nanosleep( &ts, 0 );
+}
+
+/**
+ * Draws frames until the leader says stop, or goes quiet, and writes
+ * what it was given down the pipe.
+ */
+static int follow( int port, int index, int fd )
+{
+    controlbus_t *bus = new_bus();
+    wall_t *wall = bus ? wall_new_follower( "127.0.0.1", port, bus ) : 0;
+    int quiet = 0;
+
+    if( !wall ) return 1;
+    while( quiet < 50 ) {
+        double seconds;
+        if( !wall_begin_frame( wall, &seconds, 100 ) ) {
+            quiet++;
+            continue;
+        }
+        quiet = 0;
+        if( controlbus_get( bus, SLOT_STOP ) ) break;
+
+        record_t record = { controlbus_get( bus, SLOT_COUNT ), seconds };
+        if( write( fd, &record, sizeof( record ) ) != sizeof( record ) ) break;
+        sleep_ms( 1 + index );
+        wall_end_frame( wall );
+    }
+    wall_delete( wall );
+    controlbus_delete( bus );
+    return 0;
+}
+
+int main( int argc, char **argv )
+{
+    static record_t led[ FRAMES ];
+    pid_t pids[ FOLLOWERS ];
+    int fds[ FOLLOWERS ];
+    int port = BASE_PORT + (getpid() % 400);
+    int failed = 0;
+
+    for( int i = 0; i < FOLLOWERS; i++ ) {
+        int pipefd[ 2 ];
+        if( pipe( pipefd ) < 0 ) return 1;
+        pids[ i ] = fork();
+        if( pids[ i ] < 0 ) return 1;
+        if( !pids[ i ] ) {
+            close( pipefd[ 0 ] );
+            _exit( follow( port, i, pipefd[ 1 ] ) );
+        }
+        close( pipefd[ 1 ] );
+        fds[ i ] = pipefd[ 0 ];
+    }
+
+    controlbus_t *bus = new_bus();
+    wall_t *wall = bus ? wall_new_leader( port, bus ) : 0;
+    if( !wall ) return 1;
+
+    /* Run frames until every follower has said hello. */
+    for( int i = 0; i < 200 && wall_get_followers( wall ) < FOLLOWERS; i++ ) {
+        double seconds;
+        wall_begin_frame( wall, &seconds, 0 );
+        sleep_ms( 5 );
+        wall_end_frame( wall );
+    }
+    if( wall_get_followers( wall ) < FOLLOWERS ) {
+        fprintf( stderr, "test_wall: only %d followers joined\n",
+                 wall_get_followers( wall ) );
+        failed = 1;
+    }
+
+    unsigned int late = wall_get_late( wall );
+    for( int frame = 0; frame < FRAMES; frame++ ) {
+        controlbus_set( bus, SLOT_COUNT, frame + 1 );
+        wall_begin_frame( wall, &led[ frame ].seconds, 0 );
+        led[ frame ].value = controlbus_get( bus, SLOT_COUNT );
+        sleep_ms( 1 );
+        wall_end_frame( wall );
+    }
+    late = wall_get_late( wall ) - late;
+
+    /* Say stop for a while, in case a follower misses a frame. */
+    controlbus_set( bus, SLOT_STOP, 1 );
+    for( int i = 0; i < 10; i++ ) {
+        double seconds;
+        wall_begin_frame( wall, &seconds, 0 );
+        wall_end_frame( wall );
+    }
+
+    for( int i = 0; i < FOLLOWERS; i++ ) {
+        record_t record;
+        int drawn = 0;
+        int wrong = 0;
+        int status;
+
+        while( read( fds[ i ], &record, sizeof( record ) ) == sizeof( record ) ) {
+            if( record.value < 1 || record.value > FRAMES ) continue;
+            drawn++;
+            if( led[ record.value - 1 ].value != record.value ||
+                led[ record.value - 1 ].seconds != record.seconds ) {
+                wrong++;
+            }
+        }
+        close( fds[ i ] );
+        waitpid( pids[ i ], &status, 0 );
+
+        fprintf( stderr, "test_wall: follower %d drew %d of %d frames, %d out "
+                 "of sync\n", i, drawn, FRAMES, wrong );
+        if( wrong || drawn < FRAMES - 2 || !WIFEXITED( status ) ||
+            WEXITSTATUS( status ) ) {
+            failed = 1;
+        }
+    }
+    fprintf( stderr, "test_wall: %u of %d frames were late\n", late, FRAMES );
+    if( late > FRAMES / 20 ) failed = 1;
+
+    wall_delete( wall );
+    controlbus_delete( bus );
+    fprintf( stderr, "test_wall: %s\n", failed ? "FAILED" : "ok" );
+    return failed;
+}
@@ -0,0 +1,121 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include "y4minput.h"
+#include "testimage.h"
+
+/**
+ * Checks which colourspaces are let in, and that a file truncated while
+ * it is open gives missing frames rather than a crash, as when a clip
+ * is re-exported over the one playing.
+ */
+
+#define WIDTH 33
+#define HEIGHT 17
+#define FRAMES 6
+
+static int write_y4m( const char *name, const char *colourspace )
+{
+    int chroma = ((WIDTH + 1) / 2) * ((HEIGHT + 1) / 2);
+    size_t size = (WIDTH * HEIGHT) + (2 * chroma);
+    uint8_t *planes = malloc( size );
+    FILE *f = fopen( name, "wb" );
+    int ok = planes && f;
+
+    if( ok ) {
+        fprintf( f, "YUV4MPEG2 W%d H%d F30:1 Ip A1:1 %s\n", WIDTH, HEIGHT,
+                 colourspace );
+        for( int i = 0; i < FRAMES; i++ ) {
+            memset( planes, i, size );
+            fprintf( f, "FRAME\n" );
+            if( fwrite( planes, 1, size, f ) != size ) ok = 0;
+        }
+    }
+    if( f && fclose( f ) != 0 ) ok = 0;
+    free( planes );
+    return ok;
+}
+
+int main( int argc, char **argv )
+{
+    static const char *good[] = { "C420", "C420jpeg", "C420mpeg2",
+                                  "C420paldv", "" };
+    static const char *bad[] = { "C420p10", "C420p12", "C422", "C444",
+                                 "C420jpegx" };
+    char name[ 256 ];
+    int failed = 0;
+
+    testimage_name( name, sizeof( name ), "test.y4m" );
+
+    for( size_t i = 0; i < sizeof( good ) / sizeof( good[ 0 ] ); i++ ) {
+        if( !write_y4m( name, good[ i ] ) ) return 1;
+        y4minput_t *video = y4minput_new( name );
+        if( !video || y4minput_get_frames( video ) != FRAMES ) {
+            fprintf( stderr, "test_y4minput: '%s' was not accepted\n",
+                     good[ i ] );
+            failed = 1;
+        }
+        if( video ) y4minput_delete( video );
+    }
+    for( size_t i = 0; i < sizeof( bad ) / sizeof( bad[ 0 ] ); i++ ) {
+        if( !write_y4m( name, bad[ i ] ) ) return 1;
+        y4minput_t *video = y4minput_new( name );
+        if( video ) {
+            fprintf( stderr, "test_y4minput: '%s' was accepted\n", bad[ i ] );
+            y4minput_delete( video );
+            failed = 1;
+        }
+    }
+
+    if( !write_y4m( name, "C420jpeg" ) ) return 1;
+    y4minput_t *video = y4minput_new( name );
+    if( !video ) return 1;
+    uint8_t *y, *u, *v;
+    if( !y4minput_get_frame( video, FRAMES - 1, &y, &u, &v ) ||
+        y[ 0 ] != FRAMES - 1 || v[ 0 ] != FRAMES - 1 ) {
+        fprintf( stderr, "test_y4minput: last frame did not read back\n" );
+        failed = 1;
+    }
+    if( truncate( name, 100 ) < 0 ) return 1;
+    y4minput_prefetch( video, 0, FRAMES );
+    for( int i = 0; i < FRAMES; i++ ) {
+        if( y4minput_get_frame( video, i, &y, &u, &v ) ) {
+            fprintf( stderr, "test_y4minput: frame %d read from a truncated "
+                     "file\n", i );
+            failed = 1;
+        }
+    }
+    y4minput_delete( video );
+
+    unlink( name );
+    fprintf( stderr, "test_y4minput: %s\n", failed ? "FAILED" : "ok" );
+    return failed;
+}
@@ -0,0 +1,271 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <png.h>
+#include "testimage.h"
+
+uint8_t *testimage_pixels( int width, int height, int channels )
+{
+    uint8_t *pixels = malloc( (size_t) width * height * channels );
+    uint32_t seed = 12345;
+
+    if( !pixels ) return 0;
+    for( int y = 0; y < height; y++ ) {
+        uint8_t *cur = pixels + ((size_t) y * width * channels);
+        for( int x = 0; x < width; x++ ) {
+            seed = (seed * 1103515245) + 12345;
+            int noise = (seed >> 16) & 7;
+            for( int c = 0; c < channels; c++ ) {
+                int v = ((x * (c + 1) * 255) / width) + ((y * 255) / height);
+                *cur++ = (c == 3) ? (y * 255) / height : (v + noise) & 0xff;
+            }
+        }
+    }
+    return pixels;
+}
+
+void testimage_name( char *name, int size, const char *suffix )
+{
+    const char *dir = getenv( "TMPDIR" );
+    snprintf( name, size, "%s/vcontrol-test-%d-%s", dir ? dir : "/tmp",
+              (int) getpid(), suffix );
+}
+
+static int testimage_encode_png( const char *filename, const uint8_t *pixels,
+                                 int width, int height, int channels,
+                                 const uint8_t *key )
+{
+    static const int colour_types[] = { PNG_COLOR_TYPE_GRAY,
+                                        PNG_COLOR_TYPE_GRAY_ALPHA,
+                                        PNG_COLOR_TYPE_RGB,
+                                        PNG_COLOR_TYPE_RGB_ALPHA };
+    png_structp png_ptr;
+    png_infop info_ptr;
+    FILE *f;
+
+    f = fopen( filename, "wb" );
+    if( !f ) {
+        fprintf( stderr, "testimage: Cannot write %s: %s\n",
+                 filename, strerror( errno ) );
+        return 0;
+    }
+
+    png_ptr = png_create_write_struct( PNG_LIBPNG_VER_STRING, 0, 0, 0 );
+    info_ptr = png_ptr ? png_create_info_struct( png_ptr ) : 0;
+    if( !info_ptr || setjmp( png_jmpbuf( png_ptr ) ) ) {
+        fprintf( stderr, "testimage: Cannot encode %s.\n", filename );
+        png_destroy_write_struct( &png_ptr, &info_ptr );
+        fclose( f );
+        return 0;
+    }
+
+    png_init_io( png_ptr, f );
+    png_set_IHDR( png_ptr, info_ptr, width, height, 8,
+                  colour_types[ channels - 1 ], PNG_INTERLACE_NONE,
+                  PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT );
+    if( key ) {
+        png_color_16 trans;
+        memset( &trans, 0, sizeof( trans ) );
+        if( channels == 1 ) {
+            trans.gray = key[ 0 ];
+        } else {
+            trans.red = key[ 0 ];
+            trans.green = key[ 1 ];
+            trans.blue = key[ 2 ];
+        }
+        png_set_tRNS( png_ptr, info_ptr, 0, 0, &trans );
+    }
+    png_write_info( png_ptr, info_ptr );
+    for( int y = 0; y < height; y++ ) {
+        png_write_row( png_ptr, pixels + ((size_t) y * width * channels) );
+    }
+    png_write_end( png_ptr, info_ptr );
+    png_destroy_write_struct( &png_ptr, &info_ptr );
+    return fclose( f ) == 0;
+}
+
+int testimage_write_png( const char *filename, const uint8_t *pixels,
+                         int width, int height, int channels )
+{
+    return testimage_encode_png( filename, pixels, width, height, channels, 0 );
+}
+
+int testimage_write_png_key( const char *filename, const uint8_t *pixels,
+                             int width, int height, int channels,
+                             const uint8_t *key )
+{
+    return testimage_encode_png( filename, pixels, width, height, channels,
+                                 key );
+}
+
+int testimage_write_qoi( const char *filename, const uint8_t *pixels,
+                         int width, int height, int channels )
+{
+    size_t count = (size_t) width * height;
+    uint8_t *data = malloc( 14 + (count * (channels + 1)) + 8 );
+    uint8_t index[ 64 ][ 4 ];
+    uint8_t prev[ 4 ] = { 0, 0, 0, 255 };
+    size_t pos = 0;
+    int run = 0;
+    int ok;
+
+    if( !data ) return 0;
+    memset( index, 0, sizeof( index ) );
+    memcpy( data, "qoif", 4 );
+    pos = 4;
+    for( int shift = 24; shift >= 0; shift -= 8 ) {
+        data[ pos++ ] = width >> shift;
+    }
+    for( int shift = 24; shift >= 0; shift -= 8 ) {
+        data[ pos++ ] = height >> shift;
+    }
+    data[ pos++ ] = channels;
+    data[ pos++ ] = 0;
+
+    for( size_t i = 0; i < count; i++ ) {
+        const uint8_t *in = pixels + (i * channels);
+        uint8_t px[ 4 ] = { in[ 0 ], in[ 1 ], in[ 2 ], 255 };
+        if( channels == 4 ) px[ 3 ] = in[ 3 ];
+
+        if( !memcmp( px, prev, 4 ) ) {
+            run++;
+            if( run == 62 || i == count - 1 ) {
+                data[ pos++ ] = 0xc0 | (run - 1);
+                run = 0;
+            }
+            continue;
+        }
+        if( run ) {
+            data[ pos++ ] = 0xc0 | (run - 1);
+            run = 0;
+        }
+
+        int hash = ((px[ 0 ] * 3) + (px[ 1 ] * 5) + (px[ 2 ] * 7) +
+                    (px[ 3 ] * 11)) % 64;
+        if( !memcmp( index[ hash ], px, 4 ) ) {
+            data[ pos++ ] = hash;
+        } else if( px[ 3 ] != prev[ 3 ] ) {
+            data[ pos++ ] = 0xff;
+            memcpy( data + pos, px, 4 );
+            pos += 4;
+        } else {
+            int dr = (int8_t) (px[ 0 ] - prev[ 0 ]);
+            int dg = (int8_t) (px[ 1 ] - prev[ 1 ]);
+            int db = (int8_t) (px[ 2 ] - prev[ 2 ]);
+            if( dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 &&
+                db >= -2 && db <= 1 ) {
+                data[ pos++ ] = 0x40 | ((dr + 2) << 4) | ((dg + 2) << 2) |
+                                (db + 2);
+            } else if( dg >= -32 && dg <= 31 &&
+                       dr - dg >= -8 && dr - dg <= 7 &&
+                       db - dg >= -8 && db - dg <= 7 ) {
+                data[ pos++ ] = 0x80 | (dg + 32);
+                data[ pos++ ] = ((dr - dg + 8) << 4) | (db - dg + 8);
+            } else {
+                data[ pos++ ] = 0xfe;
+                memcpy( data + pos, px, 3 );
+                pos += 3;
+            }
+        }
+        memcpy( index[ hash ], px, 4 );
+        memcpy( prev, px, 4 );
+    }
+    memset( data + pos, 0, 7 );
+    data[ pos + 7 ] = 1;
+    pos += 8;
+
+    ok = testimage_write( filename, data, pos );
+    free( data );
+    return ok;
+}
+
+int testimage_write_tga( const char *filename, const uint8_t *pixels,
+                         int width, int height, int channels )
+{
+    size_t count = (size_t) width * height;
+    uint8_t *data = malloc( 18 + (count * channels) );
+    int ok;
+
+    if( !data ) return 0;
+    memset( data, 0, 18 );
+    data[ 2 ] = 2;
+    data[ 12 ] = width;
+    data[ 13 ] = width >> 8;
+    data[ 14 ] = height;
+    data[ 15 ] = height >> 8;
+    data[ 16 ] = channels * 8;
+    data[ 17 ] = 0x20 | ((channels == 4) ? 8 : 0);
+
+    for( size_t i = 0; i < count; i++ ) {
+        const uint8_t *in = pixels + (i * channels);
+        uint8_t *out = data + 18 + (i * channels);
+        out[ 0 ] = in[ 2 ];
+        out[ 1 ] = in[ 1 ];
+        out[ 2 ] = in[ 0 ];
+        if( channels == 4 ) out[ 3 ] = in[ 3 ];
+    }
+
+    ok = testimage_write( filename, data, 18 + (count * channels) );
+    free( data );
+    return ok;
+}
+
+uint8_t *testimage_read( const char *filename, size_t *size )
+{
+    FILE *f = fopen( filename, "rb" );
+    uint8_t *data = 0;
+    long len;
+
+    if( !f ) return 0;
+    if( fseek( f, 0, SEEK_END ) == 0 && (len = ftell( f )) >= 0 &&
+        fseek( f, 0, SEEK_SET ) == 0 ) {
+        data = malloc( len ? len : 1 );
+        if( data && fread( data, 1, len, f ) != (size_t) len ) {
+            free( data );
+            data = 0;
+        }
+        *size = len;
+    }
+    fclose( f );
+    return data;
+}
+
+int testimage_write( const char *filename, const uint8_t *data, size_t size )
+{
+    FILE *f = fopen( filename, "wb" );
+    int ok;
+
+    if( !f ) return 0;
+    ok = fwrite( data, 1, size, f ) == size;
+    if( fclose( f ) != 0 ) ok = 0;
+    return ok;
+}
@@ -0,0 +1,100 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef TESTIMAGE_H_INCLUDED
+#define TESTIMAGE_H_INCLUDED
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Test images for the tests and benchmarks, so they need no art of
+ * their own.  The pattern is smooth gradients with some noise on top,
+ * which compresses about as well as real art does.
+ *
+ * Example usage:
+ *
+ * char name[ 256 ];
+ * uint8_t *pixels = testimage_pixels( 1920, 1080, 4 );
+ * testimage_name( name, sizeof( name ), "big.png" );
+ * testimage_write_png( name, pixels, 1920, 1080, 4 );
+ * ...
+ * unlink( name );
+ * free( pixels );
+ */
+
+/**
+ * Returns width by height pixels of the test pattern, with the given
+ * number of channels from 1 for gray to 4 for RGBA.  Free with free().
+ */
+uint8_t *testimage_pixels( int width, int height, int channels );
+
+/**
+ * Fills name with a path for a scratch file, unique to this process.
+ */
+void testimage_name( char *name, int size, const char *suffix );
+
+/**
+ * Writes the pixels as a PNG, gray, gray and alpha, RGB or RGBA by the
+ * number of channels.  Returns 0 on error.
+ */
+int testimage_write_png( const char *filename, const uint8_t *pixels,
+                         int width, int height, int channels );
+
+/**
+ * Writes gray or RGB pixels as a PNG with a tRNS chunk, which makes the
+ * colour key, a gray level or an RGB triple, fully transparent.
+ * Returns 0 on error.
+ */
+int testimage_write_png_key( const char *filename, const uint8_t *pixels,
+                             int width, int height, int channels,
+                             const uint8_t *key );
+
+/**
+ * Writes RGB or RGBA pixels as a QOI file, or as an uncompressed top to
+ * bottom TGA file.  Returns 0 on error.
+ */
+int testimage_write_qoi( const char *filename, const uint8_t *pixels,
+                         int width, int height, int channels );
+int testimage_write_tga( const char *filename, const uint8_t *pixels,
+                         int width, int height, int channels );
+
+/**
+ * Reads the whole file into memory, and returns it and its size, or 0
+ * on error.  Free with free().
+ */
+uint8_t *testimage_read( const char *filename, size_t *size );
+
+/**
+ * Writes size bytes of data to the file.  Returns 0 on error.
+ */
+int testimage_write( const char *filename, const uint8_t *data, size_t size );
+
+#ifdef __cplusplus
+};
+#endif
+#endif /* TESTIMAGE_H_INCLUDED */
@@ -0,0 +1,253 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "texcache.h"
+
+#define TEXCACHE_MAGIC "vctexc"
+#define TEXCACHE_VERSION 2
+
+/**
+ * The header is padded to 128 bytes so the scanlines that follow it
+ * stay nicely aligned in the mapping.
+ */
+typedef struct texcache_header_s
+{
+    char magic[ 8 ];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;
+    uint32_t has_alpha;
+    uint32_t display_width;
+    uint32_t display_height;
+    uint32_t max_width;
+    uint32_t max_height;
+    uint32_t reserved;
+    int64_t src_mtime_sec;
+    int64_t src_mtime_nsec;
+    int64_t src_size;
+    uint8_t pad[ 56 ];
+} texcache_header_t;
+
+struct texcache_s
+{
+    void *map;
+    size_t size;
+    const texcache_header_t *header;
+};
+
+static char *texcache_name( const char *filename, const char *suffix )
+{
+    size_t len = strlen( filename ) + strlen( suffix ) + 1;
+    char *name = malloc( len );
+    if( name ) {
+        snprintf( name, len, "%s%s", filename, suffix );
+    }
+    return name;
+}
+
+static void texcache_fill_source( texcache_header_t *header,
+                                  const struct stat *st )
+{
+    header->src_mtime_sec = st->st_mtim.tv_sec;
+    header->src_mtime_nsec = st->st_mtim.tv_nsec;
+    header->src_size = st->st_size;
+}
+
+texcache_t *texcache_open( const char *filename, const struct stat *st,
+                           int max_width, int max_height )
+{
+    char *name = texcache_name( filename, ".cache" );
+    texcache_header_t expect;
+    struct stat cs;
+    int fd;
+
+    if( !name ) return 0;
+    fd = open( name, O_RDONLY );
+    free( name );
+    if( fd < 0 ) return 0;
+
+    if( fstat( fd, &cs ) < 0 || (size_t) cs.st_size < sizeof( texcache_header_t ) ) {
+        close( fd );
+        return 0;
+    }
+
+    texcache_t *texcache = malloc( sizeof( texcache_t ) );
+    if( !texcache ) {
+        close( fd );
+        return 0;
+    }
+
+    texcache->size = cs.st_size;
+    texcache->map = mmap( 0, texcache->size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if( texcache->map == MAP_FAILED ) {
+        free( texcache );
+        return 0;
+    }
+    texcache->header = texcache->map;
+
+    memset( &expect, 0, sizeof( expect ) );
+    texcache_fill_source( &expect, st );
+
+    const texcache_header_t *h = texcache->header;
+    if( memcmp( h->magic, TEXCACHE_MAGIC, sizeof( TEXCACHE_MAGIC ) ) ||
+        h->version != TEXCACHE_VERSION ||
+        h->src_mtime_sec != expect.src_mtime_sec ||
+        h->src_mtime_nsec != expect.src_mtime_nsec ||
+        h->src_size != expect.src_size ||
+        h->max_width != (uint32_t) max_width ||
+        h->max_height != (uint32_t) max_height ||
+        !h->stride || h->stride < h->width * (h->has_alpha ? 4 : 3) ||
+        (texcache->size - sizeof( texcache_header_t )) / h->stride < h->height ) {
+        texcache_delete( texcache );
+        return 0;
+    }
+
+    posix_madvise( texcache->map, texcache->size, POSIX_MADV_WILLNEED );
+    return texcache;
+}
+
+void texcache_delete( texcache_t *texcache )
+{
+    munmap( texcache->map, texcache->size );
+    free( texcache );
+}
+
+unsigned int texcache_get_width( texcache_t *texcache )
+{
+    return texcache->header->width;
+}
+
+unsigned int texcache_get_height( texcache_t *texcache )
+{
+    return texcache->header->height;
+}
+
+unsigned int texcache_get_display_width( texcache_t *texcache )
+{
+    return texcache->header->display_width;
+}
+
+unsigned int texcache_get_display_height( texcache_t *texcache )
+{
+    return texcache->header->display_height;
+}
+
+int texcache_get_stride( texcache_t *texcache )
+{
+    return texcache->header->stride;
+}
+
+int texcache_has_alpha( texcache_t *texcache )
+{
+    return texcache->header->has_alpha;
+}
+
+uint8_t *texcache_get_pixels( texcache_t *texcache )
+{
+    return ((uint8_t *) texcache->map) + sizeof( texcache_header_t );
+}
+
+int texcache_write( const char *filename, const struct stat *st,
+                    int max_width, int max_height,
+                    const uint8_t *pixels, unsigned int width,
+                    unsigned int height, int stride, int has_alpha,
+                    unsigned int display_width, unsigned int display_height )
+{
+    char *name = texcache_name( filename, ".cache" );
+    char *tmpname = texcache_name( filename, ".cache.XXXXXX" );
+    texcache_header_t header;
+    int ok = 1;
+    FILE *f = 0;
+    int fd;
+
+    if( !name || !tmpname ) {
+        free( name );
+        free( tmpname );
+        return 0;
+    }
+
+    memset( &header, 0, sizeof( header ) );
+    memcpy( header.magic, TEXCACHE_MAGIC, sizeof( TEXCACHE_MAGIC ) );
+    header.version = TEXCACHE_VERSION;
+    header.width = width;
+    header.height = height;
+    header.stride = stride;
+    header.has_alpha = has_alpha;
+    header.display_width = display_width;
+    header.display_height = display_height;
+    header.max_width = max_width;
+    header.max_height = max_height;
+    texcache_fill_source( &header, st );
+
+    /**
+     * Every writer gets its own temporary file, so two processes caching
+     * the same image never write into each other's.
+     */
+    fd = mkstemp( tmpname );
+    if( fd >= 0 ) {
+        fchmod( fd, 0644 );
+        f = fdopen( fd, "wb" );
+        if( !f ) {
+            close( fd );
+            unlink( tmpname );
+        }
+    }
+    if( !f ) {
+        fprintf( stderr, "texcache: Cannot write %s: %s\n",
+                 tmpname, strerror( errno ) );
+        free( name );
+        free( tmpname );
+        return 0;
+    }
+
+    if( fwrite( &header, sizeof( header ), 1, f ) != 1 ) ok = 0;
+    for( unsigned int i = 0; ok && i < height; i++ ) {
+        if( fwrite( pixels + (i * stride), stride, 1, f ) != 1 ) ok = 0;
+    }
+    if( fclose( f ) != 0 ) ok = 0;
+
+    if( ok && rename( tmpname, name ) < 0 ) ok = 0;
+    if( !ok ) {
+        fprintf( stderr, "texcache: Failed to write %s: %s\n",
+                 name, strerror( errno ) );
+        unlink( tmpname );
+    }
+
+    free( name );
+    free( tmpname );
+    return ok;
+}
@@ -0,0 +1,120 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef TEXCACHE_H_INCLUDED
+#define TEXCACHE_H_INCLUDED
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Decoded images are cached in a sidecar file next to the source, named
+ * after it with a ".cache" suffix.  The cache holds the raw scanlines
+ * exactly as they are uploaded, behind a small header that records the
+ * dimensions and the mtime and size of the source it was made from.
+ *
+ * Images too large for the output are cached already reduced, so the
+ * header also records the output size they were reduced for, and the
+ * size the image is to be displayed at.
+ *
+ * Example usage:
+ *
+ * texcache_t *cache = texcache_open( "myimage.png", &st, 720, 480 );
+ * if( cache ) {
+ *     upload( texcache_get_pixels( cache ), texcache_get_stride( cache ) );
+ *     texcache_delete( cache );
+ * } else {
+ *     decode the png, upload it, then
+ *     texcache_write( "myimage.png", &st, 720, 480, pixels, w, h, stride,
+ *                     alpha, display_w, display_h );
+ * }
+ */
+
+typedef struct texcache_s texcache_t;
+
+/**
+ * Maps the cache for the given source file.  Returns 0 if there is no
+ * cache, or if it was not made from the source described by st for an
+ * output of max_width by max_height.
+ */
+texcache_t *texcache_open( const char *filename, const struct stat *st,
+                           int max_width, int max_height );
+
+/**
+ * Unmaps the cache.
+ */
+void texcache_delete( texcache_t *texcache );
+
+/**
+ * Returns the width of the cached image.
+ */
+unsigned int texcache_get_width( texcache_t *texcache );
+
+/**
+ * Returns the height of the cached image.
+ */
+unsigned int texcache_get_height( texcache_t *texcache );
+
+/**
+ * Returns the size the cached image is to be displayed at.
+ */
+unsigned int texcache_get_display_width( texcache_t *texcache );
+unsigned int texcache_get_display_height( texcache_t *texcache );
+
+/**
+ * Returns the number of bytes per scanline.
+ */
+int texcache_get_stride( texcache_t *texcache );
+
+/**
+ * Returns true if the cached image has an alpha channel.
+ */
+int texcache_has_alpha( texcache_t *texcache );
+
+/**
+ * Returns a pointer to the first scanline.  The mapping is read-only.
+ */
+uint8_t *texcache_get_pixels( texcache_t *texcache );
+
+/**
+ * Writes a cache for filename, which was in the state st when it was
+ * decoded and reduced for an output of max_width by max_height.  The
+ * file is written under a unique temporary name and renamed into
+ * place, so readers never see a partial cache and writers never clash.
+ * Returns 0 on error.
+ */
+int texcache_write( const char *filename, const struct stat *st,
+                    int max_width, int max_height,
+                    const uint8_t *pixels, unsigned int width,
+                    unsigned int height, int stride, int has_alpha,
+                    unsigned int display_width, unsigned int display_height );
+
+#ifdef __cplusplus
+};
+#endif
+#endif /* TEXCACHE_H_INCLUDED */
@@ -0,0 +1,202 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bufpool.h"
+#include "tgainput.h"
+
+#define TGA_HEADER_SIZE 18
+#define TGA_TYPE_TRUECOLOR 2
+#define TGA_TYPE_TRUECOLOR_RLE 10
+
+/* Image descriptor bits. */
+#define TGA_RIGHT_TO_LEFT 0x10
+#define TGA_TOP_TO_BOTTOM 0x20
+
+struct tgainput_s
+{
+    uint8_t *pixels;
+    unsigned int width;
+    unsigned int height;
+    int channels;
+    int bottom_up;
+};
+
+static unsigned int read_le16( const uint8_t *p )
+{
+    return p[ 0 ] | ((unsigned int) p[ 1 ] << 8);
+}
+
+int tgainput_probe( const uint8_t *data, size_t size )
+{
+    if( size < TGA_HEADER_SIZE ) return 0;
+
+    /* No colour map, truecolour, 24 or 32 bits, stored left to right. */
+    return data[ 1 ] == 0 &&
+           (data[ 2 ] == TGA_TYPE_TRUECOLOR ||
+            data[ 2 ] == TGA_TYPE_TRUECOLOR_RLE) &&
+           (data[ 16 ] == 24 || data[ 16 ] == 32) &&
+           !(data[ 17 ] & TGA_RIGHT_TO_LEFT) &&
+           read_le16( data + 12 ) && read_le16( data + 14 );
+}
+
+/**
+ * Copies count pixels from BGR(A) to RGB(A).
+ */
+static void tgainput_swap( uint8_t *out, const uint8_t *in, size_t count,
+                           int channels )
+{
+    if( channels == 4 ) {
+        while( count-- ) {
+            out[ 0 ] = in[ 2 ];
+            out[ 1 ] = in[ 1 ];
+            out[ 2 ] = in[ 0 ];
+            out[ 3 ] = in[ 3 ];
+            out += 4;
+            in += 4;
+        }
+    } else {
+        while( count-- ) {
+            out[ 0 ] = in[ 2 ];
+            out[ 1 ] = in[ 1 ];
+            out[ 2 ] = in[ 0 ];
+            out += 3;
+            in += 3;
+        }
+    }
+}
+
+/**
+ * Expands run-length packets, which may cross scanlines.  Returns 0 if
+ * the data runs out early.
+ */
+static int tgainput_unpack( tgainput_t *tgainput, const uint8_t *p,
+                            const uint8_t *end )
+{
+    int channels = tgainput->channels;
+    size_t left = (size_t) tgainput->width * tgainput->height;
+    uint8_t *out = tgainput->pixels;
+
+    while( left ) {
+        if( p >= end ) return 0;
+
+        int packet = *p++;
+        size_t count = (packet & 0x7f) + 1;
+        if( count > left ) count = left;
+
+        if( packet & 0x80 ) {
+            if( end - p < channels ) return 0;
+            tgainput_swap( out, p, 1, channels );
+            for( size_t i = 1; i < count; i++ ) {
+                memcpy( out + (i * channels), out, channels );
+            }
+            p += channels;
+        } else {
+            if( (size_t) (end - p) < count * channels ) return 0;
+            tgainput_swap( out, p, count, channels );
+            p += count * channels;
+        }
+        out += count * channels;
+        left -= count;
+    }
+    return 1;
+}
+
+tgainput_t *tgainput_new( const char *filename, const uint8_t *data,
+                          size_t size )
+{
+    tgainput_t *tgainput;
+    const uint8_t *end = data + size;
+    const uint8_t *p;
+
+    if( !tgainput_probe( data, size ) ) {
+        fprintf( stderr, "tgainput: Unsupported format in %s.\n", filename );
+        return 0;
+    }
+
+    tgainput = bufpool_alloc( sizeof( tgainput_t ) );
+    if( !tgainput ) return 0;
+
+    tgainput->width = read_le16( data + 12 );
+    tgainput->height = read_le16( data + 14 );
+    tgainput->channels = data[ 16 ] / 8;
+    tgainput->bottom_up = !(data[ 17 ] & TGA_TOP_TO_BOTTOM);
+    tgainput->pixels = bufpool_alloc( (size_t) tgainput->width * tgainput->height *
+                                      tgainput->channels );
+    if( !tgainput->pixels ) {
+        fprintf( stderr, "tgainput: No memory for %s.\n", filename );
+        bufpool_free( tgainput );
+        return 0;
+    }
+
+    /* Skip the header and the image ID that follows it. */
+    p = data + TGA_HEADER_SIZE + data[ 0 ];
+
+    if( data[ 2 ] == TGA_TYPE_TRUECOLOR_RLE ) {
+        if( p > end || !tgainput_unpack( tgainput, p, end ) ) {
+            fprintf( stderr, "tgainput: Cannot decode %s.\n", filename );
+            tgainput_delete( tgainput );
+            return 0;
+        }
+    } else {
+        size_t count = (size_t) tgainput->width * tgainput->height;
+        if( p > end || (size_t) (end - p) < count * tgainput->channels ) {
+            fprintf( stderr, "tgainput: %s is truncated.\n", filename );
+            tgainput_delete( tgainput );
+            return 0;
+        }
+        tgainput_swap( tgainput->pixels, p, count, tgainput->channels );
+    }
+    return tgainput;
+}
+
+void tgainput_delete( tgainput_t *tgainput )
+{
+    bufpool_free( tgainput->pixels );
+    bufpool_free( tgainput );
+}
+
+unsigned int tgainput_get_width( tgainput_t *tgainput )
+{
+    return tgainput->width;
+}
+
+unsigned int tgainput_get_height( tgainput_t *tgainput )
+{
+    return tgainput->height;
+}
+
+uint8_t *tgainput_get_scanline( tgainput_t *tgainput, int num )
+{
+    if( tgainput->bottom_up ) num = tgainput->height - 1 - num;
+    return tgainput->pixels +
+        ((size_t) num * tgainput->width * tgainput->channels);
+}
+
+int tgainput_has_alpha( tgainput_t *tgainput )
+{
+    return tgainput->channels == 4;
+}
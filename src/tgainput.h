@@ -0,0 +1,79 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef TGAINPUT_H_INCLUDED
+#define TGAINPUT_H_INCLUDED
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Decodes 24 and 32 bit truecolour TGA files, either uncompressed or
+ * run-length encoded.  Uncompressed TGA is bigger than PNG on disk but
+ * needs no decoding beyond swapping to RGB, so it is the quickest format
+ * to reload.  As with qoiinput, the caller provides the file's contents.
+ */
+
+typedef struct tgainput_s tgainput_t;
+
+/**
+ * Returns true if data starts with a TGA header this decoder supports.
+ * TGA has no magic number, so this is a sanity check of the header.
+ */
+int tgainput_probe( const uint8_t *data, size_t size );
+
+/**
+ * Decodes size bytes of TGA data read from filename.  Returns 0 on
+ * error.
+ */
+tgainput_t *tgainput_new( const char *filename, const uint8_t *data,
+                          size_t size );
+
+/**
+ * Frees the decoded image.
+ */
+void tgainput_delete( tgainput_t *tgainput );
+
+unsigned int tgainput_get_width( tgainput_t *tgainput );
+unsigned int tgainput_get_height( tgainput_t *tgainput );
+
+/**
+ * Returns a pointer to the given scanline from 0 to height-1, counting
+ * from the top of the image whichever way up the file was stored.
+ */
+uint8_t *tgainput_get_scanline( tgainput_t *tgainput, int num );
+
+/**
+ * Returns true if this image has an alpha channel.
+ */
+int tgainput_has_alpha( tgainput_t *tgainput );
+
+#ifdef __cplusplus
+};
+#endif
+#endif /* TGAINPUT_H_INCLUDED */
@@ -1,13 +1,131 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <SDL2/SDL.h>
+#include "capture.h"
+#include "shmout.h"
 #include "channel.h"
 #include "minput.h"
 #include "ainput.h"
+#include "oscinput.h"
+#include "ctlrecord.h"
+#include "ctlreplay.h"
+#include "scenes.h"
+#include "wall.h"
+#include "workpool.h"
+#include "residency.h"
+#include "bufpool.h"
+#include "controlbus.h"
+#include "mapfile.h"
+
+/* How often the loop wakes to poll events and look for new files. */
+#define IDLE_WAKE_MS 100
+
+/* Each channel's file is checked once per CHECK_MS * number of channels. */
+#define CHECK_MS 300
+
+/* Threads decoding images that come back into view. */
+#define LOADER_THREADS 2
+
+/* Shortest time between presented frames. */
+#define MIN_FRAME_MS 16
+
+/* Frames waiting to be encoded before new ones are dropped. */
+#define CAPTURE_SLOTS 8
+
+/* Frames kept in the shared memory output for readers to catch up on. */
+#define SHMOUT_SLOTS 3
+
+/* Port the leader of a video wall listens on. */
+#define WALL_PORT 9100
+
+/* MIDI notes from this one up recall scenes. */
+#define SCENE_NOTE 36
+
+static void scene_note( void *arg, int note, int velocity )
+{
+    scenes_trigger( arg, note - SCENE_NOTE );
+}
+
+static void usage( const char *argv0 )
+{
+    fprintf( stderr, "usage: %s [-r record.y4m] [-R fps] [-o /shmname] [-p oscport]\n"
+             "       [-B textureMB] [-l log.vcc | -L log.vcc [-S]]\n"
+             "       [-V canvasWxH] [-T tileX,tileY] [-W port | -J host[:port]]\n",
+             argv0 );
+}
 
 int main( int argc, char **argv )
 {
     int width = 720;
     int height = 480;
+    int texture_mb = 256;
+    const char *record = 0;
+    const char *shmname = 0;
+    int osc_port = 0;
+    const char *control_log = 0;
+    const char *control_replay = 0;
+    int stepped = 0;
+    int record_fps = 30;
+    int canvas_width = 0;
+    int canvas_height = 0;
+    int tile_x = 0;
+    int tile_y = 0;
+    int wall_port = 0;
+    char wall_host[ 256 ] = "";
+    int opt;
+
+    while( (opt = getopt( argc, argv, "r:R:o:p:B:l:L:SV:T:W:J:" )) != -1 ) {
+        switch( opt ) {
+        case 'r': record = optarg; break;
+        case 'R': record_fps = atoi( optarg ); break;
+        case 'o': shmname = optarg; break;
+        case 'p': osc_port = atoi( optarg ); break;
+        case 'B': texture_mb = atoi( optarg ); break;
+        case 'l': control_log = optarg; break;
+        case 'L': control_replay = optarg; break;
+        case 'S': stepped = 1; break;
+        case 'V':
+            if( sscanf( optarg, "%dx%d", &canvas_width, &canvas_height ) != 2 ) {
+                canvas_width = -1;
+            }
+            break;
+        case 'T':
+            if( sscanf( optarg, "%d,%d", &tile_x, &tile_y ) != 2 ) tile_x = -1;
+            break;
+        case 'W': wall_port = atoi( optarg ); break;
+        case 'J':
+            snprintf( wall_host, sizeof( wall_host ), "%s", optarg );
+            break;
+        default: usage( argv[ 0 ] ); return 1;
+        }
+    }
+
+    // a tile of a video wall draws its part of a larger canvas
+    char *colon = strrchr( wall_host, ':' );
+    int wall_join_port = WALL_PORT;
+    if( colon ) {
+        *colon = 0;
+        wall_join_port = atoi( colon + 1 );
+    }
+    if( !canvas_width && !canvas_height ) {
+        canvas_width = width;
+        canvas_height = height;
+    }
+    if( tile_x < 0 || tile_y < 0 || tile_x + width > canvas_width ||
+        tile_y + height > canvas_height || wall_port < 0 ||
+        (wall_port && *wall_host) || wall_join_port <= 0 ) {
+        usage( argv[ 0 ] );
+        return 1;
+    }
+
+    if( record_fps <= 0 || texture_mb <= 0 || (stepped && !control_replay) ) {
+        usage( argv[ 0 ] );
+        return 1;
+    }
 
     if( SDL_Init( SDL_INIT_VIDEO ) < 0 ) {
         fprintf( stderr, "SDL_Init failed.\n" );
@@ -23,120 +141,356 @@ int main( int argc, char **argv )
 
     SDL_ShowCursor( SDL_DISABLE );
 
-    // midi
-    minput_t *minput = minput_new( "hw:2,0,0" );
-    // audio
-    ainput_t *ainput = ainput_new( "hw:3,0,0" );
+    controlbus_t *bus = controlbus_new();
+    workpool_t *workers = workpool_new( 0 );
+    workpool_t *loaders = workpool_new( LOADER_THREADS );
+
+    // A replayed log, or the leader of a wall we follow, stands in for the
+    // live inputs, so they are not opened
+    minput_t *minput = 0;
+    ainput_t *ainput = 0;
+    if( !control_replay && !*wall_host ) {
+        // midi
+        minput = minput_new( "hw:2,0,0", bus );
+        // audio
+        ainput = ainput_new( "hw:3,0,0", bus );
+    }
 
     // Sprite channels
-    channel_t *ch0 = channel_new( renderer, "ch0.png", width, height, 0 );
-    minput_set_control( minput, 0, channel_get_y_offset( ch0 ) );
-    minput_set_control( minput, 16, channel_get_x_offset( ch0 ) );
+    channel_t *ch0 = channel_new( renderer, bus, "ch0.png",
+                                  canvas_width, canvas_height, 0 );
 
-    channel_t *ch1 = channel_new( renderer, "ch1.png", width, height, 0 );
-    minput_set_control( minput, 1, channel_get_y_offset( ch1 ) );
-    minput_set_control( minput, 17, channel_get_x_offset( ch1 ) );
+    channel_t *ch1 = channel_new( renderer, bus, "ch1.png",
+                                  canvas_width, canvas_height, 0 );
 
-    channel_t *ch2 = channel_new( renderer, "ch2.png", width, height, 0 );
-    minput_set_control( minput, 2, channel_get_y_offset( ch2 ) );
-    minput_set_control( minput, 18, channel_get_x_offset( ch2 ) );
+    channel_t *ch2 = channel_new( renderer, bus, "ch2.png",
+                                  canvas_width, canvas_height, 0 );
 
-    channel_t *ch3 = channel_new( renderer, "ch3.png", width, height, 0 );
-    minput_set_control( minput, 3, channel_get_y_offset( ch3 ) );
-    minput_set_control( minput, 19, channel_get_x_offset( ch3 ) );
+    channel_t *ch3 = channel_new( renderer, bus, "ch3.png",
+                                  canvas_width, canvas_height, 0 );
 
-    channel_t *ch4 = channel_new( renderer, "ch4.png", width, height, 0 );
-    minput_set_control( minput, 4, channel_get_y_offset( ch4 ) );
-    minput_set_control( minput, 20, channel_get_x_offset( ch4 ) );
+    channel_t *ch4 = channel_new( renderer, bus, "ch4.png",
+                                  canvas_width, canvas_height, 0 );
 
     // Background channels
-    channel_t *ch5 = channel_new( renderer, "ch5.png", width, height, 1 );
-    minput_set_control( minput, 5, channel_get_a_offset( ch5 ) );
+    // with a second image each for scenes to switch to
+    channel_t *ch5 = channel_new( renderer, bus, "ch5.png",
+                                  canvas_width, canvas_height, 1 );
+    channel_add_image( ch5, "ch5b.png" );
+
+    channel_t *ch6 = channel_new( renderer, bus, "ch6.png",
+                                  canvas_width, canvas_height, 1 );
+    channel_add_image( ch6, "ch6b.png" );
 
-    channel_t *ch6 = channel_new( renderer, "ch6.png", width, height, 1 );
-    minput_set_control( minput, 6, channel_get_a_offset( ch6 ) );
+    channel_t *ch7 = channel_new( renderer, bus, "ch7.png",
+                                  canvas_width, canvas_height, 1 );
+    channel_add_image( ch7, "ch7b.png" );
+
+    // Video channel
+    channel_t *ch8 = channel_new( renderer, bus, "ch8.y4m",
+                                  canvas_width, canvas_height, 1 );
+
+    // Generated background, faded out until its fader is moved
+    channel_t *gen0 = channel_new_generator( renderer, bus, "gen0", "plasma",
+                                             workers, canvas_width,
+                                             canvas_height, 1 );
+    controlbus_set( bus, channel_get_slot( gen0, CHANNEL_A_OFFSET ), 0 );
+
+    // Particles burst from the middle of the screen on audio onsets
+    channel_t *parts0 = channel_new_particles( renderer, bus, "parts0", 50000,
+                                               canvas_width, canvas_height );
+    controlbus_set( bus, channel_get_slot( parts0, CHANNEL_X_OFFSET ), MAPPING_CENTRE );
+    controlbus_set( bus, channel_get_slot( parts0, CHANNEL_Y_OFFSET ), MAPPING_CENTRE );
+
+    // MIDI controllers 0-10 and 16-26 move the channels
+    if( minput ) {
+        minput_set_control( minput, 0, channel_get_slot( ch0, CHANNEL_Y_OFFSET ) );
+        minput_set_control( minput, 16, channel_get_slot( ch0, CHANNEL_X_OFFSET ) );
+        minput_set_control( minput, 1, channel_get_slot( ch1, CHANNEL_Y_OFFSET ) );
+        minput_set_control( minput, 17, channel_get_slot( ch1, CHANNEL_X_OFFSET ) );
+        minput_set_control( minput, 2, channel_get_slot( ch2, CHANNEL_Y_OFFSET ) );
+        minput_set_control( minput, 18, channel_get_slot( ch2, CHANNEL_X_OFFSET ) );
+        minput_set_control( minput, 3, channel_get_slot( ch3, CHANNEL_Y_OFFSET ) );
+        minput_set_control( minput, 19, channel_get_slot( ch3, CHANNEL_X_OFFSET ) );
+        minput_set_control( minput, 4, channel_get_slot( ch4, CHANNEL_Y_OFFSET ) );
+        minput_set_control( minput, 20, channel_get_slot( ch4, CHANNEL_X_OFFSET ) );
+        minput_set_control( minput, 5, channel_get_slot( ch5, CHANNEL_A_OFFSET ) );
+        minput_set_control( minput, 6, channel_get_slot( ch6, CHANNEL_A_OFFSET ) );
+        minput_set_control( minput, 7, channel_get_slot( ch7, CHANNEL_A_OFFSET ) );
+        minput_set_control( minput, 8, channel_get_slot( ch8, CHANNEL_A_OFFSET ) );
+        minput_set_control( minput, 24, channel_get_slot( ch8, CHANNEL_RATE ) );
+        minput_set_control( minput, 9, channel_get_slot( gen0, CHANNEL_A_OFFSET ) );
+        minput_set_control( minput, 25, channel_get_slot( gen0, CHANNEL_DETAIL ) );
+        minput_set_control( minput, 10, channel_get_slot( parts0, CHANNEL_A_OFFSET ) );
+        minput_set_control( minput, 26, channel_get_slot( parts0, CHANNEL_DETAIL ) );
+    }
+
+    // Decode every image in parallel before the first frame
+    channel_t *channels[] = { ch0, ch1, ch2, ch3, ch4, ch5, ch6, ch7, ch8, gen0,
+                              parts0 };
+    int num_channels = sizeof( channels ) / sizeof( channels[ 0 ] );
+    for( int i = 0; i < num_channels; i++ ) {
+        channel_set_view( channels[ i ], tile_x, tile_y, width, height );
+    }
+    channel_preload( channels, num_channels, workers );
+
+    // Keep textures of offscreen channels within budget
+    residency_t *residency = residency_new( (size_t) texture_mb * 1024 * 1024,
+                                            loaders, bus );
+    for( int i = 0; i < num_channels; i++ ) {
+        residency_add( residency, channels[ i ] );
+    }
 
-    channel_t *ch7 = channel_new( renderer, "ch7.png", width, height, 1 );
-    minput_set_control( minput, 7, channel_get_a_offset( ch7 ) );
+    // Scene presets, recalled by F-keys or MIDI notes and stored with shift
+    scenes_t *scenes = scenes_new( "vcontrol.scenes", bus, channels, num_channels );
+    if( scenes && minput ) minput_set_note_tap( minput, scene_note, scenes );
 
-    // Audio moves sprite 1
-    ainput_set_control( ainput, channel_get_y_control( ch1 ) );
-    ainput_start( ainput );
+    // Control curves, reloaded whenever the file changes
+    mapfile_t *mapfile = mapfile_new( "vcontrol.map", bus );
+    mapfile_start( mapfile );
+
+    // Log every control change, for replaying the show later
+    ctlrecord_t *ctlrecord = 0;
+    if( control_log ) {
+        ctlrecord = ctlrecord_new( control_log, bus );
+    }
+
+    // A replayed log stands in for the live inputs
+    ctlreplay_t *ctlreplay = 0;
+    if( control_replay ) {
+        ctlreplay = ctlreplay_new( control_replay, bus );
+        if( !ctlreplay ) return 1;
+        if( !stepped ) ctlreplay_start( ctlreplay, 1.0 );
+    }
+
+    // The leader of a wall hands its controls to the other tiles each frame
+    wall_t *wall = 0;
+    if( wall_port ) {
+        wall = wall_new_leader( wall_port, bus );
+        if( !wall ) return 1;
+    } else if( *wall_host ) {
+        wall = wall_new_follower( wall_host, wall_join_port, bus );
+        if( !wall ) return 1;
+    }
+    int follower = wall && !wall_is_leader( wall );
+
+    // Audio moves sprite 1 and drives the particles
+    if( ainput ) {
+        ainput_set_control( ainput, channel_get_slot( ch1, CHANNEL_Y_CONTROL ) );
+        ainput_add_control( ainput, channel_get_slot( parts0, CHANNEL_EMIT ) );
+        ainput_start( ainput );
+    }
+    if( minput ) minput_start( minput );
+
+    // OSC can address every slot by name, as in /ch0/x_offset, from
+    // anywhere on the network, so it is only on when asked for with -p
+    oscinput_t *oscinput = 0;
+    if( osc_port > 0 && !ctlreplay && !follower ) {
+        oscinput = oscinput_new( osc_port, bus );
+        if( oscinput ) oscinput_start( oscinput );
+    }
+
+    // Press r to start and stop recording, s to save a still
+    capture_t *capture = capture_new( renderer, width, height, CAPTURE_SLOTS );
+    if( capture && record ) {
+        capture_record( capture, record, record_fps );
+    }
+
+    // Other local processes can read every frame from shared memory
+    shmout_t *shmout = 0;
+    if( capture && shmname ) {
+        shmout = shmout_new( shmname, width, height, SHMOUT_SLOTS );
+        if( shmout ) capture_set_output( capture, shmout );
+    }
+    int num_recordings = 0;
+    int num_stills = 0;
+    char capture_name[ 64 ];
 
     SDL_Event event;
     int quit = 0;
-    int frames = 0;
+    int next_check = 0;
+    int redraw = 1;
+    Uint32 last_check = SDL_GetTicks();
+    Uint32 last_frame = 0;
+    Uint64 step_start = SDL_GetPerformanceCounter();
+    unsigned int steps = 0;
 
     while( !quit ) {
         while( SDL_PollEvent( &event ) ) {
             if( event.type == SDL_QUIT ) quit = 1;
+            if( event.type == SDL_KEYDOWN && scenes &&
+                event.key.keysym.sym >= SDLK_F1 &&
+                event.key.keysym.sym <= SDLK_F12 ) {
+                int index = event.key.keysym.sym - SDLK_F1;
+                if( event.key.keysym.mod & KMOD_SHIFT ) {
+                    scenes_store( scenes, index );
+                } else {
+                    scenes_trigger( scenes, index );
+                }
+            }
+            if( event.type == SDL_KEYDOWN && capture ) {
+                if( event.key.keysym.sym == SDLK_r ) {
+                    if( capture_is_recording( capture ) ) {
+                        capture_stop( capture );
+                    } else {
+                        snprintf( capture_name, sizeof( capture_name ),
+                                  "record-%04d.y4m", num_recordings++ );
+                        capture_record( capture, capture_name, record_fps );
+                    }
+                } else if( event.key.keysym.sym == SDLK_s ) {
+                    snprintf( capture_name, sizeof( capture_name ),
+                              "still-%04d.png", num_stills++ );
+                    capture_still( capture, capture_name );
+                    redraw = 1;
+                }
+            }
+        }
+
+        // a follower draws each frame when the leader sends it
+        double frame_time = 0;
+        if( follower ) {
+            if( !wall_begin_frame( wall, &frame_time, IDLE_WAKE_MS ) ) continue;
+            redraw = 1;
+        }
+
+        // a stepped replay draws one frame per step, as fast as it can
+        if( stepped ) {
+            if( ctlreplay_is_done( ctlreplay ) ) {
+                double secs = (SDL_GetPerformanceCounter() - step_start) /
+                              (double) SDL_GetPerformanceFrequency();
+                fprintf( stderr, "vcontrol: replayed %u frames in %.2fs, "
+                         "%.2fms per frame\n", steps, secs,
+                         steps ? (secs * 1000.0) / steps : 0.0 );
+                quit = 1;
+                continue;
+            }
+            ctlreplay_step( ctlreplay, 1000 / record_fps );
+            redraw = 1;
+            steps++;
         }
 
         // check for new files, but not too often
-        frames = (frames + 1) % 80;
-        if( frames == 0 ) {
-            channel_checkfile( ch0 );
-        } else if( frames == 10 ) {
-            channel_checkfile( ch1 );
-        } else if( frames == 20 ) {
-            channel_checkfile( ch2 );
-        } else if( frames == 30 ) {
-            channel_checkfile( ch3 );
-        } else if( frames == 40 ) {
-            channel_checkfile( ch4 );
-        } else if( frames == 50 ) {
-            channel_checkfile( ch5 );
-        } else if( frames == 60 ) {
-            channel_checkfile( ch6 );
-        } else if( frames == 70 ) {
-            channel_checkfile( ch7 );
+        Uint32 now = SDL_GetTicks();
+        if( now - last_check >= CHECK_MS ) {
+            last_check = now;
+            redraw |= channel_checkfile( channels[ next_check ] );
+            next_check = (next_check + 1) % num_channels;
         }
 
-        // update midi input
-        minput_check( minput );
-
-        int r = 0;
-        r += channel_prepare( ch0 );
-        r += channel_prepare( ch1 );
-        r += channel_prepare( ch2 );
-        r += channel_prepare( ch3 );
-        r += channel_prepare( ch4 );
-        r += channel_prepare( ch5 );
-        r += channel_prepare( ch6 );
-        r += channel_prepare( ch7 );
-
-        if( r > 0 ) {
-            SDL_RenderClear( renderer );
-
-            // Background channels
-            channel_render( ch5 );
-            channel_render( ch6 );
-            channel_render( ch7 );
-
-            // Sprite channels
-            channel_render( ch0 );
-            channel_render( ch1 );
-            channel_render( ch2 );
-            channel_render( ch3 );
-            channel_render( ch4 );
-
-            SDL_RenderPresent( renderer );
+        // video and generators keep the scene moving while the controls are still
+        int animating = 0;
+        for( int i = 0; i < num_channels; i++ ) {
+            animating |= channel_is_animating( channels[ i ] );
         }
 
-        // yield
-        SDL_Delay( 30 );
+        // a recalled scene moves the controls itself
+        if( scenes && !follower ) animating |= scenes_update( scenes );
+
+        // only lay out the scene when a control has moved, or an image
+        // coming back into view is still being decoded
+        int presented = 0;
+        if( controlbus_collect( bus ) || redraw || animating ||
+            residency_is_restoring( residency ) ) {
+            int r = redraw;
+            if( wall ) {
+                // every tile draws every frame, at the leader's time
+                if( !follower ) wall_begin_frame( wall, &frame_time, 0 );
+                for( int i = 0; i < num_channels; i++ ) {
+                    channel_set_clock( channels[ i ], frame_time );
+                }
+                r = 1;
+            }
+            for( int i = 0; i < num_channels; i++ ) {
+                r += channel_prepare( channels[ i ] );
+            }
+
+            r += residency_update( residency );
+
+            if( r > 0 ) {
+                if( capture ) capture_begin( capture );
+                SDL_RenderClear( renderer );
+
+                // Background channels
+                channel_render( gen0 );
+                channel_render( ch5 );
+                channel_render( ch6 );
+                channel_render( ch7 );
+                channel_render( ch8 );
+
+                // Sprite channels
+                channel_render( ch0 );
+                channel_render( ch1 );
+                channel_render( ch2 );
+                channel_render( ch3 );
+                channel_render( ch4 );
+
+                // Particles over everything
+                channel_render( parts0 );
+
+                if( capture ) capture_end( capture );
+                if( wall ) wall_end_frame( wall );
+                SDL_RenderPresent( renderer );
+                last_frame = SDL_GetTicks();
+                presented = 1;
+            }
+            redraw = 0;
+        }
+
+        // sleep until a control changes, without outrunning the display,
+        // or while video plays, until its next frame might be due
+        if( stepped || follower ) continue;
+        Uint32 since = SDL_GetTicks() - last_frame;
+        if( since < MIN_FRAME_MS ) {
+            SDL_Delay( MIN_FRAME_MS - since );
+        }
+        if( !animating ) {
+            controlbus_wait( bus, IDLE_WAKE_MS );
+        } else if( !presented ) {
+            controlbus_wait( bus, MIN_FRAME_MS );
+        }
     }
 
-    ainput_delete( ainput );
-    minput_delete( minput );
-    channel_delete( ch0 );
-    channel_delete( ch1 );
-    channel_delete( ch2 );
-    channel_delete( ch3 );
-    channel_delete( ch4 );
-    channel_delete( ch5 );
-    channel_delete( ch6 );
-    channel_delete( ch7 );
+    fprintf( stderr, "vcontrol: textures %.1fMB of %.1fMB, %u evictions, "
+             "%u restores\n", residency_get_bytes( residency ) / (1024.0 * 1024.0),
+             residency_get_budget( residency ) / (1024.0 * 1024.0),
+             residency_get_evictions( residency ),
+             residency_get_restores( residency ) );
+    residency_delete( residency );
+    workpool_delete( loaders );
+
+    fprintf( stderr, "vcontrol: decode buffers %.1fMB pooled, %u from the heap\n",
+             bufpool_get_cached() / (1024.0 * 1024.0), bufpool_get_misses() );
+
+    if( capture ) {
+        capture_stop( capture );
+        capture_delete( capture );
+    }
+    if( shmout ) {
+        fprintf( stderr, "vcontrol: published %llu frames\n",
+                 (unsigned long long) shmout_get_frames( shmout ) );
+        shmout_delete( shmout );
+    }
+
+    if( wall ) {
+        if( !follower ) {
+            fprintf( stderr, "vcontrol: leading %d tiles\n",
+                     wall_get_followers( wall ) );
+        }
+        wall_delete( wall );
+    }
+    if( oscinput ) oscinput_delete( oscinput );
+    if( ainput ) ainput_delete( ainput );
+    if( minput ) minput_delete( minput );
+    if( ctlreplay ) ctlreplay_delete( ctlreplay );
+    if( ctlrecord ) ctlrecord_delete( ctlrecord );
+    if( scenes ) scenes_delete( scenes );
+    mapfile_delete( mapfile );
+    for( int i = 0; i < num_channels; i++ ) {
+        channel_delete( channels[ i ] );
+    }
+    workpool_delete( workers );
+    bufpool_flush();
+    controlbus_delete( bus );
     SDL_DestroyRenderer( renderer );
     SDL_DestroyWindow( window );
     SDL_Quit();
@@ -0,0 +1,485 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include "wall.h"
+
+/**
+ * Every packet starts with the four byte magic, a type byte, three
+ * bytes of padding and a uint32_t frame number.  A frame then carries a
+ * uint64_t frame time in microseconds, a uint32_t count, and that many
+ * int32_t control values.  All numbers are little endian.
+ */
+#define WALL_MAGIC "vcwl"
+#define HEADER_SIZE 12
+#define FRAME_HEADER_SIZE 24
+#define PACKET_SIZE 4096
+#define MAX_VALUES ((PACKET_SIZE - FRAME_HEADER_SIZE) / 4)
+
+enum
+{
+    WALL_HELLO = 1,
+    WALL_FRAME,
+    WALL_READY,
+    WALL_GO
+};
+
+#define MAX_FOLLOWERS 32
+
+/* Longest wait for the other tiles at the end of a frame. */
+#define SYNC_MS 100
+
+/* Frames in a row a follower may miss before it is dropped. */
+#define MAX_MISSES 30
+
+typedef struct follower_s
+{
+    struct sockaddr_in addr;
+    int ready;
+    int misses;
+} follower_t;
+
+struct wall_s
+{
+    controlbus_t *controlbus;
+    int fd;
+    int leader;
+    uint32_t frame;
+    uint64_t start_ns;
+    unsigned int frames;
+    unsigned int late;
+
+    /* The leader's followers. */
+    follower_t followers[ MAX_FOLLOWERS ];
+    int num_followers;
+
+    /* A follower's leader, and the next frame if it came early. */
+    struct sockaddr_in leader_addr;
+    uint8_t next[ PACKET_SIZE ];
+    size_t next_len;
+    int warned;
+
+    int values[ MAX_VALUES ];
+    uint8_t in[ PACKET_SIZE ];
+    uint8_t out[ PACKET_SIZE ];
+};
+
+static uint64_t wall_now( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ((uint64_t) ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+static void wall_write32( uint8_t *p, uint32_t v )
+{
+    p[ 0 ] = v;
+    p[ 1 ] = v >> 8;
+    p[ 2 ] = v >> 16;
+    p[ 3 ] = v >> 24;
+}
+
+static uint32_t wall_read32( const uint8_t *p )
+{
+    return p[ 0 ] | (p[ 1 ] << 8) | (p[ 2 ] << 16) | ((uint32_t) p[ 3 ] << 24);
+}
+
+static void wall_header( uint8_t *p, int type, uint32_t frame )
+{
+    memcpy( p, WALL_MAGIC, 4 );
+    p[ 4 ] = type;
+    p[ 5 ] = p[ 6 ] = p[ 7 ] = 0;
+    wall_write32( p + 8, frame );
+}
+
+static void wall_send( wall_t *wall, const struct sockaddr_in *addr,
+                       const uint8_t *p, size_t len )
+{
+    if( sendto( wall->fd, p, len, 0, (const struct sockaddr *) addr,
+                sizeof( *addr ) ) < 0 && errno != EAGAIN ) {
+        fprintf( stderr, "wall: send to %s:%d failed: %s\n",
+                 inet_ntoa( addr->sin_addr ), ntohs( addr->sin_port ),
+                 strerror( errno ) );
+    }
+}
+
+static void wall_send_short( wall_t *wall, const struct sockaddr_in *addr,
+                             int type, uint32_t frame )
+{
+    uint8_t p[ HEADER_SIZE ];
+    wall_header( p, type, frame );
+    wall_send( wall, addr, p, sizeof( p ) );
+}
+
+/**
+ * Waits up to timeout_ms for a packet, and returns its length, or 0 if
+ * none came.  Packets that are not ours are skipped.
+ */
+static size_t wall_receive( wall_t *wall, int timeout_ms,
+                            struct sockaddr_in *from )
+{
+    uint64_t deadline = wall_now() + ((uint64_t) timeout_ms * 1000000);
+
+    for(;;) {
+        struct pollfd pfd = { wall->fd, POLLIN, 0 };
+        uint64_t now = wall_now();
+        int wait = (now < deadline) ? (int) ((deadline - now + 999999) / 1000000) : 0;
+        socklen_t fromlen = sizeof( *from );
+        ssize_t len;
+
+        if( poll( &pfd, 1, wait ) <= 0 ) {
+            if( errno == EINTR && wall_now() < deadline ) continue;
+            return 0;
+        }
+        len = recvfrom( wall->fd, wall->in, sizeof( wall->in ), 0,
+                        (struct sockaddr *) from, &fromlen );
+        if( len >= HEADER_SIZE && !memcmp( wall->in, WALL_MAGIC, 4 ) ) {
+            return len;
+        }
+        if( wall_now() >= deadline ) return 0;
+    }
+}
+
+static wall_t *wall_new( controlbus_t *controlbus, int port )
+{
+    struct sockaddr_in addr;
+
+    wall_t *wall = malloc( sizeof( wall_t ) );
+    if( !wall ) return 0;
+
+    wall->fd = socket( AF_INET, SOCK_DGRAM, 0 );
+    if( wall->fd < 0 ) {
+        fprintf( stderr, "wall: Cannot create socket: %s\n", strerror( errno ) );
+        free( wall );
+        return 0;
+    }
+
+    memset( &addr, 0, sizeof( addr ) );
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl( INADDR_ANY );
+    addr.sin_port = htons( port );
+    if( bind( wall->fd, (struct sockaddr *) &addr, sizeof( addr ) ) < 0 ) {
+        fprintf( stderr, "wall: Cannot listen on port %d: %s\n",
+                 port, strerror( errno ) );
+        close( wall->fd );
+        free( wall );
+        return 0;
+    }
+
+    wall->controlbus = controlbus;
+    wall->leader = 0;
+    wall->frame = 0;
+    wall->start_ns = wall_now();
+    wall->frames = 0;
+    wall->late = 0;
+    wall->num_followers = 0;
+    wall->next_len = 0;
+    wall->warned = 0;
+    memset( &wall->leader_addr, 0, sizeof( wall->leader_addr ) );
+    return wall;
+}
+
+wall_t *wall_new_leader( int port, controlbus_t *controlbus )
+{
+    wall_t *wall = wall_new( controlbus, port );
+    if( !wall ) return 0;
+
+    wall->leader = 1;
+    fprintf( stderr, "wall: Leading on port %d\n", port );
+    return wall;
+}
+
+wall_t *wall_new_follower( const char *host, int port,
+                           controlbus_t *controlbus )
+{
+    struct addrinfo hints, *res;
+    int status;
+
+    memset( &hints, 0, sizeof( hints ) );
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    status = getaddrinfo( host, 0, &hints, &res );
+    if( status != 0 ) {
+        fprintf( stderr, "wall: Cannot find %s: %s\n", host, gai_strerror( status ) );
+        return 0;
+    }
+
+    wall_t *wall = wall_new( controlbus, 0 );
+    if( wall ) {
+        memcpy( &wall->leader_addr, res->ai_addr, sizeof( wall->leader_addr ) );
+        wall->leader_addr.sin_port = htons( port );
+        wall_send_short( wall, &wall->leader_addr, WALL_HELLO, 0 );
+        fprintf( stderr, "wall: Following %s:%d\n", host, port );
+    }
+    freeaddrinfo( res );
+    return wall;
+}
+
+void wall_delete( wall_t *wall )
+{
+    fprintf( stderr, "wall: %u frames, %u not synced in time\n",
+             wall->frames, wall->late );
+    close( wall->fd );
+    free( wall );
+}
+
+int wall_is_leader( wall_t *wall )
+{
+    return wall->leader;
+}
+
+/**
+ * Takes a hello or a ready from a follower.  A new follower has not
+ * seen the current frame, so it is not waited for until the next.
+ */
+static void wall_leader_handle( wall_t *wall, const struct sockaddr_in *from )
+{
+    int type = wall->in[ 4 ];
+    uint32_t frame = wall_read32( wall->in + 8 );
+    int i;
+
+    for( i = 0; i < wall->num_followers; i++ ) {
+        const struct sockaddr_in *addr = &wall->followers[ i ].addr;
+        if( addr->sin_addr.s_addr == from->sin_addr.s_addr &&
+            addr->sin_port == from->sin_port ) {
+            break;
+        }
+    }
+
+    if( i == wall->num_followers ) {
+        if( type != WALL_HELLO ) return;
+        if( wall->num_followers == MAX_FOLLOWERS ) {
+            fprintf( stderr, "wall: too many followers\n" );
+            return;
+        }
+        wall->followers[ i ].addr = *from;
+        wall->followers[ i ].ready = 1;
+        wall->followers[ i ].misses = 0;
+        wall->num_followers++;
+        fprintf( stderr, "wall: %s:%d joined, %d followers\n",
+                 inet_ntoa( from->sin_addr ), ntohs( from->sin_port ),
+                 wall->num_followers );
+    } else if( type == WALL_READY && frame == wall->frame ) {
+        wall->followers[ i ].ready = 1;
+    }
+}
+
+static int wall_leader_begin( wall_t *wall, double *seconds )
+{
+    struct sockaddr_in from;
+    uint64_t time_us = (wall_now() - wall->start_ns) / 1000;
+    int count = controlbus_get_count( wall->controlbus );
+
+    /* Take in any hellos without waiting. */
+    while( wall_receive( wall, 0, &from ) ) {
+        wall_leader_handle( wall, &from );
+    }
+
+    if( count > MAX_VALUES ) count = MAX_VALUES;
+    controlbus_latch( wall->controlbus );
+
+    wall->frame++;
+    wall_header( wall->out, WALL_FRAME, wall->frame );
+    wall_write32( wall->out + 12, time_us );
+    wall_write32( wall->out + 16, time_us >> 32 );
+    wall_write32( wall->out + 20, count );
+    for( int i = 0; i < count; i++ ) {
+        wall_write32( wall->out + FRAME_HEADER_SIZE + (i * 4),
+                      controlbus_get( wall->controlbus, i ) );
+    }
+
+    for( int i = 0; i < wall->num_followers; i++ ) {
+        wall->followers[ i ].ready = 0;
+        wall_send( wall, &wall->followers[ i ].addr, wall->out,
+                   FRAME_HEADER_SIZE + (count * 4) );
+    }
+
+    *seconds = time_us / 1000000.0;
+    wall->frames++;
+    return 1;
+}
+
+static void wall_leader_end( wall_t *wall )
+{
+    uint64_t deadline = wall_now() + ((uint64_t) SYNC_MS * 1000000);
+    struct sockaddr_in from;
+    int waiting;
+
+    for(;;) {
+        uint64_t now = wall_now();
+        waiting = 0;
+        for( int i = 0; i < wall->num_followers; i++ ) {
+            /* Once a follower has missed a frame, stop holding up the rest. */
+            const follower_t *f = &wall->followers[ i ];
+            waiting += !f->ready && !f->misses;
+        }
+        if( !waiting || now >= deadline ) break;
+
+        if( wall_receive( wall, (int) ((deadline - now + 999999) / 1000000), &from ) ) {
+            wall_leader_handle( wall, &from );
+        }
+    }
+
+    for( int i = 0; i < wall->num_followers; i++ ) {
+        follower_t *f = &wall->followers[ i ];
+        if( f->ready ) {
+            f->misses = 0;
+            continue;
+        }
+        waiting = 1;
+        if( ++f->misses >= MAX_MISSES ) {
+            fprintf( stderr, "wall: dropped %s:%d after %d missed frames\n",
+                     inet_ntoa( f->addr.sin_addr ), ntohs( f->addr.sin_port ),
+                     f->misses );
+            *f = wall->followers[ --wall->num_followers ];
+            i--;
+        }
+    }
+    if( waiting ) wall->late++;
+
+    for( int i = 0; i < wall->num_followers; i++ ) {
+        wall_send_short( wall, &wall->followers[ i ].addr, WALL_GO, wall->frame );
+    }
+}
+
+/**
+ * Keeps a frame from the leader for wall_follower_begin(), if it is not
+ * the one already shown.  Returns true if it was kept.
+ */
+static int wall_follower_keep( wall_t *wall, size_t len )
+{
+    if( wall->in[ 4 ] != WALL_FRAME || len < FRAME_HEADER_SIZE ) return 0;
+    if( wall_read32( wall->in + 8 ) == wall->frame ) return 0;
+
+    memcpy( wall->next, wall->in, len );
+    wall->next_len = len;
+    return 1;
+}
+
+static int wall_follower_begin( wall_t *wall, double *seconds, int timeout_ms )
+{
+    struct sockaddr_in from;
+    uint64_t time_us;
+    uint32_t count;
+
+    if( !wall->next_len ) {
+        size_t len = wall_receive( wall, timeout_ms, &from );
+        if( !len || !wall_follower_keep( wall, len ) ) {
+            /* The leader may have restarted, or dropped us. */
+            if( !len ) wall_send_short( wall, &wall->leader_addr, WALL_HELLO, 0 );
+            return 0;
+        }
+    }
+
+    count = wall_read32( wall->next + 20 );
+    if( count > MAX_VALUES || wall->next_len < FRAME_HEADER_SIZE + (count * 4) ) {
+        wall->next_len = 0;
+        return 0;
+    }
+    if( count != (uint32_t) controlbus_get_count( wall->controlbus ) && !wall->warned ) {
+        fprintf( stderr, "wall: leader has %u controls, we have %d\n", count,
+                 controlbus_get_count( wall->controlbus ) );
+        wall->warned = 1;
+    }
+
+    for( uint32_t i = 0; i < count; i++ ) {
+        wall->values[ i ] = (int32_t) wall_read32( wall->next + FRAME_HEADER_SIZE + (i * 4) );
+    }
+    controlbus_latch_values( wall->controlbus, wall->values, count );
+
+    wall->frame = wall_read32( wall->next + 8 );
+    time_us = wall_read32( wall->next + 12 ) |
+              ((uint64_t) wall_read32( wall->next + 16 ) << 32);
+    *seconds = time_us / 1000000.0;
+    wall->next_len = 0;
+    wall->frames++;
+    return 1;
+}
+
+static void wall_follower_end( wall_t *wall )
+{
+    uint64_t deadline = wall_now() + ((uint64_t) SYNC_MS * 1000000);
+    struct sockaddr_in from;
+
+    wall_send_short( wall, &wall->leader_addr, WALL_READY, wall->frame );
+
+    for(;;) {
+        uint64_t now = wall_now();
+        if( now >= deadline ) break;
+
+        size_t len = wall_receive( wall, (int) ((deadline - now + 999999) / 1000000), &from );
+        if( !len ) break;
+        if( wall->in[ 4 ] == WALL_GO && wall_read32( wall->in + 8 ) == wall->frame ) {
+            return;
+        }
+
+        /* The leader has moved on without us, so catch up. */
+        if( wall_follower_keep( wall, len ) ) break;
+    }
+    wall->late++;
+}
+
+int wall_begin_frame( wall_t *wall, double *seconds, int timeout_ms )
+{
+    if( wall->leader ) return wall_leader_begin( wall, seconds );
+    return wall_follower_begin( wall, seconds, timeout_ms );
+}
+
+void wall_end_frame( wall_t *wall )
+{
+    if( wall->leader ) {
+        wall_leader_end( wall );
+    } else {
+        wall_follower_end( wall );
+    }
+}
+
+unsigned int wall_get_frames( wall_t *wall )
+{
+    return wall->frames;
+}
+
+unsigned int wall_get_late( wall_t *wall )
+{
+    return wall->late;
+}
+
+int wall_get_followers( wall_t *wall )
+{
+    return wall->num_followers;
+}
@@ -0,0 +1,111 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WALL_H_INCLUDED
+#define WALL_H_INCLUDED
+
+#include "controlbus.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Frame sync for a video wall, where several instances, on one machine
+ * or many, each draw one tile of a larger canvas.  One instance leads:
+ * it alone runs the inputs, and for every frame it sends each follower
+ * the frame number, the frame time and the value of every control over
+ * UDP.  Every tile latches the same values on its bus and draws the
+ * frame, the followers report back, and once all have, or a short
+ * timeout has passed, the leader tells them all to present.
+ *
+ *   leader                          follower
+ *   wall_begin_frame()  -- frame -> wall_begin_frame()
+ *   draw                            draw
+ *   wall_end_frame()   <- ready --  wall_end_frame()
+ *                      ---- go --->
+ *   present                         present
+ *
+ * Followers join by saying hello to the leader, and say it again
+ * whenever frames stop arriving, so tiles can be started and restarted
+ * in any order.  A follower that misses a frame is not waited for
+ * again until it catches up, and one that misses many in a row is
+ * dropped until it says hello again, so a dead tile never holds up the
+ * rest.
+ * Every tile must add the same slots to its bus in the same order.
+ *
+ * Example usage:
+ *
+ * wall_t *wall = wall_new_follower( "10.0.0.1", 9100, bus );
+ * for(;;) {
+ *     if( !wall_begin_frame( wall, &seconds, 100 ) ) continue;
+ *     draw the frame at seconds
+ *     wall_end_frame( wall );
+ *     present
+ * }
+ */
+
+typedef struct wall_s wall_t;
+
+/**
+ * Leads a wall, listening for followers on the given UDP port.
+ * Returns 0 on error.
+ */
+wall_t *wall_new_leader( int port, controlbus_t *controlbus );
+
+/**
+ * Follows the leader at host and port.  Returns 0 on error.
+ */
+wall_t *wall_new_follower( const char *host, int port,
+                           controlbus_t *controlbus );
+void wall_delete( wall_t *wall );
+int wall_is_leader( wall_t *wall );
+
+/**
+ * Starts a frame and latches the bus with its controls.  The leader
+ * latches its own bus, sends the frame to every follower and returns
+ * true.  A follower waits up to timeout_ms for the next frame, and
+ * returns false if none came.  seconds is set to the frame time, which
+ * every tile should animate by.
+ */
+int wall_begin_frame( wall_t *wall, double *seconds, int timeout_ms );
+
+/**
+ * Waits until every tile has drawn the frame, or the sync timeout has
+ * passed.  Call between drawing and presenting.
+ */
+void wall_end_frame( wall_t *wall );
+
+/**
+ * Returns the number of frames, the frames that were not synced in
+ * time, and, for the leader, the number of followers.
+ */
+unsigned int wall_get_frames( wall_t *wall );
+unsigned int wall_get_late( wall_t *wall );
+int wall_get_followers( wall_t *wall );
+
+#ifdef __cplusplus
+};
+#endif
+#endif /* WALL_H_INCLUDED */
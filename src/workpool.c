@@ -0,0 +1,214 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "workpool.h"
+
+#define MAX_THREADS 64
+
+struct workpool_s
+{
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+
+    int num_threads;
+    pthread_t threads[ MAX_THREADS ];
+    int quit;
+
+    /**
+     * The current batch, changed only while no workers are busy.  Each
+     * batch bumps the generation, which doubles as its ticket.
+     */
+    unsigned int generation;
+    workpool_func_t func;
+    void *arg;
+    int count;
+    int next;
+    int finished;
+    int busy;
+};
+
+/**
+ * Claims and runs jobs from the current batch until none are left.
+ * Called with the lock held, and returns with it held.
+ */
+static void workpool_drain( workpool_t *workpool )
+{
+    while( workpool->next < workpool->count ) {
+        int index = workpool->next++;
+        pthread_mutex_unlock( &workpool->lock );
+        workpool->func( workpool->arg, index );
+        pthread_mutex_lock( &workpool->lock );
+        workpool->finished++;
+    }
+    if( workpool->finished == workpool->count ) {
+        pthread_cond_broadcast( &workpool->done );
+    }
+}
+
+static void *workpool_thread( void *arg )
+{
+    workpool_t *workpool = arg;
+    unsigned int seen = 0;
+
+    pthread_mutex_lock( &workpool->lock );
+    for(;;) {
+        while( !workpool->quit && workpool->generation == seen ) {
+            pthread_cond_wait( &workpool->wake, &workpool->lock );
+        }
+        if( workpool->quit ) break;
+        seen = workpool->generation;
+        workpool->busy++;
+        workpool_drain( workpool );
+        workpool->busy--;
+        pthread_cond_broadcast( &workpool->done );
+    }
+    pthread_mutex_unlock( &workpool->lock );
+    return NULL;
+}
+
+workpool_t *workpool_new( int threads )
+{
+    workpool_t *workpool = malloc( sizeof( workpool_t ) );
+    if( !workpool ) return 0;
+
+    if( threads <= 0 ) {
+        long cpus = sysconf( _SC_NPROCESSORS_ONLN );
+        threads = (cpus > 0) ? cpus : 1;
+    }
+    if( threads > MAX_THREADS ) threads = MAX_THREADS;
+
+    pthread_mutex_init( &workpool->lock, NULL );
+    pthread_cond_init( &workpool->wake, NULL );
+    pthread_cond_init( &workpool->done, NULL );
+    workpool->num_threads = 0;
+    workpool->quit = 0;
+    workpool->generation = 0;
+    workpool->func = NULL;
+    workpool->arg = NULL;
+    workpool->count = 0;
+    workpool->next = 0;
+    workpool->finished = 0;
+    workpool->busy = 0;
+
+    for( int i = 0; i < threads; i++ ) {
+        if( pthread_create( &workpool->threads[ i ], NULL,
+                            workpool_thread, workpool ) != 0 ) {
+            fprintf( stderr, "workpool: failed to create worker thread\n" );
+            break;
+        }
+        workpool->num_threads++;
+    }
+    return workpool;
+}
+
+void workpool_delete( workpool_t *workpool )
+{
+    pthread_mutex_lock( &workpool->lock );
+    workpool->quit = 1;
+    pthread_cond_broadcast( &workpool->wake );
+    pthread_mutex_unlock( &workpool->lock );
+
+    for( int i = 0; i < workpool->num_threads; i++ ) {
+        pthread_join( workpool->threads[ i ], NULL );
+    }
+    pthread_cond_destroy( &workpool->done );
+    pthread_cond_destroy( &workpool->wake );
+    pthread_mutex_destroy( &workpool->lock );
+    free( workpool );
+}
+
+int workpool_get_threads( workpool_t *workpool )
+{
+    return workpool->num_threads;
+}
+
+/**
+ * Finishes the current batch.  Called with the lock held.
+ */
+static void workpool_finish( workpool_t *workpool )
+{
+    workpool_drain( workpool );
+    while( workpool->finished < workpool->count ) {
+        pthread_cond_wait( &workpool->done, &workpool->lock );
+    }
+}
+
+unsigned int workpool_start( workpool_t *workpool, workpool_func_t func,
+                             void *arg, int count )
+{
+    unsigned int ticket;
+
+    pthread_mutex_lock( &workpool->lock );
+    workpool_finish( workpool );
+
+    /* Let stragglers from the last batch leave before reusing it. */
+    while( workpool->busy ) {
+        pthread_cond_wait( &workpool->done, &workpool->lock );
+    }
+
+    workpool->func = func;
+    workpool->arg = arg;
+    workpool->count = count;
+    workpool->next = 0;
+    workpool->finished = 0;
+    ticket = ++workpool->generation;
+    pthread_cond_broadcast( &workpool->wake );
+    pthread_mutex_unlock( &workpool->lock );
+    return ticket;
+}
+
+void workpool_wait( workpool_t *workpool, unsigned int ticket )
+{
+    pthread_mutex_lock( &workpool->lock );
+
+    /* A later batch only starts once this one has finished. */
+    if( workpool->generation == ticket ) {
+        workpool_finish( workpool );
+    }
+    pthread_mutex_unlock( &workpool->lock );
+}
+
+int workpool_is_done( workpool_t *workpool, unsigned int ticket )
+{
+    int done;
+
+    pthread_mutex_lock( &workpool->lock );
+    done = workpool->generation != ticket ||
+           workpool->finished == workpool->count;
+    pthread_mutex_unlock( &workpool->lock );
+    return done;
+}
+
+void workpool_run( workpool_t *workpool, workpool_func_t func, void *arg,
+                   int count )
+{
+    workpool_wait( workpool, workpool_start( workpool, func, arg, count ) );
+}
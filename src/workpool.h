@@ -0,0 +1,99 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WORKPOOL_H_INCLUDED
+#define WORKPOOL_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A fixed set of worker threads for splitting a batch of independent
+ * jobs across cores.
+ *
+ * Example usage:
+ *
+ * static void decode_one( void *arg, int index )
+ * {
+ *     decode( ((image_t **) arg)[ index ] );
+ * }
+ *
+ * workpool_t *pool = workpool_new( 0 );
+ * workpool_run( pool, decode_one, images, num_images );
+ * workpool_delete( pool );
+ */
+
+typedef struct workpool_s workpool_t;
+
+typedef void (*workpool_func_t)( void *arg, int index );
+
+/**
+ * Starts a pool with the given number of threads, or one per online
+ * CPU if threads is 0.  Returns 0 on error.
+ */
+workpool_t *workpool_new( int threads );
+
+/**
+ * Stops and joins all worker threads.
+ */
+void workpool_delete( workpool_t *workpool );
+
+/**
+ * Returns the number of worker threads.
+ */
+int workpool_get_threads( workpool_t *workpool );
+
+/**
+ * Calls func( arg, i ) for every i from 0 to count-1, spread across the
+ * workers and the calling thread.  Returns once every call has finished.
+ */
+void workpool_run( workpool_t *workpool, workpool_func_t func, void *arg,
+                   int count );
+
+/**
+ * Like workpool_run(), but returns as soon as the workers have been
+ * handed the batch, so the caller can get on with something else.
+ * Only one batch runs at a time, so if the last one is still going this
+ * helps it finish first.  Returns a ticket for workpool_wait().
+ */
+unsigned int workpool_start( workpool_t *workpool, workpool_func_t func,
+                             void *arg, int count );
+
+/**
+ * Waits for the batch with the given ticket to finish, helping with any
+ * of its jobs that have not yet been picked up.
+ */
+void workpool_wait( workpool_t *workpool, unsigned int ticket );
+
+/**
+ * Returns true if the batch with the given ticket has finished, without
+ * waiting or helping.
+ */
+int workpool_is_done( workpool_t *workpool, unsigned int ticket );
+
+#ifdef __cplusplus
+};
+#endif
+#endif /* WORKPOOL_H_INCLUDED */
@@ -0,0 +1,326 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "bufpool.h"
+#include "y4minput.h"
+
+#define Y4M_MAGIC "YUV4MPEG2 "
+#define Y4M_FRAME "FRAME"
+
+/* Longest stream or frame header we will look through. */
+#define MAX_HEADER 1024
+
+struct y4minput_s
+{
+    int fd;
+    size_t size;
+
+    /* The last frame read, header and all. */
+    uint8_t *frame;
+
+    unsigned int width;
+    unsigned int height;
+    unsigned int chroma_width;
+    unsigned int chroma_height;
+    int fps_num;
+    int fps_den;
+
+    /**
+     * Every frame is a header line followed by the planes.  The frame
+     * headers are assumed to all be as long as the first, which is true
+     * of every file in practice, and checked as each frame is fetched.
+     */
+    size_t first_frame;
+    size_t frame_header;
+    size_t frame_size;
+    int frames;
+};
+
+/**
+ * Returns the length of the line at data, including its newline, or 0
+ * if there is no newline in the first max bytes.
+ */
+static size_t y4minput_line( const uint8_t *data, size_t max )
+{
+    const uint8_t *nl;
+
+    if( max > MAX_HEADER ) max = MAX_HEADER;
+    nl = memchr( data, '\n', max );
+    return nl ? (size_t) (nl - data) + 1 : 0;
+}
+
+/**
+ * Returns true if the colourspace tag is 8 bit 4:2:0.  Any chroma siting
+ * is fine for display, but the deeper 420p10 and 420p12 formats are not.
+ */
+static int y4minput_is_420( const char *tag, size_t len )
+{
+    static const char *tags[] = { "420", "420jpeg", "420mpeg2", "420paldv" };
+
+    for( size_t i = 0; i < sizeof( tags ) / sizeof( tags[ 0 ] ); i++ ) {
+        if( len == strlen( tags[ i ] ) && !strncmp( tag, tags[ i ], len ) ) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Parses the stream header parameters.  Returns 0 if the stream is not
+ * something we can play.
+ */
+static int y4minput_parse( y4minput_t *y4minput, const char *filename,
+                           const char *params )
+{
+    const char *p = params;
+
+    y4minput->width = 0;
+    y4minput->height = 0;
+    y4minput->fps_num = 25;
+    y4minput->fps_den = 1;
+
+    while( *p && *p != '\n' ) {
+        const char *end = p;
+        while( *end != ' ' && *end != '\n' ) end++;
+
+        switch( *p ) {
+        case 'W':
+            y4minput->width = strtoul( p + 1, 0, 10 );
+            break;
+        case 'H':
+            y4minput->height = strtoul( p + 1, 0, 10 );
+            break;
+        case 'F':
+            if( sscanf( p + 1, "%d:%d", &y4minput->fps_num,
+                        &y4minput->fps_den ) != 2 ) {
+                y4minput->fps_num = 0;
+            }
+            break;
+        case 'C':
+            if( !y4minput_is_420( p + 1, end - p - 1 ) ) {
+                fprintf( stderr, "y4minput: %s: only 8 bit 4:2:0 video is "
+                         "supported (got %.*s)\n", filename,
+                         (int) (end - p), p );
+                return 0;
+            }
+            break;
+        default:
+            break;
+        }
+        p = (*end == ' ') ? end + 1 : end;
+    }
+
+    if( !y4minput->width || !y4minput->height ||
+        y4minput->width > 16384 || y4minput->height > 16384 ) {
+        fprintf( stderr, "y4minput: %s: bad frame size %ux%u\n", filename,
+                 y4minput->width, y4minput->height );
+        return 0;
+    }
+    if( y4minput->fps_num <= 0 || y4minput->fps_den <= 0 ) {
+        fprintf( stderr, "y4minput: %s: bad frame rate\n", filename );
+        return 0;
+    }
+    return 1;
+}
+
+y4minput_t *y4minput_new( const char *filename )
+{
+    y4minput_t *y4minput = malloc( sizeof( y4minput_t ) );
+    uint8_t header[ (2 * MAX_HEADER) + 1 ];
+    struct stat st;
+    ssize_t got;
+    size_t len;
+
+    if( !y4minput ) return 0;
+    y4minput->frame = 0;
+
+    y4minput->fd = open( filename, O_RDONLY );
+    if( y4minput->fd < 0 ) {
+        fprintf( stderr, "y4minput: Cannot open %s: %s\n",
+                 filename, strerror( errno ) );
+        free( y4minput );
+        return 0;
+    }
+    got = pread( y4minput->fd, header, sizeof( header ) - 1, 0 );
+    if( fstat( y4minput->fd, &st ) < 0 ||
+        got <= (ssize_t) strlen( Y4M_MAGIC ) ) {
+        fprintf( stderr, "y4minput: %s is not a y4m file\n", filename );
+        y4minput_delete( y4minput );
+        return 0;
+    }
+    header[ got ] = '\0';
+    y4minput->size = st.st_size;
+
+    /* Frames are prefetched explicitly, so turn off the kernel's guessing. */
+    posix_fadvise( y4minput->fd, 0, 0, POSIX_FADV_RANDOM );
+
+    len = y4minput_line( header, got );
+    if( !len || memcmp( header, Y4M_MAGIC, strlen( Y4M_MAGIC ) ) ) {
+        fprintf( stderr, "y4minput: %s is not a y4m file\n", filename );
+        y4minput_delete( y4minput );
+        return 0;
+    }
+    if( !y4minput_parse( y4minput, filename,
+                         (const char *) header + strlen( Y4M_MAGIC ) ) ) {
+        y4minput_delete( y4minput );
+        return 0;
+    }
+
+    y4minput->chroma_width = (y4minput->width + 1) / 2;
+    y4minput->chroma_height = (y4minput->height + 1) / 2;
+    y4minput->frame_size = ((size_t) y4minput->width * y4minput->height) +
+        (2 * (size_t) y4minput->chroma_width * y4minput->chroma_height);
+    y4minput->first_frame = len;
+    y4minput->frame_header = y4minput_line( header + len, got - len );
+    y4minput->frames = 0;
+    if( y4minput->frame_header && y4minput->size > len ) {
+        y4minput->frames = (y4minput->size - len) /
+            (y4minput->frame_header + y4minput->frame_size);
+    }
+    if( !y4minput->frames ) {
+        fprintf( stderr, "y4minput: %s has no frames\n", filename );
+        y4minput_delete( y4minput );
+        return 0;
+    }
+
+    y4minput->frame = bufpool_alloc( y4minput->frame_header +
+                                     y4minput->frame_size );
+    if( !y4minput->frame ) {
+        fprintf( stderr, "y4minput: Cannot allocate a frame for %s\n",
+                 filename );
+        y4minput_delete( y4minput );
+        return 0;
+    }
+    return y4minput;
+}
+
+void y4minput_delete( y4minput_t *y4minput )
+{
+    if( y4minput->frame ) bufpool_free( y4minput->frame );
+    close( y4minput->fd );
+    free( y4minput );
+}
+
+unsigned int y4minput_get_width( y4minput_t *y4minput )
+{
+    return y4minput->width;
+}
+
+unsigned int y4minput_get_height( y4minput_t *y4minput )
+{
+    return y4minput->height;
+}
+
+unsigned int y4minput_get_chroma_width( y4minput_t *y4minput )
+{
+    return y4minput->chroma_width;
+}
+
+int y4minput_get_frames( y4minput_t *y4minput )
+{
+    return y4minput->frames;
+}
+
+double y4minput_get_fps( y4minput_t *y4minput )
+{
+    return (double) y4minput->fps_num / y4minput->fps_den;
+}
+
+static size_t y4minput_offset( y4minput_t *y4minput, int num )
+{
+    return y4minput->first_frame +
+        ((size_t) num * (y4minput->frame_header + y4minput->frame_size));
+}
+
+int y4minput_get_frame( y4minput_t *y4minput, int num,
+                        uint8_t **y, uint8_t **u, uint8_t **v )
+{
+    size_t want = y4minput->frame_header + y4minput->frame_size;
+    uint8_t *frame = y4minput->frame;
+
+    if( num < 0 || num >= y4minput->frames ) return 0;
+
+    /**
+     * The file may be cut short or rewritten while we play it, which
+     * just leaves a short read here.
+     */
+    if( pread( y4minput->fd, frame, want,
+               y4minput_offset( y4minput, num ) ) != (ssize_t) want ) {
+        return 0;
+    }
+    if( memcmp( frame, Y4M_FRAME, strlen( Y4M_FRAME ) ) ||
+        frame[ y4minput->frame_header - 1 ] != '\n' ) {
+        return 0;
+    }
+
+    size_t luma = (size_t) y4minput->width * y4minput->height;
+    size_t chroma = (size_t) y4minput->chroma_width * y4minput->chroma_height;
+    *y = frame + y4minput->frame_header;
+    *u = *y + luma;
+    *v = *u + chroma;
+    return 1;
+}
+
+/**
+ * Advises a run of frames that does not wrap.
+ */
+static void y4minput_advise( y4minput_t *y4minput, int first, int count )
+{
+    if( count <= 0 ) return;
+
+    size_t start = y4minput_offset( y4minput, first );
+    size_t end = y4minput_offset( y4minput, first + count );
+
+    posix_fadvise( y4minput->fd, start, end - start, POSIX_FADV_WILLNEED );
+}
+
+void y4minput_prefetch( y4minput_t *y4minput, int num, int count )
+{
+    int frames = y4minput->frames;
+
+    if( count < 0 ) {
+        count = -count;
+        num = num - count + 1;
+    }
+    if( count > frames ) count = frames;
+    num %= frames;
+    if( num < 0 ) num += frames;
+
+    if( num + count > frames ) {
+        y4minput_advise( y4minput, num, frames - num );
+        y4minput_advise( y4minput, 0, num + count - frames );
+    } else {
+        y4minput_advise( y4minput, num, count );
+    }
+}
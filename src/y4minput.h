@@ -0,0 +1,111 @@
+/**
+ * Copyright (C) 2020 Billy Biggs <vektor@dumbterm.net>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef Y4MINPUT_H_INCLUDED
+#define Y4MINPUT_H_INCLUDED
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Reads uncompressed 8 bit 4:2:0 video from a YUV4MPEG2 (.y4m) file.
+ * Each frame is read with one pread() into a buffer kept for the file,
+ * so a file cut short or rewritten under us gives a damaged frame
+ * rather than a crash.  Frames are only brought in from disk ahead of
+ * time when asked for with y4minput_prefetch(), so scrubbing around a
+ * long file does not drag the kernel's readahead along behind it.
+ *
+ * Example usage:
+ *
+ * y4minput_t *video = y4minput_new( "myclip.y4m" );
+ *
+ * for( i = 0; i < y4minput_get_frames( video ); i++ ) {
+ *     uint8_t *y, *u, *v;
+ *
+ *     y4minput_prefetch( video, i + 1, 8 );
+ *     if( y4minput_get_frame( video, i, &y, &u, &v ) ) {
+ *         upload( y, y4minput_get_width( video ),
+ *                 u, v, y4minput_get_chroma_width( video ) );
+ *     }
+ * }
+ *
+ * y4minput_delete( video );
+ */
+
+typedef struct y4minput_s y4minput_t;
+
+/**
+ * Opens the filename as a y4m file.  Returns 0 on error, or if the video
+ * is not 8 bit 4:2:0.
+ */
+y4minput_t *y4minput_new( const char *filename );
+
+/**
+ * Closes the file.
+ */
+void y4minput_delete( y4minput_t *y4minput );
+
+/**
+ * Returns the size of the luma plane.
+ */
+unsigned int y4minput_get_width( y4minput_t *y4minput );
+unsigned int y4minput_get_height( y4minput_t *y4minput );
+
+/**
+ * Returns the width of each chroma plane, which is also its stride.
+ */
+unsigned int y4minput_get_chroma_width( y4minput_t *y4minput );
+
+/**
+ * Returns the number of complete frames in the file.
+ */
+int y4minput_get_frames( y4minput_t *y4minput );
+
+/**
+ * Returns the frame rate in frames per second.
+ */
+double y4minput_get_fps( y4minput_t *y4minput );
+
+/**
+ * Reads the given frame, from 0 to frames-1, and points y, u and v at
+ * its planes.  They stay valid until the next call.  Returns 0 if the
+ * frame is damaged or missing.
+ */
+int y4minput_get_frame( y4minput_t *y4minput, int num,
+                        uint8_t **y, uint8_t **u, uint8_t **v );
+
+/**
+ * Asks the kernel to start reading count frames from num onwards,
+ * wrapping at the end of the file.  A negative count reads backwards
+ * from num, for reverse playback.
+ */
+void y4minput_prefetch( y4minput_t *y4minput, int num, int count );
+
+#ifdef __cplusplus
+};
+#endif
+#endif /* Y4MINPUT_H_INCLUDED */